@@ -4,11 +4,57 @@
 #include <cstdlib>
 #include <ctime>
 #include <limits>
+#include <cstdio>
+#include <cstring>
+#include <cmath>
+#include <climits>
+#include <cerrno>
+#include <cstdint>
+#include <thread>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <algorithm>
+#include <vector>
+#include <unordered_set>
+#include <unordered_map>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+#ifdef __linux__
+#include <sched.h>
+#include <sys/syscall.h>
+#endif
 using namespace std;
 
 
-const int MAX_ITEMS = 100;
-const int MAX_TRANSACTIONS = 200;
+// Capacities can be raised at compile time (e.g. -DINVENTORY_MAX_ITEMS=100000)
+#ifndef INVENTORY_MAX_ITEMS
+#define INVENTORY_MAX_ITEMS 100
+#endif
+#ifndef INVENTORY_MAX_TRANSACTIONS
+#define INVENTORY_MAX_TRANSACTIONS 200
+#endif
+#ifndef INVENTORY_MAX_LOCATIONS
+#define INVENTORY_MAX_LOCATIONS 20
+#endif
+#ifndef INVENTORY_MAX_RESERVATIONS
+#define INVENTORY_MAX_RESERVATIONS 100
+#endif
+
+const int MAX_ITEMS = INVENTORY_MAX_ITEMS;
+const int MAX_TRANSACTIONS = INVENTORY_MAX_TRANSACTIONS;
+const int MAX_LOCATIONS = INVENTORY_MAX_LOCATIONS;
+const int MAX_RESERVATIONS = INVENTORY_MAX_RESERVATIONS;
+const int DEFAULT_LOCATION = 0; // new and restocked units land here
 const int MIN_STOCK_THRESHOLD = 5;
 const double BULK_DISCOUNT_THRESHOLD = 5;
 const double BULK_DISCOUNT_RATE = 0.10; // 10% discount
@@ -35,6 +81,12 @@ struct Supplier {
     bool active;
 };
 
+struct Location {
+    string name;
+    string address;
+    bool active;
+};
+
 struct Transaction {
     int transactionId;
     string productName;
@@ -45,6 +97,7 @@ struct Transaction {
     double discount;
     string date;
     string time;
+    long long timestamp; // seconds since epoch, same moment as date/time
 };
 
 // GLOBAL ARRAYS
@@ -52,10 +105,23 @@ Product products[MAX_ITEMS];
 Category categories[MAX_ITEMS];
 Supplier suppliers[MAX_ITEMS];
 Transaction transactions[MAX_TRANSACTIONS];
+Location locations[MAX_LOCATIONS];
+
+// Dense product x location stock matrix. products[i].quantity is always
+// the sum of row i, so single-location code keeps working unchanged.
+int locationStock[MAX_ITEMS][MAX_LOCATIONS];
+
+// Per-location rollups over active products, kept current on every change
+long long locationUnits[MAX_LOCATIONS];
+double locationValue[MAX_LOCATIONS];
+
+// Units held by open reservations; still counted in products[].quantity
+int reservedStock[MAX_ITEMS];
 
 int productCount = 0;
 int categoryCount = 0;
 int supplierCount = 0;
+int locationCount = 0;
 int transactionCount = 0;
 int nextTransactionId = 1;
 
@@ -66,6 +132,38 @@ bool validateProductData(int* id, int* quantity, double* price, string* category
 void calculateDiscount(int quantity, double subtotal, double* discount, double* total);
 void updateInventoryStock(Product* product, int quantitySold);
 void getProductStatistics(int* totalProducts, int* lowStock, int* outOfStock, double* totalValue);
+void getTransactionSummary(int productId, int* count, int* unitsSold, double* revenue);
+struct InvoiceJob;
+bool commitPurchase(int index, int quantity, double* unitPrice, double* subtotal,
+                    double* discount, double* total, InvoiceJob* invoice,
+                    const Transaction** recorded);
+const Transaction* applyPurchase(int index, int quantity, double* unitPrice, double* subtotal,
+                                 double* discount, double* total, InvoiceJob* invoice);
+void expireReservations();
+void refreshReservations();
+void releaseProductReservations(int index);
+int getAvailableStock(int index);
+bool hasChangeConsumers();
+void trimMutationLogForReaders();
+struct MutationRecord;
+void encodeChanges(const MutationRecord* records, int count, vector<unsigned char>* out);
+bool decodeChanges(const unsigned char* data, size_t length, vector<MutationRecord>* records);
+int pickReadReplica();
+bool replicasAttached();
+bool lookupOnReplica(int replica, int productId, bool* found, Product* product, int* reserved);
+bool listProductsOnReplica(int replica, bool lowStockOnly, vector<Product>* listed);
+bool getReplicaReport(int replica, int* totalProducts, int* lowStock, int* outOfStock,
+                      double* totalValue, int* transactionCount,
+                      vector<long long>* locationUnits, vector<double>* locationValue);
+void resetDemandForecast(int index);
+void updateDemandForecast(int index, int quantity, long long when);
+void rebuildDemandForecasts(long long now);
+void updateSecondaryIndexes(int index);
+void rebuildSecondaryIndexes();
+void recordProductVersions(int firstIndex, int lastIndex);
+void resetProductHistory();
+void getDemandForecast(int index, long long now, double* smoothedRate, double* windowRate,
+                       double* daysOfCover, long long* stockOutDate);
 
 // ============================================================
 // UTILITY FUNCTIONS
@@ -89,22 +187,40 @@ void pauseScreen() {
     cin.get();
 }
 
-string getCurrentDate() {
-    time_t now = time(0);
-    tm* ltm = localtime(&now);
+// Local time into the caller's tm, so the invoice renderer thread and the
+// menu can format dates at the same time (localtime() shares one buffer)
+void toLocalTime(time_t moment, tm* ltm) {
+#ifdef _WIN32
+    localtime_s(ltm, &moment);
+#else
+    localtime_r(&moment, ltm);
+#endif
+}
+
+string formatDate(time_t moment) {
+    tm ltm;
+    toLocalTime(moment, &ltm);
     char buffer[11];
-    sprintf(buffer, "%02d/%02d/%04d", ltm->tm_mday, 1 + ltm->tm_mon, 1900 + ltm->tm_year);
+    sprintf(buffer, "%02d/%02d/%04d", ltm.tm_mday, 1 + ltm.tm_mon, 1900 + ltm.tm_year);
     return string(buffer);
 }
 
-string getCurrentTime() {
-    time_t now = time(0);
-    tm* ltm = localtime(&now);
+string formatTime(time_t moment) {
+    tm ltm;
+    toLocalTime(moment, &ltm);
     char buffer[9];
-    sprintf(buffer, "%02d:%02d:%02d", ltm->tm_hour, ltm->tm_min, ltm->tm_sec);
+    sprintf(buffer, "%02d:%02d:%02d", ltm.tm_hour, ltm.tm_min, ltm.tm_sec);
     return string(buffer);
 }
 
+string getCurrentDate() {
+    return formatDate(time(0));
+}
+
+string getCurrentTime() {
+    return formatTime(time(0));
+}
+
 void printTableHeader(string title) {
     cout << "\n";
     cout << "================================================================\n";
@@ -216,42 +332,751 @@ bool validateProductData(int* id, int* quantity, double* price, string* category
 }
 
 // ============================================================
-// LOW STOCK ALERT
+// MUTATION LOG
 // ============================================================
-void checkLowStock() {
-    bool hasLowStock = false;
+// Ordered record of every change to products, location stock and the
+// transaction history, appended by writers while they hold
+// inventoryWriteMutex. Records carry absolute values (a full product image,
+// a stock cell's new value) so applying one twice is harmless. Logging is
+// off until something reads the log: a replica or a change feed consumer.
+enum MutationType {
+    MUTATION_PRODUCT = 1,         // full product image at productIndex
+    MUTATION_LOCATION_STOCK = 2,  // locationStock[productIndex][location] = quantity
+    MUTATION_TRANSACTION = 3,     // one recorded sale
+    MUTATION_LOCATION_ADDED = 4,  // new location with an empty stock column
+    MUTATION_RESERVED = 5         // reservedStock[productIndex] = quantity
+};
+
+struct MutationRecord {
+    long long lsn;           // log sequence number, starts at 1
+    long long loggedAtNs;    // steady clock when appended (for lag)
+    int type;
+    int productIndex;
+    int productId;
+    int quantity;
+    int location;
+    int transactionId;
+    double price;            // product price or transaction unit price
+    double discount;
+    double total;
+    long long eventTime;     // transaction timestamp (seconds since epoch)
+    bool active;
+    string name;             // product or location name
+    string category;
+    string date;
+    string time;
+};
+
+mutex mutationLogMutex;
+condition_variable mutationLogChanged;
+deque<MutationRecord> mutationLog;    // records from mutationLogBaseLsn on
+long long mutationLogBaseLsn = 1;
+long long nextLsn = 1;
+atomic<bool> mutationLogEnabled(false);
+
+long long steadyNowNs() {
+    return chrono::duration_cast<chrono::nanoseconds>(
+        chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void copyFixedString(char* destination, size_t size, const string& source) {
+    strncpy(destination, source.c_str(), size - 1);
+    destination[size - 1] = '\0';
+}
+
+void appendMutation(MutationRecord* record) {
+    lock_guard<mutex> lock(mutationLogMutex);
+    record->lsn = nextLsn++;
+    record->loggedAtNs = steadyNowNs();
+    mutationLog.push_back(*record);
+    mutationLogChanged.notify_all();
+}
+
+// Fill a record with product index's current image (call by address)
+void fillProductRecord(int index, MutationRecord* record) {
+    *record = MutationRecord();
+    record->type = MUTATION_PRODUCT;
+    record->productIndex = index;
+    record->productId = products[index].id;
+    record->quantity = products[index].quantity;
+    record->price = products[index].price;
+    record->active = products[index].active;
+    record->name = products[index].name;
+    record->category = products[index].category;
+}
+
+void fillTransactionRecord(const Transaction* trans, int productIndex, MutationRecord* record) {
+    *record = MutationRecord();
+    record->type = MUTATION_TRANSACTION;
+    record->productIndex = productIndex;
+    record->eventTime = trans->timestamp;
+    record->transactionId = trans->transactionId;
+    record->productId = trans->productId;
+    record->quantity = trans->quantity;
+    record->price = trans->unitPrice;
+    record->discount = trans->discount;
+    record->total = trans->totalPrice;
+    record->name = trans->productName;
+    record->date = trans->date;
+    record->time = trans->time;
+}
+
+void logProductChange(int index) {
+    if (!mutationLogEnabled) {
+        return;
+    }
+    MutationRecord record;
+    fillProductRecord(index, &record);
+    appendMutation(&record);
+}
+
+void logLocationStock(int index, int location) {
+    if (!mutationLogEnabled) {
+        return;
+    }
+    MutationRecord record = MutationRecord();
+    record.type = MUTATION_LOCATION_STOCK;
+    record.productIndex = index;
+    record.productId = products[index].id;
+    record.location = location;
+    record.quantity = locationStock[index][location];
+    appendMutation(&record);
+}
+
+void logTransaction(const Transaction* trans, int productIndex) {
+    if (!mutationLogEnabled) {
+        return;
+    }
+    MutationRecord record;
+    fillTransactionRecord(trans, productIndex, &record);
+    appendMutation(&record);
+}
+
+void logLocationAdded(int location) {
+    if (!mutationLogEnabled) {
+        return;
+    }
+    MutationRecord record = MutationRecord();
+    record.type = MUTATION_LOCATION_ADDED;
+    record.location = location;
+    record.active = locations[location].active;
+    record.name = locations[location].name;
+    appendMutation(&record);
+}
+
+void logReservedStock(int index) {
+    if (!mutationLogEnabled) {
+        return;
+    }
+    MutationRecord record = MutationRecord();
+    record.type = MUTATION_RESERVED;
+    record.productIndex = index;
+    record.productId = products[index].id;
+    record.quantity = reservedStock[index];
+    appendMutation(&record);
+}
+
+// Drop records up to and including upToLsn once every reader has them.
+// The caller must hold mutationLogMutex.
+void trimMutationLog(long long upToLsn) {
+    while (!mutationLog.empty() && mutationLogBaseLsn <= upToLsn) {
+        mutationLog.pop_front();
+        mutationLogBaseLsn++;
+    }
+}
+
+// ============================================================
+// SNAPSHOTS (COPY-ON-WRITE PRODUCT PAGES)
+// ============================================================
+// Writers change products[] under inventoryWriteMutex and then publish the
+// pages they touched. A snapshot is an immutable tree of fixed fanout over
+// small pages of products, so a publish copies the touched page and the
+// nodes on the path to it (one per level, a handful even at millions of
+// products) and shares everything else with the previous snapshot. Readers
+// grab the current snapshot with one atomic load and never take the
+// writer lock.
+const int SNAPSHOT_PAGE_SIZE = 16;      // products per page
+const int SNAPSHOT_FANOUT_BITS = 6;
+const int SNAPSHOT_FANOUT = 1 << SNAPSHOT_FANOUT_BITS;  // children per node
+
+struct ProductPage {
+    Product items[SNAPSHOT_PAGE_SIZE];
+};
+
+// A tree node at height 1 holds pages; higher nodes hold nodes
+struct SnapshotNode {
+    shared_ptr<const ProductPage> pages[SNAPSHOT_FANOUT];
+    shared_ptr<const SnapshotNode> children[SNAPSHOT_FANOUT];
+};
+
+struct InventorySnapshot {
+    shared_ptr<const SnapshotNode> root;
+    int height;             // the root covers SNAPSHOT_FANOUT^height pages
+    int productCount;
+    int transactionCount;   // transactions below this index are immutable
+    vector<long long> locationUnits;
+    vector<double> locationValue;
+    long long version;
+};
+
+mutex inventoryWriteMutex;
+shared_ptr<const InventorySnapshot> currentSnapshot;
+
+// Point-in-time view of the inventory, safe to read from any thread
+shared_ptr<const InventorySnapshot> acquireSnapshot() {
+    shared_ptr<const InventorySnapshot> snapshot = atomic_load(&currentSnapshot);
+    if (!snapshot) {
+        snapshot = make_shared<InventorySnapshot>(InventorySnapshot{
+            shared_ptr<const SnapshotNode>(), 1, 0, 0,
+            vector<long long>(), vector<double>(), 0});
+    }
+    return snapshot;
+}
+
+const ProductPage* snapshotPage(const InventorySnapshot* snapshot, int pageNumber) {
+    const SnapshotNode* node = snapshot->root.get();
+    for (int level = snapshot->height - 1; level > 0; level--) {
+        node = node->children[(pageNumber >> (SNAPSHOT_FANOUT_BITS * level)) & (SNAPSHOT_FANOUT - 1)].get();
+    }
+    return node->pages[pageNumber & (SNAPSHOT_FANOUT - 1)].get();
+}
+
+const Product* snapshotProduct(const InventorySnapshot* snapshot, int index) {
+    return &snapshotPage(snapshot, index / SNAPSHOT_PAGE_SIZE)->items[index % SNAPSHOT_PAGE_SIZE];
+}
+
+// Copy of node (NULL for a new one) with the pages firstPage..lastPage
+// that fall under it rebuilt from products[]. The node is at `height` and
+// its first page is basePage.
+shared_ptr<const SnapshotNode> publishSnapshotNode(const SnapshotNode* old, int height, int basePage,
+                                                  int firstPage, int lastPage) {
+    shared_ptr<SnapshotNode> node = old != NULL ? make_shared<SnapshotNode>(*old)
+                                                : make_shared<SnapshotNode>();
+    int shift = SNAPSHOT_FANOUT_BITS * (height - 1);   // pages per child = 1 << shift
+    int firstChild = (max(firstPage, basePage) - basePage) >> shift;
+    int lastChild = min(SNAPSHOT_FANOUT - 1, (lastPage - basePage) >> shift);
+
+    for (int c = firstChild; c <= lastChild; c++) {
+        int childBase = basePage + (c << shift);
+        if (height > 1) {
+            node->children[c] = publishSnapshotNode(node->children[c].get(), height - 1, childBase,
+                                                    firstPage, lastPage);
+            continue;
+        }
+        shared_ptr<ProductPage> page = make_shared<ProductPage>();
+        int base = childBase * SNAPSHOT_PAGE_SIZE;
+        for (int i = 0; i < SNAPSHOT_PAGE_SIZE && base + i < productCount; i++) {
+            page->items[i] = products[base + i];
+        }
+        node->pages[c] = page;
+    }
+    return node;
+}
+
+// Publish products[firstIndex..lastIndex] and the current counts as a new
+// snapshot, and log the changed products. Pass an empty range
+// (lastIndex < firstIndex) to publish counts only. The caller must hold
+// inventoryWriteMutex.
+void publishProductChanges(int firstIndex, int lastIndex) {
+    recordProductVersions(firstIndex, lastIndex);
+    for (int i = firstIndex; i <= lastIndex && i < productCount; i++) {
+        logProductChange(i);
+        updateSecondaryIndexes(i);
+    }
+
+    shared_ptr<const InventorySnapshot> previous = acquireSnapshot();
+    shared_ptr<InventorySnapshot> next = make_shared<InventorySnapshot>();
+    next->root = previous->root;
+    next->height = previous->height;
+
+    // Grow the tree a level at a time until it covers every page
+    int pagesNeeded = (productCount + SNAPSHOT_PAGE_SIZE - 1) / SNAPSHOT_PAGE_SIZE;
+    while (pagesNeeded > (1 << (SNAPSHOT_FANOUT_BITS * next->height))) {
+        if (next->root) {
+            shared_ptr<SnapshotNode> root = make_shared<SnapshotNode>();
+            root->children[0] = next->root;
+            next->root = root;
+        }
+        next->height++;
+    }
+
+    if (lastIndex >= productCount) {
+        lastIndex = productCount - 1;
+    }
+    if (lastIndex >= firstIndex) {
+        next->root = publishSnapshotNode(next->root.get(), next->height, 0,
+                                         firstIndex / SNAPSHOT_PAGE_SIZE, lastIndex / SNAPSHOT_PAGE_SIZE);
+    }
+
+    next->productCount = productCount;
+    next->transactionCount = transactionCount;
+    next->locationUnits.assign(locationUnits, locationUnits + locationCount);
+    next->locationValue.assign(locationValue, locationValue + locationCount);
+    next->version = previous->version + 1;
+    atomic_store(&currentSnapshot, shared_ptr<const InventorySnapshot>(next));
+}
+
+// Publish every product from scratch, e.g. after loading sample data.
+// The caller must hold inventoryWriteMutex.
+void rebuildSnapshot() {
+    long long version = acquireSnapshot()->version;
+    atomic_store(&currentSnapshot, shared_ptr<const InventorySnapshot>(
+        make_shared<InventorySnapshot>(InventorySnapshot{
+            shared_ptr<const SnapshotNode>(), 1, 0, 0,
+            vector<long long>(), vector<double>(), version})));
+    rebuildSecondaryIndexes();
+    publishProductChanges(0, productCount - 1);
+}
+
+// ============================================================
+// SECONDARY INDEXES
+// ============================================================
+// Sorted indexes on price, quantity and category+price. Each index is a
+// large sorted run plus a small sorted run of recent changes. A change
+// never edits the large run: the product's stamp is bumped, which makes
+// its old entry stale, and a fresh entry goes into the small run. When
+// the small run or the stale count grows past a bound, the two runs are
+// merged into one. Range scans walk both runs in order, so a page of
+// results costs about its own size.
+const int INDEX_MIN_DELTA = 256;
+
+struct IndexEntry {
+    int group;      // category for the category+price index, else 0
+    double key;
+    int index;      // product slot
+    int stamp;      // entry is live while it equals the slot's stamp
+};
+
+struct SecondaryIndex {
+    vector<IndexEntry> run;
+    vector<IndexEntry> delta;
+    vector<int> stamp;          // per product slot
+    vector<bool> present;       // slot currently has a live entry
+    vector<int> currentGroup;
+    vector<double> currentKey;
+    int staleCount;
+};
+
+enum IndexKind { INDEX_PRICE, INDEX_QUANTITY, INDEX_CATEGORY_PRICE, INDEX_KIND_COUNT };
+
+SecondaryIndex secondaryIndexes[INDEX_KIND_COUNT];
+unordered_map<string, int> indexCategoryIds;   // category name -> group
+
+bool indexEntryLess(const IndexEntry& a, const IndexEntry& b) {
+    if (a.group != b.group) return a.group < b.group;
+    if (a.key != b.key) return a.key < b.key;
+    if (a.index != b.index) return a.index < b.index;
+    return a.stamp < b.stamp;
+}
+
+// Group for a category name; unknown names get the next free number
+int indexCategoryId(const string& category) {
+    unordered_map<string, int>::const_iterator found = indexCategoryIds.find(category);
+    if (found != indexCategoryIds.end()) {
+        return found->second;
+    }
+    int id = (int)indexCategoryIds.size();
+    indexCategoryIds[category] = id;
+    return id;
+}
+
+bool isLiveEntry(const SecondaryIndex* idx, const IndexEntry& entry) {
+    return entry.stamp == idx->stamp[entry.index];
+}
+
+// Merge the small run into the large one and drop stale entries
+void compactIndex(SecondaryIndex* idx) {
+    vector<IndexEntry> merged;
+    merged.reserve(idx->run.size() + idx->delta.size() - idx->staleCount);
+    size_t a = 0, b = 0;
+    while (a < idx->run.size() || b < idx->delta.size()) {
+        const IndexEntry* next;
+        if (b == idx->delta.size() || (a < idx->run.size() && indexEntryLess(idx->run[a], idx->delta[b]))) {
+            next = &idx->run[a++];
+        } else {
+            next = &idx->delta[b++];
+        }
+        if (isLiveEntry(idx, *next)) {
+            merged.push_back(*next);
+        }
+    }
+    idx->run.swap(merged);
+    idx->delta.clear();
+    idx->staleCount = 0;
+}
+
+// Record that a product slot now has (group, key), or no entry at all
+void setIndexEntry(SecondaryIndex* idx, int index, bool present, int group, double key) {
+    if ((int)idx->stamp.size() <= index) {
+        idx->stamp.resize(index + 1, 0);
+        idx->present.resize(index + 1, false);
+        idx->currentGroup.resize(index + 1, 0);
+        idx->currentKey.resize(index + 1, 0.0);
+    }
+    if (present == idx->present[index] &&
+        (!present || (group == idx->currentGroup[index] && key == idx->currentKey[index]))) {
+        return;
+    }
+
+    if (idx->present[index]) {
+        idx->staleCount++;
+    }
+    idx->stamp[index]++;
+    idx->present[index] = present;
+    idx->currentGroup[index] = group;
+    idx->currentKey[index] = key;
+
+    if (present) {
+        IndexEntry entry = { group, key, index, idx->stamp[index] };
+        idx->delta.insert(upper_bound(idx->delta.begin(), idx->delta.end(), entry, indexEntryLess), entry);
+    }
+
+    size_t deltaLimit = INDEX_MIN_DELTA + 4 * (size_t)sqrt((double)idx->run.size());
+    if (idx->delta.size() > deltaLimit || (size_t)idx->staleCount > idx->run.size() / 4 + INDEX_MIN_DELTA) {
+        compactIndex(idx);
+    }
+}
+
+// Bring all indexes up to date for one product slot. Called from
+// publishProductChanges, so every write path keeps them current.
+void updateSecondaryIndexes(int index) {
+    const Product* product = &products[index];
+    bool present = product->active;
+    setIndexEntry(&secondaryIndexes[INDEX_PRICE], index, present, 0, product->price);
+    setIndexEntry(&secondaryIndexes[INDEX_QUANTITY], index, present, 0, product->quantity);
+    setIndexEntry(&secondaryIndexes[INDEX_CATEGORY_PRICE], index, present,
+                  present ? indexCategoryId(product->category) : 0, product->price);
+}
+
+// Build every index from scratch with one sort each. The caller must hold
+// inventoryWriteMutex.
+void rebuildSecondaryIndexes() {
+    for (int k = 0; k < INDEX_KIND_COUNT; k++) {
+        SecondaryIndex* idx = &secondaryIndexes[k];
+        idx->run.clear();
+        idx->delta.clear();
+        idx->staleCount = 0;
+        idx->stamp.assign(productCount, 0);
+        idx->present.assign(productCount, false);
+        idx->currentGroup.assign(productCount, 0);
+        idx->currentKey.assign(productCount, 0.0);
+        idx->run.reserve(productCount);
+    }
 
     for (int i = 0; i < productCount; i++) {
-        if (products[i].active && products[i].quantity <= MIN_STOCK_THRESHOLD) {
-            if (!hasLowStock) {
-                printWarning("LOW STOCK ALERT!");
-                cout << "----------------------------------------------------------------\n";
-                cout << left << setw(6) << "ID" << setw(20) << "Product"
-                     << setw(12) << "Quantity" << "Status\n";
-                cout << "----------------------------------------------------------------\n";
-                hasLowStock = true;
-            }
-
-            cout << left << setw(6) << products[i].id
-                 << setw(20) << products[i].name
-                 << setw(12) << products[i].quantity;
-
-            if (products[i].quantity == 0) {
-                cout << "OUT OF STOCK\n";
-            } else {
-                cout << "LOW STOCK\n";
+        if (!products[i].active) {
+            continue;
+        }
+        int groups[INDEX_KIND_COUNT] = { 0, 0, indexCategoryId(products[i].category) };
+        double keys[INDEX_KIND_COUNT] = { products[i].price, (double)products[i].quantity, products[i].price };
+        for (int k = 0; k < INDEX_KIND_COUNT; k++) {
+            SecondaryIndex* idx = &secondaryIndexes[k];
+            IndexEntry entry = { groups[k], keys[k], i, 0 };
+            idx->run.push_back(entry);
+            idx->present[i] = true;
+            idx->currentGroup[i] = groups[k];
+            idx->currentKey[i] = keys[k];
+        }
+    }
+    for (int k = 0; k < INDEX_KIND_COUNT; k++) {
+        sort(secondaryIndexes[k].run.begin(), secondaryIndexes[k].run.end(), indexEntryLess);
+    }
+}
+
+// Where a paginated scan left off; start with started = false
+struct IndexCursor {
+    bool started;
+    IndexEntry last;
+};
+
+// Product slots with group == `group` and low <= key <= high, in key order
+// (descending when asked). Writes at most `limit` slots to `out`, returns
+// how many were written and moves the cursor past them, so the next call
+// returns the next page. Top-k is a descending scan over the whole range.
+// The caller must hold inventoryWriteMutex.
+int queryIndexRange(IndexKind kind, int group, double low, double high, bool descending,
+                    IndexCursor* cursor, int limit, int* out) {
+    const SecondaryIndex* idx = &secondaryIndexes[kind];
+    IndexEntry lowest = { group, low, INT_MIN, INT_MIN };
+    IndexEntry highest = { group, high, INT_MAX, INT_MAX };
+
+    const vector<IndexEntry>* runs[2] = { &idx->run, &idx->delta };
+    long long position[2], stop[2];
+    for (int r = 0; r < 2; r++) {
+        vector<IndexEntry>::const_iterator begin = runs[r]->begin(), end = runs[r]->end();
+        long long first = lower_bound(begin, end, lowest, indexEntryLess) - begin;
+        long long last = upper_bound(begin, end, highest, indexEntryLess) - begin;
+        if (cursor->started && !descending) {
+            first = max(first, (long long)(upper_bound(begin, end, cursor->last, indexEntryLess) - begin));
+        } else if (cursor->started) {
+            last = min(last, (long long)(lower_bound(begin, end, cursor->last, indexEntryLess) - begin));
+        }
+        position[r] = descending ? last - 1 : first;
+        stop[r] = descending ? first - 1 : last;
+    }
+    int step = descending ? -1 : 1;
+
+    int written = 0;
+    while (written < limit && (position[0] != stop[0] || position[1] != stop[1])) {
+        // Take whichever run's next entry comes first in scan order
+        int r;
+        if (position[0] == stop[0]) {
+            r = 1;
+        } else if (position[1] == stop[1]) {
+            r = 0;
+        } else {
+            bool deltaFirst = indexEntryLess((*runs[1])[position[1]], (*runs[0])[position[0]]);
+            r = (deltaFirst != descending) ? 1 : 0;
+        }
+        const IndexEntry& entry = (*runs[r])[position[r]];
+        position[r] += step;
+
+        if (isLiveEntry(idx, entry)) {
+            out[written++] = entry.index;
+            cursor->started = true;
+            cursor->last = entry;
+        }
+    }
+    return written;
+}
+
+// ============================================================
+// LOCATION STOCK
+// ============================================================
+int findLocationByName(string name) {
+    for (int i = 0; i < locationCount; i++) {
+        if (locations[i].name == name && locations[i].active) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+// Add (sign = 1) or remove (sign = -1) one product's whole contribution to
+// the per-location rollups. Used around edits that change price or status.
+void adjustLocationTotals(int index, int sign) {
+    if (!products[index].active) {
+        return;
+    }
+    for (int l = 0; l < locationCount; l++) {
+        locationUnits[l] += sign * locationStock[index][l];
+        locationValue[l] += sign * locationStock[index][l] * products[index].price;
+    }
+}
+
+void recomputeLocationTotals() {
+    for (int l = 0; l < MAX_LOCATIONS; l++) {
+        locationUnits[l] = 0;
+        locationValue[l] = 0.0;
+    }
+    for (int i = 0; i < productCount; i++) {
+        adjustLocationTotals(i, 1);
+    }
+}
+
+// Start a new product row with all of its units at the default location
+void initProductStock(int index, int quantity) {
+    for (int l = 0; l < MAX_LOCATIONS; l++) {
+        locationStock[index][l] = 0;
+    }
+    locationStock[index][DEFAULT_LOCATION] = quantity;
+    logLocationStock(index, DEFAULT_LOCATION);
+}
+
+// Move a product's stock at one location by delta units (rollups included)
+void changeLocationStock(int index, int location, int delta) {
+    locationStock[index][location] += delta;
+    if (products[index].active) {
+        locationUnits[location] += delta;
+        locationValue[location] += delta * products[index].price;
+    }
+    logLocationStock(index, location);
+}
+
+// Change the product's row to add up to newTotal. Increases go to the
+// default location; decreases come from the default location first and
+// then from the others in order. The default location's cell is used even
+// before any location has been added (initProductStock fills it too).
+// Does not touch products[index].quantity.
+void setProductStock(int index, int newTotal) {
+    int delta = newTotal - products[index].quantity;
+    if (delta >= 0) {
+        locationStock[index][DEFAULT_LOCATION] += delta;
+        logLocationStock(index, DEFAULT_LOCATION);
+        return;
+    }
+
+    int remaining = -delta;
+    int rows = max(locationCount, DEFAULT_LOCATION + 1);
+    for (int l = DEFAULT_LOCATION; l < rows && remaining > 0; l++) {
+        int taken = min(remaining, locationStock[index][l]);
+        locationStock[index][l] -= taken;
+        remaining -= taken;
+        if (taken > 0) {
+            logLocationStock(index, l);
+        }
+    }
+}
+
+// Best location to ship an order from: the active location that can cover
+// the whole quantity with the most units on hand (so one store is not
+// drained first). Returns -1 if no single location can cover it.
+int chooseFulfillmentLocation(int index, int quantity) {
+    int best = -1;
+    for (int l = 0; l < locationCount; l++) {
+        if (locations[l].active && locationStock[index][l] >= quantity &&
+            (best == -1 || locationStock[index][l] > locationStock[index][best])) {
+            best = l;
+        }
+    }
+    return best;
+}
+
+// Location holding the most units of a product, or -1 if none has any
+int largestStockLocation(int index, bool activeOnly) {
+    int largest = -1;
+    int rows = max(locationCount, DEFAULT_LOCATION + 1);
+    for (int l = 0; l < rows; l++) {
+        if (locationStock[index][l] > 0 && (!activeOnly || l >= locationCount || locations[l].active) &&
+            (largest == -1 || locationStock[index][l] > locationStock[index][largest])) {
+            largest = l;
+        }
+    }
+    return largest;
+}
+
+// Take quantity units of a product out of its locations. The caller has
+// already checked that the product's total covers the quantity.
+void fulfillFromLocations(int index, int quantity) {
+    int best = chooseFulfillmentLocation(index, quantity);
+    if (best != -1) {
+        changeLocationStock(index, best, -quantity);
+        return;
+    }
+
+    // Split the order, emptying the best-stocked active locations first.
+    // Units left at inactive locations are still part of the product's
+    // total, so they are used only when the active ones run out.
+    for (int pass = 0; pass < 2 && quantity > 0; pass++) {
+        while (quantity > 0) {
+            int largest = largestStockLocation(index, pass == 0);
+            if (largest == -1) {
+                break;
             }
+            int taken = min(quantity, locationStock[index][largest]);
+            changeLocationStock(index, largest, -taken);
+            quantity -= taken;
         }
     }
+}
 
-    if (hasLowStock) {
-        cout << "----------------------------------------------------------------\n";
+// Receive new units of a product into one location
+bool restockProduct(int index, int location, int quantity) {
+    if (index < 0 || index >= productCount || location < 0 || location >= locationCount ||
+        quantity <= 0) {
+        return false;
+    }
+
+    lock_guard<mutex> lock(inventoryWriteMutex);
+    changeLocationStock(index, location, quantity);
+    products[index].quantity += quantity;
+    publishProductChanges(index, index);
+    return true;
+}
+
+// Move units between two locations in one step; the product total is
+// unchanged, so only the location rollups are republished.
+bool transferStock(int index, int from, int to, int quantity) {
+    if (index < 0 || index >= productCount ||
+        from < 0 || from >= locationCount || to < 0 || to >= locationCount ||
+        from == to || quantity <= 0 || !locations[from].active || !locations[to].active) {
+        return false;
+    }
+
+    lock_guard<mutex> lock(inventoryWriteMutex);
+    if (locationStock[index][from] < quantity) {
+        return false;
+    }
+    changeLocationStock(index, from, -quantity);
+    changeLocationStock(index, to, quantity);
+    publishProductChanges(0, -1);
+    return true;
+}
+
+// Get one location's rollup from a snapshot (call by address)
+void getLocationStatistics(const InventorySnapshot* snapshot, int location,
+                           long long* units, double* value) {
+    *units = 0;
+    *value = 0.0;
+    if (location < (int)snapshot->locationUnits.size()) {
+        *units = snapshot->locationUnits[location];
+        *value = snapshot->locationValue[location];
+    }
+}
+
+// ============================================================
+// LOW STOCK ALERT
+// ============================================================
+void checkLowStock() {
+    // Served by a replica when one is attached and caught up
+    vector<Product> low;
+    int replica = pickReadReplica();
+    if (replica == -1 || !listProductsOnReplica(replica, true, &low)) {
+        replica = -1;
+        low.clear();
+        for (int i = 0; i < productCount; i++) {
+            if (products[i].active && products[i].quantity <= MIN_STOCK_THRESHOLD) {
+                low.push_back(products[i]);
+            }
+        }
+    }
+    if (low.empty()) {
+        return;
+    }
+
+    printWarning("LOW STOCK ALERT!");
+    cout << "----------------------------------------------------------------\n";
+    cout << left << setw(6) << "ID" << setw(20) << "Product"
+         << setw(12) << "Quantity" << "Status\n";
+    cout << "----------------------------------------------------------------\n";
+
+    for (size_t k = 0; k < low.size(); k++) {
+        cout << left << setw(6) << low[k].id
+             << setw(20) << low[k].name
+             << setw(12) << low[k].quantity;
+
+        if (low[k].quantity == 0) {
+            cout << "OUT OF STOCK\n";
+        } else {
+            cout << "LOW STOCK\n";
+        }
+    }
+
+    cout << "----------------------------------------------------------------\n";
+    if (replica != -1) {
+        cout << "(served by replica " << replica + 1 << ")\n";
     }
 }
 
 // ============================================================
 // PRODUCT MANAGEMENT
 // ============================================================
+void printProductRow(const Product* product) {
+    cout << left << setw(6) << product->id
+         << setw(20) << product->name
+         << setw(15) << product->category
+         << setw(10) << product->quantity
+         << "$" << setw(11) << fixed << setprecision(2) << product->price;
+
+    if (product->quantity == 0) {
+        cout << "OUT\n";
+    } else if (product->quantity <= MIN_STOCK_THRESHOLD) {
+        cout << "LOW\n";
+    } else {
+        cout << "OK\n";
+    }
+}
+
 void displayProductsTable() {
     if (productCount == 0) {
         printError("No products available!");
@@ -266,24 +1091,25 @@ void displayProductsTable() {
          << setw(12) << "Price" << "Status\n";
     cout << "----------------------------------------------------------------\n";
 
-    for (int i = 0; i < productCount; i++) {
-        if (products[i].active) {
-            cout << left << setw(6) << products[i].id
-                 << setw(20) << products[i].name
-                 << setw(15) << products[i].category
-                 << setw(10) << products[i].quantity
-                 << "$" << setw(11) << fixed << setprecision(2) << products[i].price;
-
-            if (products[i].quantity == 0) {
-                cout << "OUT\n";
-            } else if (products[i].quantity <= MIN_STOCK_THRESHOLD) {
-                cout << "LOW\n";
-            } else {
-                cout << "OK\n";
+    // Served by a replica when one is attached and caught up
+    vector<Product> listed;
+    int replica = pickReadReplica();
+    if (replica != -1 && listProductsOnReplica(replica, false, &listed)) {
+        for (size_t k = 0; k < listed.size(); k++) {
+            printProductRow(&listed[k]);
+        }
+    } else {
+        replica = -1;
+        for (int i = 0; i < productCount; i++) {
+            if (products[i].active) {
+                printProductRow(&products[i]);
             }
         }
     }
     cout << "----------------------------------------------------------------\n";
+    if (replica != -1) {
+        cout << "(served by replica " << replica + 1 << ")\n";
+    }
     checkLowStock();
 }
 
@@ -342,7 +1168,14 @@ void addProduct() {
     }
 
     newProduct.active = true;
-    products[productCount++] = newProduct;
+    {
+        lock_guard<mutex> lock(inventoryWriteMutex);
+        products[productCount++] = newProduct;
+        initProductStock(productCount - 1, newProduct.quantity);
+        resetDemandForecast(productCount - 1);
+        adjustLocationTotals(productCount - 1, 1);
+        publishProductChanges(productCount - 1, productCount - 1);
+    }
 
     printSuccess("Product added successfully!");
 
@@ -375,52 +1208,74 @@ void updateProduct() {
     cout << "Quantity: " << products[index].quantity << "\n";
     cout << "Price: $" << fixed << setprecision(2) << products[index].price << "\n";
 
+    // Edit a copy so a rejected value leaves the product untouched
+    Product edited = products[index];
+
     clearInputBuffer();
     cout << "\nEnter New Name: ";
-    getline(cin, products[index].name);
+    getline(cin, edited.name);
 
-    if (products[index].name.empty()) {
+    if (edited.name.empty()) {
         printError("Product name cannot be empty!");
         return;
     }
 
     cout << "Enter New Category: ";
-    getline(cin, products[index].category);
+    getline(cin, edited.category);
 
-    if (products[index].category.empty()) {
+    if (edited.category.empty()) {
         printError("Category cannot be empty!");
         return;
     }
 
-    if (!categoryExists(products[index].category)) {
+    if (!categoryExists(edited.category)) {
         printError("Category does not exist!");
         return;
     }
 
     cout << "Enter New Quantity: ";
-    if (!(cin >> products[index].quantity)) {
+    if (!(cin >> edited.quantity)) {
         clearInputBuffer();
         printError("Invalid input! Quantity must be a number.");
         return;
     }
 
-    if (!isValidQuantity(products[index].quantity)) {
+    if (!isValidQuantity(edited.quantity)) {
         printError("Invalid quantity!");
         return;
     }
 
     cout << "Enter New Price: $";
-    if (!(cin >> products[index].price)) {
+    if (!(cin >> edited.price)) {
         clearInputBuffer();
         printError("Invalid input! Price must be a number.");
         return;
     }
 
-    if (!isValidPrice(products[index].price)) {
+    if (!isValidPrice(edited.price)) {
         printError("Invalid price!");
         return;
     }
 
+    int reserved;
+    {
+        lock_guard<mutex> lock(inventoryWriteMutex);
+        expireReservations();
+        // Held units must stay in stock until their holds end
+        reserved = reservedStock[index];
+        if (edited.quantity >= reserved) {
+            adjustLocationTotals(index, -1);
+            setProductStock(index, edited.quantity);
+            products[index] = edited;
+            adjustLocationTotals(index, 1);
+            publishProductChanges(index, index);
+        }
+    }
+
+    if (edited.quantity < reserved) {
+        printError("Quantity cannot be below the " + to_string(reserved) + " unit(s) currently reserved!");
+        return;
+    }
     printSuccess("Product updated successfully!");
 }
 
@@ -442,7 +1297,13 @@ void deleteProduct() {
         return;
     }
 
-    products[index].active = false;
+    {
+        lock_guard<mutex> lock(inventoryWriteMutex);
+        adjustLocationTotals(index, -1);
+        products[index].active = false;
+        releaseProductReservations(index);
+        publishProductChanges(index, index);
+    }
     printSuccess("Product deleted successfully!");
 }
 
@@ -458,8 +1319,23 @@ void searchProduct() {
         return;
     }
 
-    int index = findProductById(id);
-    if (index == -1) {
+    // Served by a replica when one is attached and caught up. Lapsed holds
+    // are expired first so they are not shown as reserved.
+    refreshReservations();
+    Product product;
+    int reserved = 0;
+    bool found = false;
+    int replica = pickReadReplica();
+    if (replica == -1 || !lookupOnReplica(replica, id, &found, &product, &reserved)) {
+        replica = -1;
+        int index = findProductById(id);
+        found = index != -1;
+        if (found) {
+            product = products[index];
+            reserved = reservedStock[index];
+        }
+    }
+    if (!found) {
         printError("Product not found!");
         return;
     }
@@ -468,21 +1344,124 @@ void searchProduct() {
     cout << "\n================================================================\n";
     cout << "  PRODUCT DETAILS\n";
     cout << "================================================================\n";
-    cout << "ID:           " << products[index].id << "\n";
-    cout << "Name:         " << products[index].name << "\n";
-    cout << "Category:     " << products[index].category << "\n";
-    cout << "Quantity:     " << products[index].quantity << "\n";
-    cout << "Price:        $" << fixed << setprecision(2) << products[index].price << "\n";
+    cout << "ID:           " << product.id << "\n";
+    cout << "Name:         " << product.name << "\n";
+    cout << "Category:     " << product.category << "\n";
+    cout << "Quantity:     " << product.quantity << "\n";
+    cout << "Reserved:     " << reserved << "\n";
+    cout << "Available:    " << max(0, product.quantity - reserved) << "\n";
+    cout << "Price:        $" << fixed << setprecision(2) << product.price << "\n";
     cout << "Status:       ";
 
-    if (products[index].quantity == 0) {
+    if (product.quantity == 0) {
         cout << "OUT OF STOCK\n";
-    } else if (products[index].quantity <= MIN_STOCK_THRESHOLD) {
+    } else if (product.quantity <= MIN_STOCK_THRESHOLD) {
         cout << "LOW STOCK\n";
     } else {
         cout << "IN STOCK\n";
     }
     cout << "================================================================\n";
+    if (replica != -1) {
+        cout << "(served by replica " << replica + 1 << ")\n";
+    }
+}
+
+const int BROWSE_PAGE_SIZE = 10;
+
+// Range listing over the secondary indexes, one page at a time
+void browseProducts() {
+    clearScreen();
+    printTableHeader("BROWSE PRODUCTS");
+
+    cout << "  1. By price range\n";
+    cout << "  2. By quantity range\n";
+    cout << "  3. By category and price range\n";
+    cout << "Enter your choice: ";
+
+    int choice;
+    if (!(cin >> choice) || choice < 1 || choice > 3) {
+        clearInputBuffer();
+        printError("Invalid choice!");
+        return;
+    }
+
+    IndexKind kind = choice == 1 ? INDEX_PRICE : (choice == 2 ? INDEX_QUANTITY : INDEX_CATEGORY_PRICE);
+    string category;
+    if (kind == INDEX_CATEGORY_PRICE) {
+        clearInputBuffer();
+        cout << "Enter Category: ";
+        getline(cin, category);
+        if (!categoryExists(category)) {
+            printError("Category does not exist!");
+            return;
+        }
+    }
+
+    double low, high;
+    cout << "Enter minimum " << (kind == INDEX_QUANTITY ? "quantity" : "price") << ": ";
+    if (!(cin >> low)) {
+        clearInputBuffer();
+        printError("Invalid input!");
+        return;
+    }
+    cout << "Enter maximum " << (kind == INDEX_QUANTITY ? "quantity" : "price") << ": ";
+    if (!(cin >> high) || high < low) {
+        clearInputBuffer();
+        printError("Invalid range!");
+        return;
+    }
+
+    char order;
+    cout << "Sort highest first? (y/n): ";
+    cin >> order;
+    bool descending = (order == 'y' || order == 'Y');
+
+    IndexCursor cursor;
+    cursor.started = false;
+    int page[BROWSE_PAGE_SIZE];
+    int shown = 0;
+
+    while (true) {
+        int count;
+        {
+            lock_guard<mutex> lock(inventoryWriteMutex);
+            int group = kind == INDEX_CATEGORY_PRICE ? indexCategoryId(category) : 0;
+            count = queryIndexRange(kind, group, low, high, descending, &cursor, BROWSE_PAGE_SIZE, page);
+        }
+        if (count == 0) {
+            if (shown == 0) {
+                printWarning("No products in that range.");
+            }
+            return;
+        }
+
+        clearScreen();
+        printTableHeader("BROWSE PRODUCTS");
+        cout << left << setw(6) << "ID" << setw(20) << "Name"
+             << setw(15) << "Category" << setw(10) << "Quantity" << "Price\n";
+        cout << "----------------------------------------------------------------\n";
+        for (int i = 0; i < count; i++) {
+            const Product* product = &products[page[i]];
+            cout << left << setw(6) << product->id
+                 << setw(20) << product->name
+                 << setw(15) << product->category
+                 << setw(10) << product->quantity
+                 << "$" << fixed << setprecision(2) << product->price << "\n";
+        }
+        cout << "----------------------------------------------------------------\n";
+        shown += count;
+        cout << "Showing " << shown - count + 1 << "-" << shown << "\n";
+
+        if (count < BROWSE_PAGE_SIZE) {
+            return;
+        }
+        char more;
+        cout << "Next page? (y/n): ";
+        cin >> more;
+        if (more != 'y' && more != 'Y') {
+            return;
+        }
+    }
 }
 
 // ============================================================
@@ -581,6 +1560,355 @@ void deleteCategory() {
     printSuccess("Category deleted successfully!");
 }
 
+// ============================================================
+// SOURCING GRAPH
+// ============================================================
+// Which suppliers can supply which products, with a unit cost and lead
+// time per link. Links are kept in compressed sparse row form: one array
+// of links sorted by supplier (then product) with a start offset per
+// supplier, and a second offset array that lists link numbers by product.
+// New and changed links go to a small pending list and replaced links are
+// marked removed; once those pile up the arrays are rebuilt in one pass.
+const int SOURCING_MIN_PENDING = 4096;
+
+struct SourcingEdge {
+    int supplier;
+    int product;        // product slot
+    double unitCost;
+    int leadTimeDays;
+    bool removed;
+};
+
+// Compressed links, by supplier
+vector<int> supplierEdgeStart;      // supplier s owns links [start[s], start[s + 1])
+vector<int> edgeProduct;
+vector<double> edgeCost;
+vector<int> edgeLeadTime;
+vector<char> edgeRemoved;
+int removedEdgeCount = 0;
+
+// The same links, by product (link numbers into the arrays above)
+vector<int> productEdgeStart;
+vector<int> productEdgeIds;
+vector<int> productEdgeSupplier;
+
+// Links added since the last rebuild
+vector<SourcingEdge> pendingEdges;
+unordered_map<int, vector<int> > pendingBySupplier;
+unordered_map<int, vector<int> > pendingByProduct;
+
+struct SupplierImpact {
+    int productsSupplied;
+    int soleSourced;             // products with no other active supplier
+    long long soleSourcedUnits;
+    double soleSourcedValue;
+    vector<int> atRisk;          // sole-sourced products that run out before a new
+                                 // supplier could deliver (or are already low)
+};
+
+int compressedSupplierRows() {
+    return supplierEdgeStart.empty() ? 0 : (int)supplierEdgeStart.size() - 1;
+}
+
+int compressedProductRows() {
+    return productEdgeStart.empty() ? 0 : (int)productEdgeStart.size() - 1;
+}
+
+// Live compressed link from supplier to product, or -1
+int findCompressedEdge(int supplier, int product) {
+    if (supplier >= compressedSupplierRows()) {
+        return -1;
+    }
+    vector<int>::const_iterator begin = edgeProduct.begin() + supplierEdgeStart[supplier];
+    vector<int>::const_iterator end = edgeProduct.begin() + supplierEdgeStart[supplier + 1];
+    vector<int>::const_iterator found = lower_bound(begin, end, product);
+    if (found == end || *found != product || edgeRemoved[found - edgeProduct.begin()]) {
+        return -1;
+    }
+    return found - edgeProduct.begin();
+}
+
+// Live pending link from supplier to product, or -1
+int findPendingEdge(int supplier, int product) {
+    unordered_map<int, vector<int> >::const_iterator row = pendingBySupplier.find(supplier);
+    if (row == pendingBySupplier.end()) {
+        return -1;
+    }
+    for (size_t k = 0; k < row->second.size(); k++) {
+        const SourcingEdge* edge = &pendingEdges[row->second[k]];
+        if (edge->product == product && !edge->removed) {
+            return row->second[k];
+        }
+    }
+    return -1;
+}
+
+// Rebuild both offset arrays from every live link. Two counting-sort
+// passes (by product, then by supplier) leave each supplier's links in
+// product order, which findCompressedEdge relies on. O(links).
+void compactSourcingGraph() {
+    vector<SourcingEdge> live;
+    live.reserve(edgeProduct.size() - removedEdgeCount + pendingEdges.size());
+    int supplierRows = supplierCount, productRows = productCount;
+
+    for (int s = 0; s < compressedSupplierRows(); s++) {
+        for (int e = supplierEdgeStart[s]; e < supplierEdgeStart[s + 1]; e++) {
+            if (!edgeRemoved[e]) {
+                SourcingEdge edge = { s, edgeProduct[e], edgeCost[e], edgeLeadTime[e], false };
+                live.push_back(edge);
+            }
+        }
+    }
+    for (size_t k = 0; k < pendingEdges.size(); k++) {
+        if (!pendingEdges[k].removed) {
+            live.push_back(pendingEdges[k]);
+        }
+    }
+    for (size_t k = 0; k < live.size(); k++) {
+        supplierRows = max(supplierRows, live[k].supplier + 1);
+        productRows = max(productRows, live[k].product + 1);
+    }
+
+    // By product first...
+    vector<int> productStart(productRows + 1, 0);
+    for (size_t k = 0; k < live.size(); k++) {
+        productStart[live[k].product + 1]++;
+    }
+    for (int p = 0; p < productRows; p++) {
+        productStart[p + 1] += productStart[p];
+    }
+    vector<int> byProduct(live.size());
+    vector<int> fill(productStart.begin(), productStart.end() - 1);
+    for (size_t k = 0; k < live.size(); k++) {
+        byProduct[fill[live[k].product]++] = k;
+    }
+
+    // ...then a stable pass by supplier
+    supplierEdgeStart.assign(supplierRows + 1, 0);
+    for (size_t k = 0; k < live.size(); k++) {
+        supplierEdgeStart[live[k].supplier + 1]++;
+    }
+    for (int s = 0; s < supplierRows; s++) {
+        supplierEdgeStart[s + 1] += supplierEdgeStart[s];
+    }
+    edgeProduct.resize(live.size());
+    edgeCost.resize(live.size());
+    edgeLeadTime.resize(live.size());
+    edgeRemoved.assign(live.size(), 0);
+    vector<int> edgeOf(live.size());
+    fill.assign(supplierEdgeStart.begin(), supplierEdgeStart.end() - 1);
+    for (size_t k = 0; k < byProduct.size(); k++) {
+        const SourcingEdge* edge = &live[byProduct[k]];
+        int e = fill[edge->supplier]++;
+        edgeProduct[e] = edge->product;
+        edgeCost[e] = edge->unitCost;
+        edgeLeadTime[e] = edge->leadTimeDays;
+        edgeOf[byProduct[k]] = e;
+    }
+
+    // Product rows point at the final link numbers
+    productEdgeStart.swap(productStart);
+    productEdgeIds.resize(live.size());
+    productEdgeSupplier.resize(live.size());
+    for (size_t k = 0; k < byProduct.size(); k++) {
+        productEdgeIds[k] = edgeOf[byProduct[k]];
+        productEdgeSupplier[k] = live[byProduct[k]].supplier;
+    }
+
+    removedEdgeCount = 0;
+    pendingEdges.clear();
+    pendingBySupplier.clear();
+    pendingByProduct.clear();
+}
+
+void compactSourcingGraphIfNeeded() {
+    size_t changes = pendingEdges.size() + removedEdgeCount;
+    if (changes > SOURCING_MIN_PENDING + edgeProduct.size() / 8) {
+        compactSourcingGraph();
+    }
+}
+
+// Add or update the link from supplier to product
+void setSourcingEdge(int supplier, int product, double unitCost, int leadTimeDays) {
+    int pending = findPendingEdge(supplier, product);
+    if (pending != -1) {
+        pendingEdges[pending].unitCost = unitCost;
+        pendingEdges[pending].leadTimeDays = leadTimeDays;
+        return;
+    }
+
+    int compressed = findCompressedEdge(supplier, product);
+    if (compressed != -1) {
+        edgeRemoved[compressed] = 1;
+        removedEdgeCount++;
+    }
+
+    SourcingEdge edge = { supplier, product, unitCost, leadTimeDays, false };
+    pendingEdges.push_back(edge);
+    pendingBySupplier[supplier].push_back(pendingEdges.size() - 1);
+    pendingByProduct[product].push_back(pendingEdges.size() - 1);
+    compactSourcingGraphIfNeeded();
+}
+
+// Remove the link; returns false if there was none
+bool removeSourcingEdge(int supplier, int product) {
+    int pending = findPendingEdge(supplier, product);
+    if (pending != -1) {
+        pendingEdges[pending].removed = true;
+        return true;
+    }
+    int compressed = findCompressedEdge(supplier, product);
+    if (compressed == -1) {
+        return false;
+    }
+    edgeRemoved[compressed] = 1;
+    removedEdgeCount++;
+    compactSourcingGraphIfNeeded();
+    return true;
+}
+
+// Product slots were renumbered (newIndex[old slot], -1 for a product
+// that is gone): move every live link to its new slot, drop the rest and
+// rebuild the arrays
+void renumberSourcingProducts(const vector<int>* newIndex) {
+    vector<SourcingEdge> live;
+    for (int s = 0; s < compressedSupplierRows(); s++) {
+        for (int e = supplierEdgeStart[s]; e < supplierEdgeStart[s + 1]; e++) {
+            if (!edgeRemoved[e]) {
+                SourcingEdge edge = { s, edgeProduct[e], edgeCost[e], edgeLeadTime[e], false };
+                live.push_back(edge);
+            }
+        }
+    }
+    for (size_t k = 0; k < pendingEdges.size(); k++) {
+        if (!pendingEdges[k].removed) {
+            live.push_back(pendingEdges[k]);
+        }
+    }
+
+    supplierEdgeStart.clear();
+    productEdgeStart.clear();
+    edgeProduct.clear();
+    edgeRemoved.clear();
+    removedEdgeCount = 0;
+    pendingEdges.clear();
+    pendingBySupplier.clear();
+    pendingByProduct.clear();
+    for (size_t k = 0; k < live.size(); k++) {
+        int product = live[k].product < (int)newIndex->size() ? (*newIndex)[live[k].product] : -1;
+        if (product != -1) {
+            live[k].product = product;
+            pendingEdges.push_back(live[k]);
+        }
+    }
+    compactSourcingGraph();
+}
+
+// Append the supplier's live links to `out` (in product order for the
+// compressed part, then recent changes)
+void getSupplierProducts(int supplier, vector<SourcingEdge>* out) {
+    if (supplier < compressedSupplierRows()) {
+        for (int e = supplierEdgeStart[supplier]; e < supplierEdgeStart[supplier + 1]; e++) {
+            if (!edgeRemoved[e]) {
+                SourcingEdge edge = { supplier, edgeProduct[e], edgeCost[e], edgeLeadTime[e], false };
+                out->push_back(edge);
+            }
+        }
+    }
+    unordered_map<int, vector<int> >::const_iterator row = pendingBySupplier.find(supplier);
+    if (row != pendingBySupplier.end()) {
+        for (size_t k = 0; k < row->second.size(); k++) {
+            if (!pendingEdges[row->second[k]].removed) {
+                out->push_back(pendingEdges[row->second[k]]);
+            }
+        }
+    }
+}
+
+// Append the product's live links to `out`, whatever the supplier's status
+void getProductSuppliers(int product, vector<SourcingEdge>* out) {
+    if (product < compressedProductRows()) {
+        for (int k = productEdgeStart[product]; k < productEdgeStart[product + 1]; k++) {
+            int e = productEdgeIds[k];
+            if (!edgeRemoved[e]) {
+                SourcingEdge edge = { productEdgeSupplier[k], product, edgeCost[e], edgeLeadTime[e], false };
+                out->push_back(edge);
+            }
+        }
+    }
+    unordered_map<int, vector<int> >::const_iterator row = pendingByProduct.find(product);
+    if (row != pendingByProduct.end()) {
+        for (size_t k = 0; k < row->second.size(); k++) {
+            if (!pendingEdges[row->second[k]].removed) {
+                out->push_back(pendingEdges[row->second[k]]);
+            }
+        }
+    }
+}
+
+// Cheapest active supplier for a product (call by address); -1 if none
+int findCheapestSupplier(int product, double* unitCost, int* leadTimeDays) {
+    vector<SourcingEdge> links;
+    getProductSuppliers(product, &links);
+
+    int best = -1;
+    for (size_t k = 0; k < links.size(); k++) {
+        if (!suppliers[links[k].supplier].active) {
+            continue;
+        }
+        if (best == -1 || links[k].unitCost < *unitCost ||
+            (links[k].unitCost == *unitCost && links[k].leadTimeDays < *leadTimeDays)) {
+            best = links[k].supplier;
+            *unitCost = links[k].unitCost;
+            *leadTimeDays = links[k].leadTimeDays;
+        }
+    }
+    return best;
+}
+
+// What losing a supplier would do to stock (call by address)
+void getSupplierImpact(int supplier, SupplierImpact* impact) {
+    impact->productsSupplied = 0;
+    impact->soleSourced = 0;
+    impact->soleSourcedUnits = 0;
+    impact->soleSourcedValue = 0.0;
+    impact->atRisk.clear();
+
+    vector<SourcingEdge> supplied, alternatives;
+    getSupplierProducts(supplier, &supplied);
+    long long now = time(0);
+
+    for (size_t k = 0; k < supplied.size(); k++) {
+        int product = supplied[k].product;
+        if (product >= productCount || !products[product].active) {
+            continue;
+        }
+        impact->productsSupplied++;
+
+        alternatives.clear();
+        getProductSuppliers(product, &alternatives);
+        bool hasOther = false;
+        for (size_t a = 0; a < alternatives.size() && !hasOther; a++) {
+            hasOther = alternatives[a].supplier != supplier && suppliers[alternatives[a].supplier].active;
+        }
+        if (hasOther) {
+            continue;
+        }
+
+        impact->soleSourced++;
+        impact->soleSourcedUnits += products[product].quantity;
+        impact->soleSourcedValue += products[product].quantity * products[product].price;
+
+        double smoothedRate, windowRate, daysOfCover;
+        long long stockOutDate;
+        getDemandForecast(product, now, &smoothedRate, &windowRate, &daysOfCover, &stockOutDate);
+        if (products[product].quantity <= MIN_STOCK_THRESHOLD ||
+            (daysOfCover >= 0 && daysOfCover < supplied[k].leadTimeDays)) {
+            impact->atRisk.push_back(product);
+        }
+    }
+}
+
 // ============================================================
 // SUPPLIER MANAGEMENT
 // ============================================================
@@ -659,228 +1987,6507 @@ void deleteSupplier() {
         return;
     }
 
-    suppliers[index].active = false;
-    printSuccess("Supplier deleted successfully!");
-}
+    // Show what losing this supplier would leave uncovered
+    SupplierImpact impact;
+    getSupplierImpact(index, &impact);
+    if (impact.productsSupplied > 0) {
+        cout << "\nProducts supplied:        " << impact.productsSupplied << "\n";
+        cout << "No other supplier:        " << impact.soleSourced << "\n";
+        cout << "Units without a supplier: " << impact.soleSourcedUnits << "\n";
+        cout << "Value without a supplier: $" << fixed << setprecision(2) << impact.soleSourcedValue << "\n";
+
+        if (!impact.atRisk.empty()) {
+            printWarning("These products will run out before a new supplier could deliver:");
+            for (size_t k = 0; k < impact.atRisk.size(); k++) {
+                cout << "  - " << products[impact.atRisk[k]].name
+                     << " (" << products[impact.atRisk[k]].quantity << " left)\n";
+            }
+        }
 
-// ============================================================
-// TRANSACTION & PURCHASE MANAGEMENT
-// ============================================================
-void recordTransaction(int productId, string productName, int quantity,
-                       double unitPrice, double discount, double total) {
-    if (transactionCount >= MAX_TRANSACTIONS) {
-        printWarning("Transaction history limit reached!");
-        return;
+        char confirm;
+        cout << "\nDelete this supplier anyway? (y/n): ";
+        cin >> confirm;
+        if (confirm != 'y' && confirm != 'Y') {
+            printWarning("Supplier not deleted.");
+            return;
+        }
     }
 
-    Transaction trans;
-    trans.transactionId = nextTransactionId++;
-    trans.productId = productId;
-    trans.productName = productName;
-    trans.quantity = quantity;
-    trans.unitPrice = unitPrice;
-    trans.discount = discount;
-    trans.totalPrice = total;
-    trans.date = getCurrentDate();
-    trans.time = getCurrentTime();
-
-    transactions[transactionCount++] = trans;
+    suppliers[index].active = false;
+    printSuccess("Supplier deleted successfully!");
 }
 
-// Calculate discount using call by reference (pointers)
-void calculateDiscount(int quantity, double subtotal, double* discount, double* total) {
-    *discount = 0.0;
-
-    // Apply bulk discount if quantity meets threshold
-    if (quantity >= BULK_DISCOUNT_THRESHOLD) {
-        *discount = subtotal * BULK_DISCOUNT_RATE;
-    }
+// Add, update or remove the link between a supplier and a product. A
+// zero unit cost is a valid link (e.g. free samples).
+void linkProductSupplier() {
+    clearScreen();
+    printTableHeader("LINK PRODUCT TO SUPPLIER");
 
-    *total = subtotal - *discount;
-}
+    string name;
+    clearInputBuffer();
+    cout << "Enter Supplier Name: ";
+    getline(cin, name);
 
-// Update inventory using pointer (call by address)
-void updateInventoryStock(Product* product, int quantitySold) {
-    if (product == NULL) {
-        printError("Invalid product pointer!");
+    int supplier = findSupplierByName(name);
+    if (supplier == -1) {
+        printError("Supplier not found!");
         return;
     }
 
-    if (product->quantity < quantitySold) {
-        printError("Insufficient stock!");
+    int id;
+    cout << "Enter Product ID: ";
+    if (!(cin >> id)) {
+        clearInputBuffer();
+        printError("Invalid input! ID must be a number.");
+        return;
+    }
+    int product = findProductById(id);
+    if (product == -1) {
+        printError("Product not found!");
         return;
     }
 
-    product->quantity -= quantitySold;
-}
+    int action;
+    cout << "  1. Add or update the link\n";
+    cout << "  2. Remove the link\n";
+    cout << "Enter your choice: ";
+    if (!(cin >> action) || action < 1 || action > 2) {
+        clearInputBuffer();
+        printError("Invalid choice!");
+        return;
+    }
 
-// Get product statistics using pointers (call by address)
-void getProductStatistics(int* totalProducts, int* lowStock, int* outOfStock, double* totalValue) {
-    *totalProducts = 0;
-    *lowStock = 0;
-    *outOfStock = 0;
-    *totalValue = 0.0;
+    if (action == 2) {
+        if (removeSourcingEdge(supplier, product)) {
+            printSuccess("Link removed!");
+        } else {
+            printWarning("That supplier does not supply this product.");
+        }
+        return;
+    }
 
-    for (int i = 0; i < productCount; i++) {
-        if (products[i].active) {
-            (*totalProducts)++;
-            *totalValue += products[i].price * products[i].quantity;
+    double unitCost;
+    cout << "Enter Unit Cost: $";
+    if (!(cin >> unitCost) || unitCost < 0) {
+        clearInputBuffer();
+        printError("Invalid cost!");
+        return;
+    }
 
-            if (products[i].quantity == 0) {
-                (*outOfStock)++;
-            } else if (products[i].quantity <= MIN_STOCK_THRESHOLD) {
-                (*lowStock)++;
-            }
-        }
+    int leadTimeDays;
+    cout << "Enter Lead Time (days): ";
+    if (!(cin >> leadTimeDays) || leadTimeDays < 0) {
+        clearInputBuffer();
+        printError("Invalid lead time!");
+        return;
     }
+
+    setSourcingEdge(supplier, product, unitCost, leadTimeDays);
+    printSuccess("Supplier linked to product!");
 }
 
-void purchaseProduct() {
+void viewSupplierProducts() {
     clearScreen();
-    printTableHeader("PURCHASE PRODUCT");
+    printTableHeader("PRODUCTS BY SUPPLIER");
 
     string name;
     clearInputBuffer();
-    cout << "Enter Product Name: ";
+    cout << "Enter Supplier Name: ";
     getline(cin, name);
 
-    if (name.empty()) {
-        printError("Product name cannot be empty!");
+    int supplier = findSupplierByName(name);
+    if (supplier == -1) {
+        printError("Supplier not found!");
         return;
     }
 
-    int index = findProductByName(name);
-    if (index == -1) {
-        printError("Product not found!");
-        return;
+    vector<SourcingEdge> links;
+    getSupplierProducts(supplier, &links);
+
+    cout << left << setw(6) << "ID" << setw(20) << "Product" << setw(10) << "Quantity"
+         << setw(12) << "Unit Cost" << "Lead Time\n";
+    cout << "----------------------------------------------------------------\n";
+    int shown = 0;
+    for (size_t k = 0; k < links.size(); k++) {
+        if (links[k].product >= productCount || !products[links[k].product].active) {
+            continue;
+        }
+        const Product* product = &products[links[k].product];
+        cout << left << setw(6) << product->id
+             << setw(20) << product->name
+             << setw(10) << product->quantity
+             << "$" << setw(11) << fixed << setprecision(2) << links[k].unitCost
+             << links[k].leadTimeDays << " days\n";
+        shown++;
     }
+    cout << "----------------------------------------------------------------\n";
+    cout << "Products supplied: " << shown << "\n";
+}
 
-    int quantity;
-    cout << "Enter Quantity to Purchase: ";
-    if (!(cin >> quantity)) {
+void viewProductSuppliers() {
+    clearScreen();
+    printTableHeader("SUPPLIERS FOR PRODUCT");
+
+    int id;
+    cout << "Enter Product ID: ";
+    if (!(cin >> id)) {
         clearInputBuffer();
-        printError("Invalid input! Quantity must be a number.");
+        printError("Invalid input! ID must be a number.");
         return;
     }
-
-    if (quantity <= 0) {
-        printError("Invalid quantity! Must be positive.");
+    int product = findProductById(id);
+    if (product == -1) {
+        printError("Product not found!");
         return;
     }
 
-    if (products[index].quantity < quantity) {
-        printError("Insufficient stock!");
-        cout << "Available: " << products[index].quantity << "\n";
-        cout << "Requested: " << quantity << "\n";
+    vector<SourcingEdge> links;
+    getProductSuppliers(product, &links);
+    double cheapestCost = 0.0;
+    int cheapestLead = 0;
+    int cheapest = findCheapestSupplier(product, &cheapestCost, &cheapestLead);
+
+    cout << "Product: " << products[product].name << "\n\n";
+    cout << left << setw(25) << "Supplier" << setw(12) << "Unit Cost" << setw(12) << "Lead Time" << "\n";
+    cout << "----------------------------------------------------------------\n";
+    for (size_t k = 0; k < links.size(); k++) {
+        if (!suppliers[links[k].supplier].active) {
+            continue;
+        }
+        cout << left << setw(25) << suppliers[links[k].supplier].name
+             << "$" << setw(11) << fixed << setprecision(2) << links[k].unitCost
+             << setw(12) << (to_string(links[k].leadTimeDays) + " days")
+             << (links[k].supplier == cheapest ? "CHEAPEST" : "") << "\n";
+    }
+    cout << "----------------------------------------------------------------\n";
+    if (cheapest == -1) {
+        printWarning("No active supplier for this product!");
+    }
+}
+
+// ============================================================
+// LOCATION MANAGEMENT
+// ============================================================
+void displayLocationsTable() {
+    if (locationCount == 0) {
+        printError("No locations available!");
         return;
     }
 
+    clearScreen();
+    printTableHeader("ALL LOCATIONS");
+
+    shared_ptr<const InventorySnapshot> snapshot = acquireSnapshot();
+
+    cout << left << setw(4) << "#" << setw(20) << "Name" << setw(25) << "Address"
+         << setw(8) << "Units" << "Value\n";
+    cout << "----------------------------------------------------------------\n";
+
+    for (int l = 0; l < locationCount; l++) {
+        if (locations[l].active) {
+            long long units;
+            double value;
+            getLocationStatistics(snapshot.get(), l, &units, &value);
+
+            cout << left << setw(4) << (l + 1)
+                 << setw(20) << locations[l].name
+                 << setw(25) << locations[l].address
+                 << setw(8) << units
+                 << "$" << fixed << setprecision(2) << value << "\n";
+        }
+    }
+    cout << "----------------------------------------------------------------\n";
+}
+
+void addLocation() {
+    if (locationCount >= MAX_LOCATIONS) {
+        printError("Location limit reached!");
+        return;
+    }
+
+    clearScreen();
+    printTableHeader("ADD NEW LOCATION");
+
+    Location newLocation;
+
+    clearInputBuffer();
+    cout << "Enter Location Name: ";
+    getline(cin, newLocation.name);
+
+    if (newLocation.name.empty()) {
+        printError("Location name cannot be empty!");
+        return;
+    }
+
+    if (findLocationByName(newLocation.name) != -1) {
+        printError("Location already exists!");
+        return;
+    }
+
+    cout << "Enter Address: ";
+    getline(cin, newLocation.address);
+
+    newLocation.active = true;
+    {
+        lock_guard<mutex> lock(inventoryWriteMutex);
+        for (int i = 0; i < productCount; i++) {
+            locationStock[i][locationCount] = 0;
+        }
+        locationUnits[locationCount] = 0;
+        locationValue[locationCount] = 0.0;
+        locations[locationCount++] = newLocation;
+        logLocationAdded(locationCount - 1);
+        publishProductChanges(0, -1);
+    }
+
+    printSuccess("Location added successfully!");
+}
+
+void viewProductLocations() {
+    clearScreen();
+    printTableHeader("STOCK BY LOCATION");
+
+    int id;
+    cout << "Enter Product ID: ";
+    if (!(cin >> id)) {
+        clearInputBuffer();
+        printError("Invalid input! ID must be a number.");
+        return;
+    }
+
+    int index = findProductById(id);
+    if (index == -1) {
+        printError("Product not found!");
+        return;
+    }
+
+    cout << "\nProduct: " << products[index].name << "\n";
+    cout << "----------------------------------------------------------------\n";
+    cout << left << setw(25) << "Location" << "Quantity\n";
+    cout << "----------------------------------------------------------------\n";
+
+    for (int l = 0; l < locationCount; l++) {
+        if (locations[l].active) {
+            cout << left << setw(25) << locations[l].name << locationStock[index][l] << "\n";
+        }
+    }
+    cout << "----------------------------------------------------------------\n";
+    cout << left << setw(25) << "Total" << products[index].quantity << "\n";
+}
+
+void transferProductStock() {
+    clearScreen();
+    printTableHeader("TRANSFER STOCK");
+
+    int id;
+    cout << "Enter Product ID: ";
+    if (!(cin >> id)) {
+        clearInputBuffer();
+        printError("Invalid input! ID must be a number.");
+        return;
+    }
+
+    int index = findProductById(id);
+    if (index == -1) {
+        printError("Product not found!");
+        return;
+    }
+
+    string fromName, toName;
+    clearInputBuffer();
+    cout << "Enter Source Location: ";
+    getline(cin, fromName);
+    cout << "Enter Destination Location: ";
+    getline(cin, toName);
+
+    int from = findLocationByName(fromName);
+    int to = findLocationByName(toName);
+    if (from == -1 || to == -1) {
+        printError("Location not found!");
+        return;
+    }
+
+    if (from == to) {
+        printError("Source and destination must differ!");
+        return;
+    }
+
+    int quantity;
+    cout << "Enter Quantity to Transfer: ";
+    if (!(cin >> quantity)) {
+        clearInputBuffer();
+        printError("Invalid input! Quantity must be a number.");
+        return;
+    }
+
+    if (quantity <= 0) {
+        printError("Invalid quantity! Must be positive.");
+        return;
+    }
+
+    if (!transferStock(index, from, to, quantity)) {
+        printError("Insufficient stock at source location!");
+        cout << "Available at " << fromName << ": " << locationStock[index][from] << "\n";
+        return;
+    }
+
+    printSuccess("Stock transferred successfully!");
+}
+
+// ============================================================
+// DEMAND FORECASTING
+// ============================================================
+// Each product keeps an exponentially smoothed sales rate and a rolling
+// window of daily unit counts, both updated in O(1) as sales are recorded.
+// The smoothed rate is a time-decayed sum: every sold unit counts 1/tau
+// units per day and fades with a half-life of DEMAND_HALF_LIFE_DAYS, so
+// it can also be rebuilt from the history by adding up decayed weights.
+const double DEMAND_HALF_LIFE_DAYS = 7.0;
+const int DEMAND_WINDOW_DAYS = 7;
+const int SECONDS_PER_DAY = 86400;
+const double DEMAND_TAU_DAYS = DEMAND_HALF_LIFE_DAYS / 0.69314718055994530942; // half-life / ln 2
+
+// Columns indexed like products[] (struct of arrays for the batch path)
+double demandRate[MAX_ITEMS];                        // units/day as of demandUpdatedAt
+long long demandUpdatedAt[MAX_ITEMS];                // seconds since epoch
+int demandWindow[MAX_ITEMS][DEMAND_WINDOW_DAYS];     // units sold per day (ring)
+int demandWindowTotal[MAX_ITEMS];
+long long demandWindowDay[MAX_ITEMS];                // day number of the newest bucket
+
+void resetDemandForecast(int index) {
+    demandRate[index] = 0.0;
+    demandUpdatedAt[index] = 0;
+    for (int d = 0; d < DEMAND_WINDOW_DAYS; d++) {
+        demandWindow[index][d] = 0;
+    }
+    demandWindowTotal[index] = 0;
+    demandWindowDay[index] = 0;
+}
+
+// Move the window forward to `day`, clearing the buckets that fell out
+void advanceDemandWindow(int index, long long day) {
+    long long gap = day - demandWindowDay[index];
+    if (gap <= 0) {
+        return;
+    }
+    if (gap >= DEMAND_WINDOW_DAYS) {
+        for (int d = 0; d < DEMAND_WINDOW_DAYS; d++) {
+            demandWindow[index][d] = 0;
+        }
+        demandWindowTotal[index] = 0;
+    } else {
+        for (long long d = demandWindowDay[index] + 1; d <= day; d++) {
+            int bucket = (int)(d % DEMAND_WINDOW_DAYS);
+            demandWindowTotal[index] -= demandWindow[index][bucket];
+            demandWindow[index][bucket] = 0;
+        }
+    }
+    demandWindowDay[index] = day;
+}
+
+// Fold one sale into the product's forecast; O(1)
+void updateDemandForecast(int index, int quantity, long long when) {
+    if (when > demandUpdatedAt[index]) {
+        double elapsedDays = (double)(when - demandUpdatedAt[index]) / SECONDS_PER_DAY;
+        demandRate[index] *= exp(-elapsedDays / DEMAND_TAU_DAYS);
+        demandUpdatedAt[index] = when;
+    }
+    demandRate[index] += quantity / DEMAND_TAU_DAYS;
+
+    long long day = when / SECONDS_PER_DAY;
+    advanceDemandWindow(index, day);
+    if (day > demandWindowDay[index] - DEMAND_WINDOW_DAYS) {
+        int bucket = (int)(day % DEMAND_WINDOW_DAYS);
+        demandWindow[index][bucket] += quantity;
+        demandWindowTotal[index] += quantity;
+    }
+}
+
+// Forecast for one product as of `now` (call by address). daysOfCover is
+// negative and stockOutDate 0 when there are no recent sales.
+void getDemandForecast(int index, long long now, double* smoothedRate, double* windowRate,
+                       double* daysOfCover, long long* stockOutDate) {
+    double elapsedDays = (double)max(0LL, now - demandUpdatedAt[index]) / SECONDS_PER_DAY;
+    *smoothedRate = demandRate[index] * exp(-elapsedDays / DEMAND_TAU_DAYS);
+
+    // Only the buckets that are still inside the window as of today count
+    long long today = now / SECONDS_PER_DAY;
+    int recentUnits = 0;
+    for (long long d = today - DEMAND_WINDOW_DAYS + 1; d <= today; d++) {
+        if (d <= demandWindowDay[index] && d > demandWindowDay[index] - DEMAND_WINDOW_DAYS) {
+            recentUnits += demandWindow[index][(int)(d % DEMAND_WINDOW_DAYS)];
+        }
+    }
+    *windowRate = (double)recentUnits / DEMAND_WINDOW_DAYS;
+
+    *daysOfCover = -1.0;
+    *stockOutDate = 0;
+    if (*smoothedRate > 1e-9) {
+        *daysOfCover = products[index].quantity / *smoothedRate;
+        *stockOutDate = now + (long long)(*daysOfCover * SECONDS_PER_DAY);
+    }
+}
+
+// Rebuild the forecasts of products [first, last). The history is read in
+// order and only this range's sales are kept; their weights are computed
+// a block at a time in a flat loop, then added to their products.
+void accumulateDemandRange(int first, int last, const vector<int>* productOf, long long now) {
+    const int BLOCK = 256;
+    int picked[BLOCK];
+    double weights[BLOCK];
+    long long today = now / SECONDS_PER_DAY;
+
+    for (int begin = 0; begin < transactionCount; begin += BLOCK) {
+        int end = min(transactionCount, begin + BLOCK);
+        int count = 0;
+        for (int t = begin; t < end; t++) {
+            if ((*productOf)[t] >= first && (*productOf)[t] < last) {
+                picked[count++] = t;
+            }
+        }
+        for (int k = 0; k < count; k++) {
+            double ageDays = (double)(now - transactions[picked[k]].timestamp) / SECONDS_PER_DAY;
+            weights[k] = transactions[picked[k]].quantity * exp(-max(0.0, ageDays) / DEMAND_TAU_DAYS);
+        }
+        for (int k = 0; k < count; k++) {
+            const Transaction* trans = &transactions[picked[k]];
+            int index = (*productOf)[picked[k]];
+            demandRate[index] += weights[k];
+
+            long long age = today - trans->timestamp / SECONDS_PER_DAY;
+            if (age >= 0 && age < DEMAND_WINDOW_DAYS) {
+                demandWindow[index][(int)((today - age) % DEMAND_WINDOW_DAYS)] += trans->quantity;
+                demandWindowTotal[index] += trans->quantity;
+            }
+        }
+    }
+    for (int i = first; i < last; i++) {
+        demandRate[i] /= DEMAND_TAU_DAYS;
+        demandUpdatedAt[i] = now;
+        demandWindowDay[i] = today;
+    }
+}
+
+// Rebuild every forecast from the transaction history (backfill). Each
+// thread owns a range of products holding about the same number of sales
+// and writes their forecasts directly, so no thread needs arrays sized
+// for every product. The caller must hold inventoryWriteMutex.
+void rebuildDemandForecasts(long long now) {
+    // Map each transaction to its product slot once
+    unordered_map<int, int> slotOfId;
+    slotOfId.reserve(productCount * 2 + 16);
+    for (int i = 0; i < productCount; i++) {
+        resetDemandForecast(i);
+        if (products[i].active || slotOfId.count(products[i].id) == 0) {
+            slotOfId[products[i].id] = i;
+        }
+    }
+    vector<int> salesBefore(productCount + 1, 0);   // prefix counts of sales by slot
+    vector<int> productOf(transactionCount, -1);
+    for (int t = 0; t < transactionCount; t++) {
+        unordered_map<int, int>::const_iterator found = slotOfId.find(transactions[t].productId);
+        if (found != slotOfId.end()) {
+            productOf[t] = found->second;
+            salesBefore[found->second + 1]++;
+        }
+    }
+    for (int i = 0; i < productCount; i++) {
+        salesBefore[i + 1] += salesBefore[i];
+    }
+
+    int threadCount = max(1, (int)thread::hardware_concurrency());
+    threadCount = min(threadCount, max(1, transactionCount / 100000));
+
+    vector<int> bounds(threadCount + 1, productCount);
+    bounds[0] = 0;
+    for (int w = 1; w < threadCount; w++) {
+        int target = (int)((long long)salesBefore[productCount] * w / threadCount);
+        int bound = (int)(lower_bound(salesBefore.begin(), salesBefore.end() - 1, target) - salesBefore.begin());
+        bounds[w] = max(bounds[w - 1], bound);
+    }
+
+    vector<thread> workers;
+    for (int w = 1; w < threadCount; w++) {
+        workers.push_back(thread(accumulateDemandRange, bounds[w], bounds[w + 1], &productOf, now));
+    }
+    accumulateDemandRange(bounds[0], bounds[1], &productOf, now);
+    for (size_t w = 0; w < workers.size(); w++) {
+        workers[w].join();
+    }
+}
+
+void viewDemandForecast() {
+    clearScreen();
+    printTableHeader("DEMAND FORECAST");
+
+    long long now = time(0);
+
+    cout << left << setw(6) << "ID" << setw(20) << "Product" << setw(6) << "Qty"
+         << setw(10) << "Units/Day" << setw(10) << "7-Day Avg"
+         << setw(12) << "Days Cover" << "Stock-Out\n";
+    cout << "--------------------------------------------------------------------------------\n";
+
+    for (int i = 0; i < productCount; i++) {
+        if (!products[i].active) {
+            continue;
+        }
+
+        double smoothedRate, windowRate, daysOfCover;
+        long long stockOutDate;
+        getDemandForecast(i, now, &smoothedRate, &windowRate, &daysOfCover, &stockOutDate);
+
+        cout << left << setw(6) << products[i].id
+             << setw(20) << products[i].name
+             << setw(6) << products[i].quantity
+             << setw(10) << fixed << setprecision(2) << smoothedRate
+             << setw(10) << fixed << setprecision(2) << windowRate;
+
+        if (daysOfCover < 0) {
+            cout << setw(12) << "-" << "No recent sales\n";
+        } else {
+            cout << setw(12) << fixed << setprecision(1) << daysOfCover
+                 << formatDate((time_t)stockOutDate) << "\n";
+        }
+    }
+    cout << "--------------------------------------------------------------------------------\n";
+    cout << "Smoothed rate half-life: " << fixed << setprecision(1) << DEMAND_HALF_LIFE_DAYS << " days\n";
+}
+
+// ============================================================
+// INVOICE RENDERING
+// ============================================================
+// A sale only copies its invoice details into a bounded queue; a
+// background thread formats queued invoices in batches and writes each
+// batch with one write and one flush, to the terminal or a spool file.
+// When the queue is full the seller waits for the renderer to catch up.
+// On the terminal the menu prints its invoice itself (printInvoice): it
+// has to be on screen before the menu returns, so there is nothing to
+// hand off.
+const int INVOICE_QUEUE_CAPACITY = 1024;
+const int INVOICE_BATCH_SIZE = 64;      // render once this many are queued...
+const int INVOICE_LINGER_MS = 2;        // ...or this long after the first one
+const int INVOICE_PRODUCT_WIDTH = 25;
+
+struct InvoiceJob {
+    int transactionId;           // 0 when the history was full
+    string productName;
+    int quantity;
+    double unitPrice;
+    double subtotal;
+    double discount;
+    double total;
+    long long timestamp;         // when the sale was recorded
+    bool lowStock;
+};
+
+InvoiceJob invoiceQueue[INVOICE_QUEUE_CAPACITY];
+long long invoiceHead = 0;       // next job to render
+long long invoiceTail = 0;       // next free slot
+long long invoicesRendered = 0;
+long long invoicesLost = 0;      // rendered but not written to the output
+mutex invoiceQueueMutex;
+condition_variable invoiceQueued;
+condition_variable invoiceSpaceFreed;
+bool invoiceRendererStop = false;
+bool invoiceRendererRunning = false;
+thread invoiceRenderer;
+FILE* invoiceOutput = NULL;      // stdout or the spool file
+string invoiceSpoolPath;         // empty when rendering to the terminal
+
+// Append one invoice to `out` in the same layout the menu always printed
+void renderInvoice(const InvoiceJob* job, string* out) {
+    char buffer[1024];
+    const char* rule = "================================================================\n";
+    const char* line = "----------------------------------------------------------------\n";
+    time_t moment = (time_t)job->timestamp;
+    int length = 0;
+
+    length += snprintf(buffer + length, sizeof(buffer) - length,
+                       "\n%s                         INVOICE                                \n%s", rule, rule);
+    if (job->transactionId > 0) {
+        length += snprintf(buffer + length, sizeof(buffer) - length,
+                           "Transaction ID: %d\n", job->transactionId);
+    } else {
+        length += snprintf(buffer + length, sizeof(buffer) - length,
+                           "Transaction ID: (not recorded, history full)\n");
+    }
+    length += snprintf(buffer + length, sizeof(buffer) - length,
+                       "Date: %s  Time: %s\n%s%-25s%-10s%-12sAmount\n%s",
+                       formatDate(moment).c_str(), formatTime(moment).c_str(),
+                       line, "Product", "Qty", "Unit Price", line);
+    out->append(buffer, min(length, (int)sizeof(buffer) - 1));
+
+    // The name goes in whole, however long, padded like the header
+    out->append(job->productName);
+    out->append(max(1, INVOICE_PRODUCT_WIDTH - (int)job->productName.size()), ' ');
+    length = 0;
+    length += snprintf(buffer + length, sizeof(buffer) - length,
+                       "%-10d$%-11.2f$%.2f\n%s%47s%.2f\n",
+                       job->quantity, job->unitPrice, job->subtotal,
+                       line, "Subtotal: $", job->subtotal);
+    if (job->discount > 0) {
+        length += snprintf(buffer + length, sizeof(buffer) - length,
+                           "%47s%.2f\n\n[WARNING] Bulk discount applied!\n",
+                           "Discount (10%): -$", job->discount);
+    }
+    length += snprintf(buffer + length, sizeof(buffer) - length,
+                       "%47s%.2f\n%s", "TOTAL: $", job->total, rule);
+    if (job->lowStock) {
+        length += snprintf(buffer + length, sizeof(buffer) - length,
+                           "\n[WARNING] Low stock alert for this product!\n");
+    }
+    out->append(buffer, min(length, (int)sizeof(buffer) - 1));
+}
+
+void runInvoiceRenderer() {
+    vector<InvoiceJob> batch;
+    string text;
+
+    unique_lock<mutex> lock(invoiceQueueMutex);
+    while (true) {
+        while (!invoiceRendererStop && invoiceHead == invoiceTail) {
+            invoiceQueued.wait(lock);
+        }
+
+        // Give a batch a moment to build up, unless someone is waiting
+        chrono::steady_clock::time_point deadline =
+            chrono::steady_clock::now() + chrono::milliseconds(INVOICE_LINGER_MS);
+        while (!invoiceRendererStop && invoiceTail - invoiceHead < INVOICE_BATCH_SIZE) {
+            if (invoiceQueued.wait_until(lock, deadline) == cv_status::timeout) {
+                break;
+            }
+        }
+        if (invoiceHead == invoiceTail) {
+            return; // stopping and drained
+        }
+
+        // Take everything queued so far, then format without the lock
+        batch.clear();
+        for (long long k = invoiceHead; k < invoiceTail; k++) {
+            batch.push_back(invoiceQueue[k % INVOICE_QUEUE_CAPACITY]);
+        }
+        invoiceHead = invoiceTail;
+        lock.unlock();
+        invoiceSpaceFreed.notify_all();
+
+        text.clear();
+        for (size_t k = 0; k < batch.size(); k++) {
+            renderInvoice(&batch[k], &text);
+        }
+        bool written = fwrite(text.data(), 1, text.size(), invoiceOutput) == text.size();
+        written = fflush(invoiceOutput) == 0 && written;
+        if (!written) {
+            fprintf(stderr, "\n[ERROR] Could not write %d invoice(s) to %s: %s\n", (int)batch.size(),
+                    invoiceSpoolPath.empty() ? "the terminal" : invoiceSpoolPath.c_str(), strerror(errno));
+            clearerr(invoiceOutput);
+        }
+
+        lock.lock();
+        invoicesRendered += batch.size();
+        if (!written) {
+            invoicesLost += batch.size();
+        }
+    }
+}
+
+// Start the renderer; spoolPath NULL renders to the terminal. Returns
+// false if the spool file cannot be opened.
+bool startInvoiceRenderer(const char* spoolPath) {
+    FILE* output = stdout;
+    if (spoolPath != NULL) {
+        output = fopen(spoolPath, "ab");
+        if (output == NULL) {
+            return false;
+        }
+    }
+
+    invoiceOutput = output;
+    invoiceSpoolPath = spoolPath != NULL ? spoolPath : "";
+    invoiceRendererStop = false;
+    invoiceRendererRunning = true;
+    invoiceRenderer = thread(runInvoiceRenderer);
+    return true;
+}
+
+// Render whatever is still queued, then stop the renderer
+void stopInvoiceRenderer() {
+    if (!invoiceRendererRunning) {
+        return;
+    }
+    {
+        lock_guard<mutex> lock(invoiceQueueMutex);
+        invoiceRendererStop = true;
+    }
+    invoiceQueued.notify_one();
+    invoiceRenderer.join();
+    invoiceRendererRunning = false;
+
+    if (invoiceOutput != stdout) {
+        fclose(invoiceOutput);
+    }
+    invoiceOutput = NULL;
+}
+
+// Render an invoice on the calling thread and show it on the terminal
+void printInvoice(const InvoiceJob* job) {
+    string text;
+    renderInvoice(job, &text);
+    fwrite(text.data(), 1, text.size(), stdout);
+}
+
+// Queue an invoice (call by address). Blocks while the queue is full.
+void submitInvoice(const InvoiceJob* job) {
+    if (!invoiceRendererRunning) {
+        printInvoice(job);
+        return;
+    }
+
+    unique_lock<mutex> lock(invoiceQueueMutex);
+    while (invoiceTail - invoiceHead >= INVOICE_QUEUE_CAPACITY) {
+        invoiceSpaceFreed.wait(lock);
+    }
+    invoiceQueue[invoiceTail % INVOICE_QUEUE_CAPACITY] = *job;
+    invoiceTail++;
+    long long queued = invoiceTail - invoiceHead;
+    lock.unlock();
+
+    // The renderer waits for the first job, then for a full batch
+    if (queued == 1 || queued == INVOICE_BATCH_SIZE) {
+        invoiceQueued.notify_one();
+    }
+}
+
+void configureInvoiceOutput() {
+    clearScreen();
+    printTableHeader("INVOICE OUTPUT");
+
+    cout << "Invoices currently go to: "
+         << (invoiceSpoolPath.empty() ? "terminal" : invoiceSpoolPath) << "\n\n";
+    long long lost;
+    {
+        lock_guard<mutex> lock(invoiceQueueMutex);
+        lost = invoicesLost;
+    }
+    if (lost > 0) {
+        printWarning(to_string(lost) + " invoice(s) could not be written to their output.");
+        cout << "\n";
+    }
+    cout << "  1. Terminal\n";
+    cout << "  2. Spool file\n";
+    cout << "Enter your choice: ";
+
+    int choice;
+    if (!(cin >> choice) || choice < 1 || choice > 2) {
+        clearInputBuffer();
+        printError("Invalid choice!");
+        return;
+    }
+
+    string path;
+    if (choice == 2) {
+        clearInputBuffer();
+        cout << "Enter spool file name: ";
+        getline(cin, path);
+        if (path.empty()) {
+            printError("File name cannot be empty!");
+            return;
+        }
+    }
+
+    stopInvoiceRenderer();
+    if (!startInvoiceRenderer(choice == 2 ? path.c_str() : NULL)) {
+        startInvoiceRenderer(NULL);
+        printError("Could not open " + path + ", invoices go to the terminal.");
+        return;
+    }
+    printSuccess(choice == 2 ? "Invoices will be appended to " + path : "Invoices will be shown on the terminal.");
+}
+
+// ============================================================
+// PURCHASE REQUEST DEDUPLICATION
+// ============================================================
+// A terminal that times out on a purchase may send it again. Purchases
+// can carry a client-chosen request ID; the first one with a given ID is
+// committed and its result kept, and any retry gets that same result back
+// instead of selling the stock twice.
+//
+// Results live in a bounded cache split into stripes by a hash of the ID,
+// each stripe with its own lock, so lookups for different IDs do not wait
+// on each other. A stripe is a ring in arrival order: when it is full the
+// oldest result is dropped, and results older than a day are ignored.
+// With a journal file open every result is also appended to it, and
+// reopening the journal after a restart loads the results back.
+//
+// Journal layout: the magic, then the format version and the size of a
+// record's fixed part as two ints. Each record is its fixed part (the
+// numbers field by field, no padding) followed by the request ID and the
+// product name, each as an int length and its bytes. A journal written in
+// another version, or by a build whose field sizes differ, is refused.
+#ifndef INVENTORY_MAX_PURCHASE_REQUESTS
+#define INVENTORY_MAX_PURCHASE_REQUESTS 1024
+#endif
+
+const int MAX_PURCHASE_REQUESTS = INVENTORY_MAX_PURCHASE_REQUESTS;
+const int PURCHASE_REQUEST_STRIPES = 16;
+const int PURCHASE_REQUEST_ID_LENGTH = 48;          // including the terminator
+const long long PURCHASE_REQUEST_TTL_SECONDS = 24 * 3600;
+const char PURCHASE_JOURNAL_MAGIC[8] = {'I', 'M', 'S', 'R', 'E', 'Q', 'J', 'L'};
+const int PURCHASE_JOURNAL_VERSION = 2;
+const int PURCHASE_JOURNAL_FIXED_SIZE = 3 * sizeof(int) + 2 * sizeof(long long) +
+                                        4 * sizeof(double) + sizeof(bool);
+const int PURCHASE_JOURNAL_MAX_TEXT = 1 << 16;       // sanity limit when reading
+
+enum PurchaseRequestStatus {
+    REQUEST_COMMITTED,      // new request, sold now
+    REQUEST_DUPLICATE,      // seen before, original result returned
+    REQUEST_CONFLICT,       // seen before with a different product or quantity
+    REQUEST_OUT_OF_STOCK,   // new request, not enough available stock
+    REQUEST_JOURNAL_FAILED  // new request, sold now, but the journal write
+                            // failed and the journal was closed
+};
+
+struct PurchaseRequestRecord {
+    char requestId[PURCHASE_REQUEST_ID_LENGTH];
+    unsigned hash;          // hashRequestId(requestId)
+    int productId;
+    long long acceptedAt;
+    InvoiceJob result;      // everything the original purchase returned
+};
+
+struct RequestTableEntry {
+    unsigned hash;
+    int slot;               // ring slot, -1 for an empty entry
+};
+
+// Records are kept in a ring and found through an open-addressing table of
+// (hash, ring slot) pairs, so neither a lookup nor an insert allocates and
+// a miss rarely touches the records themselves
+struct PurchaseRequestStripe {
+    mutex lock;
+    vector<PurchaseRequestRecord> ring;
+    int oldest;             // ring slot of the oldest record
+    int count;
+    vector<RequestTableEntry> table;    // power-of-two size, at least twice the ring
+};
+
+PurchaseRequestStripe purchaseRequestStripes[PURCHASE_REQUEST_STRIPES];
+FILE* purchaseJournal = NULL;
+string purchaseJournalPath;
+
+// FNV-1a with a final mix; the low bits pick the stripe, the rest the
+// table position
+unsigned hashRequestId(const char* requestId) {
+    unsigned code = 2166136261u;
+    for (const char* c = requestId; *c != '\0'; c++) {
+        code = (code ^ (unsigned char)*c) * 16777619u;
+    }
+    code ^= code >> 16;
+    code *= 0x85ebca6bu;
+    code ^= code >> 13;
+    return code;
+}
+
+PurchaseRequestStripe* purchaseRequestStripe(unsigned hash) {
+    return &purchaseRequestStripes[hash % PURCHASE_REQUEST_STRIPES];
+}
+
+int requestTableHome(const PurchaseRequestStripe* stripe, unsigned hash) {
+    return (int)((hash / PURCHASE_REQUEST_STRIPES) & (stripe->table.size() - 1));
+}
+
+// Table position holding requestId, or -1. The caller must hold the
+// stripe's lock.
+int findRequestEntry(const PurchaseRequestStripe* stripe, const char* requestId, unsigned hash) {
+    if (stripe->table.empty()) {
+        return -1;
+    }
+    int mask = (int)stripe->table.size() - 1;
+    for (int pos = requestTableHome(stripe, hash); stripe->table[pos].slot != -1; pos = (pos + 1) & mask) {
+        const RequestTableEntry* entry = &stripe->table[pos];
+        if (entry->hash == hash && strcmp(stripe->ring[entry->slot].requestId, requestId) == 0) {
+            return pos;
+        }
+    }
+    return -1;
+}
+
+// Empty a table position, shifting later entries of the same probe run
+// back so lookups never stop early at the hole
+void removeRequestEntry(PurchaseRequestStripe* stripe, int hole) {
+    int mask = (int)stripe->table.size() - 1;
+    for (int pos = (hole + 1) & mask; stripe->table[pos].slot != -1; pos = (pos + 1) & mask) {
+        int home = requestTableHome(stripe, stripe->table[pos].hash);
+        if (((pos - home) & mask) >= ((pos - hole) & mask)) {
+            stripe->table[hole] = stripe->table[pos];
+            hole = pos;
+        }
+    }
+    stripe->table[hole].slot = -1;
+}
+
+// Copy the result stored for requestId (call by address). Expired results
+// count as missing. The caller must hold the stripe's lock.
+bool findPurchaseRequest(const PurchaseRequestStripe* stripe, const char* requestId, unsigned hash,
+                         long long now, PurchaseRequestRecord* record) {
+    int pos = findRequestEntry(stripe, requestId, hash);
+    if (pos < 0) {
+        return false;
+    }
+    const PurchaseRequestRecord* stored = &stripe->ring[stripe->table[pos].slot];
+    if (now - stored->acceptedAt >= PURCHASE_REQUEST_TTL_SECONDS) {
+        return false;   // left for the ring to overwrite
+    }
+    *record = *stored;
+    return true;
+}
+
+// Allocate an empty stripe. The caller must hold the stripe's lock.
+void sizePurchaseRequestStripe(PurchaseRequestStripe* stripe) {
+    int capacity = max(1, MAX_PURCHASE_REQUESTS / PURCHASE_REQUEST_STRIPES);
+    size_t tableSize = 1;
+    while (tableSize < (size_t)capacity * 2) {
+        tableSize *= 2;
+    }
+    RequestTableEntry empty = {0, -1};
+    stripe->ring.resize(capacity);
+    stripe->table.assign(tableSize, empty);
+    stripe->oldest = 0;
+    stripe->count = 0;
+}
+
+// Keep a result, dropping the oldest one when the stripe is full. The
+// caller must hold the stripe's lock.
+void storePurchaseRequest(PurchaseRequestStripe* stripe, const PurchaseRequestRecord* record) {
+    if (stripe->ring.empty()) {
+        sizePurchaseRequestStripe(stripe);
+    }
+
+    int existing = findRequestEntry(stripe, record->requestId, record->hash);
+    if (existing >= 0) {
+        stripe->ring[stripe->table[existing].slot] = *record;  // expired ID used again
+        return;
+    }
+
+    int capacity = (int)stripe->ring.size();
+    int slot;
+    if (stripe->count == capacity) {
+        slot = stripe->oldest;
+        const PurchaseRequestRecord* evicted = &stripe->ring[slot];
+        removeRequestEntry(stripe, findRequestEntry(stripe, evicted->requestId, evicted->hash));
+        stripe->oldest = (stripe->oldest + 1) % capacity;
+    } else {
+        slot = (stripe->oldest + stripe->count) % capacity;
+        stripe->count++;
+    }
+    stripe->ring[slot] = *record;
+
+    int mask = (int)stripe->table.size() - 1;
+    int pos = requestTableHome(stripe, record->hash);
+    while (stripe->table[pos].slot != -1) {
+        pos = (pos + 1) & mask;
+    }
+    stripe->table[pos].hash = record->hash;
+    stripe->table[pos].slot = slot;
+}
+
+// Forget every result. Also allocates the whole cache up front, which
+// otherwise happens stripe by stripe on first use.
+void clearPurchaseRequests() {
+    for (int s = 0; s < PURCHASE_REQUEST_STRIPES; s++) {
+        PurchaseRequestStripe* stripe = &purchaseRequestStripes[s];
+        lock_guard<mutex> lock(stripe->lock);
+        sizePurchaseRequestStripe(stripe);
+    }
+}
+
+void putJournalField(vector<unsigned char>* out, const void* field, size_t bytes) {
+    const unsigned char* p = (const unsigned char*)field;
+    out->insert(out->end(), p, p + bytes);
+}
+
+void putJournalText(vector<unsigned char>* out, const string& text) {
+    int length = (int)text.size();
+    putJournalField(out, &length, sizeof(length));
+    out->insert(out->end(), text.begin(), text.end());
+}
+
+void getJournalField(const unsigned char** p, void* field, size_t bytes) {
+    memcpy(field, *p, bytes);
+    *p += bytes;
+}
+
+bool readJournalText(FILE* in, string* text) {
+    int length;
+    if (fread(&length, sizeof(length), 1, in) != 1 || length < 0 || length > PURCHASE_JOURNAL_MAX_TEXT) {
+        return false;
+    }
+    text->assign(length, '\0');
+    return length == 0 || fread(&(*text)[0], length, 1, in) == 1;
+}
+
+// One journal record, field by field (see the layout above)
+void encodePurchaseRequest(const PurchaseRequestRecord* record, vector<unsigned char>* out) {
+    const InvoiceJob* result = &record->result;
+    out->clear();
+    putJournalField(out, &record->productId, sizeof(int));
+    putJournalField(out, &result->transactionId, sizeof(int));
+    putJournalField(out, &result->quantity, sizeof(int));
+    putJournalField(out, &record->acceptedAt, sizeof(long long));
+    putJournalField(out, &result->timestamp, sizeof(long long));
+    putJournalField(out, &result->unitPrice, sizeof(double));
+    putJournalField(out, &result->subtotal, sizeof(double));
+    putJournalField(out, &result->discount, sizeof(double));
+    putJournalField(out, &result->total, sizeof(double));
+    putJournalField(out, &result->lowStock, sizeof(bool));
+    putJournalText(out, record->requestId);
+    putJournalText(out, result->productName);
+}
+
+// Read the next record; false at the end of the journal or on a record
+// that was cut short
+bool readPurchaseRequest(FILE* in, PurchaseRequestRecord* record) {
+    unsigned char fixed[PURCHASE_JOURNAL_FIXED_SIZE];
+    if (fread(fixed, sizeof(fixed), 1, in) != 1) {
+        return false;
+    }
+    *record = PurchaseRequestRecord();
+    InvoiceJob* result = &record->result;
+    const unsigned char* p = fixed;
+    getJournalField(&p, &record->productId, sizeof(int));
+    getJournalField(&p, &result->transactionId, sizeof(int));
+    getJournalField(&p, &result->quantity, sizeof(int));
+    getJournalField(&p, &record->acceptedAt, sizeof(long long));
+    getJournalField(&p, &result->timestamp, sizeof(long long));
+    getJournalField(&p, &result->unitPrice, sizeof(double));
+    getJournalField(&p, &result->subtotal, sizeof(double));
+    getJournalField(&p, &result->discount, sizeof(double));
+    getJournalField(&p, &result->total, sizeof(double));
+    getJournalField(&p, &result->lowStock, sizeof(bool));
+
+    string requestId, productName;
+    if (!readJournalText(in, &requestId) || !readJournalText(in, &productName) ||
+        requestId.empty() || (int)requestId.size() >= PURCHASE_REQUEST_ID_LENGTH) {
+        return false;
+    }
+    copyFixedString(record->requestId, PURCHASE_REQUEST_ID_LENGTH, requestId);
+    result->productName = productName;
+    return true;
+}
+
+bool writePurchaseJournalHeader(FILE* out) {
+    int format[2] = {PURCHASE_JOURNAL_VERSION, PURCHASE_JOURNAL_FIXED_SIZE};
+    return fwrite(PURCHASE_JOURNAL_MAGIC, sizeof(PURCHASE_JOURNAL_MAGIC), 1, out) == 1 &&
+           fwrite(format, sizeof(format), 1, out) == 1;
+}
+
+bool readPurchaseJournalHeader(FILE* in) {
+    char magic[sizeof(PURCHASE_JOURNAL_MAGIC)];
+    int format[2];
+    return fread(magic, sizeof(magic), 1, in) == 1 &&
+           memcmp(magic, PURCHASE_JOURNAL_MAGIC, sizeof(magic)) == 0 &&
+           fread(format, sizeof(format), 1, in) == 1 &&
+           format[0] == PURCHASE_JOURNAL_VERSION && format[1] == PURCHASE_JOURNAL_FIXED_SIZE;
+}
+
+// Append one result and flush it to the OS. On failure the journal is
+// closed, since a record cut short would hide every later one; the caller
+// must hold inventoryWriteMutex.
+bool appendPurchaseJournal(const PurchaseRequestRecord* record) {
+    vector<unsigned char> bytes;
+    encodePurchaseRequest(record, &bytes);
+    bool ok = fwrite(&bytes[0], 1, bytes.size(), purchaseJournal) == bytes.size();
+    ok = fflush(purchaseJournal) == 0 && ok;
+    if (!ok) {
+        fclose(purchaseJournal);
+        purchaseJournal = NULL;
+        purchaseJournalPath.clear();
+    }
+    return ok;
+}
+
+PurchaseRequestStatus checkPurchaseRequest(const PurchaseRequestRecord* record, int index, int quantity,
+                                           InvoiceJob* result) {
+    if (result != NULL) {
+        *result = record->result;
+    }
+    bool same = record->productId == products[index].id && record->result.quantity == quantity;
+    return same ? REQUEST_DUPLICATE : REQUEST_CONFLICT;
+}
+
+// Purchase with a request ID (empty for none). A retry of a committed
+// request returns REQUEST_DUPLICATE and the original result in `result`
+// without touching stock; a retry with another product or quantity is
+// refused as REQUEST_CONFLICT. `result` may be NULL.
+PurchaseRequestStatus commitPurchaseRequest(const string& requestId, int index, int quantity,
+                                            InvoiceJob* result) {
+    PurchaseRequestRecord record = PurchaseRequestRecord();
+    long long now = (long long)time(0);
+    PurchaseRequestStripe* stripe = NULL;
+    unsigned hash = 0;
+
+    if (!requestId.empty()) {
+        hash = hashRequestId(requestId.c_str());
+        stripe = purchaseRequestStripe(hash);
+        lock_guard<mutex> stripeLock(stripe->lock);
+        if (findPurchaseRequest(stripe, requestId.c_str(), hash, now, &record)) {
+            return checkPurchaseRequest(&record, index, quantity, result);
+        }
+    }
+
+    lock_guard<mutex> lock(inventoryWriteMutex);
+    if (stripe != NULL) {
+        // Checked again under the write lock: a retry that raced the first
+        // attempt waited above and now sees its result
+        lock_guard<mutex> stripeLock(stripe->lock);
+        if (findPurchaseRequest(stripe, requestId.c_str(), hash, now, &record)) {
+            return checkPurchaseRequest(&record, index, quantity, result);
+        }
+    }
+
+    expireReservations();
+    if (getAvailableStock(index) < quantity) {
+        return REQUEST_OUT_OF_STOCK;
+    }
+
+    double unitPrice, subtotal, discount, total;
+    applyPurchase(index, quantity, &unitPrice, &subtotal, &discount, &total, &record.result);
+    if (result != NULL) {
+        *result = record.result;
+    }
+    if (stripe == NULL) {
+        return REQUEST_COMMITTED;
+    }
+
+    copyFixedString(record.requestId, PURCHASE_REQUEST_ID_LENGTH, requestId);
+    record.hash = hash;
+    record.productId = products[index].id;
+    record.acceptedAt = now;
+    {
+        lock_guard<mutex> stripeLock(stripe->lock);
+        storePurchaseRequest(stripe, &record);
+    }
+    // Flushed to the OS before the sale is reported, so a crash right
+    // after cannot lose it (a power cut still can)
+    if (purchaseJournal != NULL && !appendPurchaseJournal(&record)) {
+        return REQUEST_JOURNAL_FAILED;
+    }
+    return REQUEST_COMMITTED;
+}
+
+// Write every unexpired result to a fresh journal at `path`
+bool writePurchaseJournal(const string& path, long long now) {
+    FILE* out = fopen(path.c_str(), "wb");
+    if (out == NULL) {
+        return false;
+    }
+    bool ok = writePurchaseJournalHeader(out);
+    vector<unsigned char> bytes;
+    for (int s = 0; s < PURCHASE_REQUEST_STRIPES && ok; s++) {
+        PurchaseRequestStripe* stripe = &purchaseRequestStripes[s];
+        lock_guard<mutex> lock(stripe->lock);
+        for (int k = 0; k < stripe->count && ok; k++) {
+            const PurchaseRequestRecord* record = &stripe->ring[(stripe->oldest + k) % stripe->ring.size()];
+            if (now - record->acceptedAt < PURCHASE_REQUEST_TTL_SECONDS) {
+                encodePurchaseRequest(record, &bytes);
+                ok = fwrite(&bytes[0], 1, bytes.size(), out) == bytes.size();
+            }
+        }
+    }
+    return fclose(out) == 0 && ok;
+}
+
+void closePurchaseJournal() {
+    lock_guard<mutex> lock(inventoryWriteMutex);
+    if (purchaseJournal != NULL) {
+        fclose(purchaseJournal);
+        purchaseJournal = NULL;
+    }
+    purchaseJournalPath.clear();
+}
+
+// Load the results kept in `path` (if it exists), compact it down to the
+// unexpired ones and append new results to it from now on. A journal in
+// another format is refused by the header check.
+bool openPurchaseJournal(const char* path, int* loaded) {
+    closePurchaseJournal();
+    *loaded = 0;
+    long long now = (long long)time(0);
+
+    lock_guard<mutex> lock(inventoryWriteMutex);
+    FILE* in = fopen(path, "rb");
+    if (in != NULL) {
+        if (!readPurchaseJournalHeader(in)) {
+            fclose(in);
+            return false;
+        }
+        PurchaseRequestRecord record;
+        while (readPurchaseRequest(in, &record)) {
+            if (now - record.acceptedAt >= PURCHASE_REQUEST_TTL_SECONDS) {
+                continue;
+            }
+            record.hash = hashRequestId(record.requestId);
+            PurchaseRequestStripe* stripe = purchaseRequestStripe(record.hash);
+            lock_guard<mutex> stripeLock(stripe->lock);
+            storePurchaseRequest(stripe, &record);
+            (*loaded)++;
+        }
+        fclose(in);
+    }
+
+    // Rewrite through a temporary file so a crash mid-way keeps the old one
+    string temporary = string(path) + ".tmp";
+    if (!writePurchaseJournal(temporary, now) || rename(temporary.c_str(), path) != 0) {
+        remove(temporary.c_str());
+        return false;
+    }
+    purchaseJournal = fopen(path, "ab");
+    if (purchaseJournal == NULL) {
+        return false;
+    }
+    purchaseJournalPath = path;
+    return true;
+}
+
+void configurePurchaseJournal() {
+    clearScreen();
+    printTableHeader("PURCHASE REQUEST JOURNAL");
+
+    cout << "Purchases with a request ID are answered once; retries get the\n";
+    cout << "original invoice. The journal keeps those answers across restarts.\n\n";
+    cout << "Journal file: " << (purchaseJournalPath.empty() ? "none (memory only)" : purchaseJournalPath) << "\n\n";
+
+    string path;
+    clearInputBuffer();
+    cout << "Enter journal file name (blank for memory only): ";
+    getline(cin, path);
+
+    if (path.empty()) {
+        closePurchaseJournal();
+        printSuccess("Purchase requests are kept in memory only.");
+        return;
+    }
+
+    int loaded;
+    if (!openPurchaseJournal(path.c_str(), &loaded)) {
+        closePurchaseJournal();
+        printError("Could not use " + path + " as a purchase journal.");
+        return;
+    }
+    printSuccess("Journal " + path + " opened, " + to_string(loaded) + " request(s) loaded.");
+}
+
+// ============================================================
+// TRANSACTION & PURCHASE MANAGEMENT
+// ============================================================
+// Record a sale of the product (call by address) and fold it into the
+// product's demand forecast. Returns the stored transaction, or NULL if
+// the history is full; the caller reports that, since this also runs in
+// shard workers that have no terminal of their own.
+const Transaction* recordTransaction(Product* product, int quantity,
+                                     double unitPrice, double discount, double total) {
+    int index = product - products;
+    time_t now = time(0);
+    updateDemandForecast(index, quantity, now);
+
+    if (transactionCount >= MAX_TRANSACTIONS) {
+        return NULL;
+    }
+
+    Transaction trans;
+    trans.transactionId = nextTransactionId++;
+    trans.productId = product->id;
+    trans.productName = product->name;
+    trans.quantity = quantity;
+    trans.unitPrice = unitPrice;
+    trans.discount = discount;
+    trans.totalPrice = total;
+    // The date and time text only changes once a second; reuse it within
+    // the second instead of formatting every sale (inventoryWriteMutex is held)
+    static time_t formattedSecond = -1;
+    static string formattedDate, formattedTime;
+    if (now != formattedSecond) {
+        formattedSecond = now;
+        formattedDate = formatDate(now);
+        formattedTime = formatTime(now);
+    }
+    trans.date = formattedDate;
+    trans.time = formattedTime;
+    trans.timestamp = now;
+
+    transactions[transactionCount++] = trans;
+    logTransaction(&trans, index);
+    return &transactions[transactionCount - 1];
+}
+
+// Calculate discount using call by reference (pointers)
+void calculateDiscount(int quantity, double subtotal, double* discount, double* total) {
+    *discount = 0.0;
+
+    // Apply bulk discount if quantity meets threshold
+    if (quantity >= BULK_DISCOUNT_THRESHOLD) {
+        *discount = subtotal * BULK_DISCOUNT_RATE;
+    }
+
+    *total = subtotal - *discount;
+}
+
+// Update inventory using pointer (call by address)
+void updateInventoryStock(Product* product, int quantitySold) {
+    if (product == NULL) {
+        printError("Invalid product pointer!");
+        return;
+    }
+
+    if (product->quantity < quantitySold) {
+        printError("Insufficient stock!");
+        return;
+    }
+
+    // Pointer arithmetic gives the product's slot, which is its matrix row
+    int index = product - products;
+    if (index >= 0 && index < productCount) {
+        fulfillFromLocations(index, quantitySold);
+    }
+
+    product->quantity -= quantitySold;
+}
+
+// Get product statistics from one snapshot using pointers (call by address)
+void getSnapshotStatistics(const InventorySnapshot* snapshot, int* totalProducts,
+                           int* lowStock, int* outOfStock, double* totalValue) {
+    *totalProducts = 0;
+    *lowStock = 0;
+    *outOfStock = 0;
+    *totalValue = 0.0;
+
+    // A page at a time, so the tree is walked once per page
+    for (int base = 0; base < snapshot->productCount; base += SNAPSHOT_PAGE_SIZE) {
+        const ProductPage* page = snapshotPage(snapshot, base / SNAPSHOT_PAGE_SIZE);
+        int onPage = min(SNAPSHOT_PAGE_SIZE, snapshot->productCount - base);
+        for (int i = 0; i < onPage; i++) {
+            const Product* product = &page->items[i];
+            if (product->active) {
+                (*totalProducts)++;
+                *totalValue += product->price * product->quantity;
+
+                if (product->quantity == 0) {
+                    (*outOfStock)++;
+                } else if (product->quantity <= MIN_STOCK_THRESHOLD) {
+                    (*lowStock)++;
+                }
+            }
+        }
+    }
+}
+
+// Get product statistics using pointers (call by address)
+void getProductStatistics(int* totalProducts, int* lowStock, int* outOfStock, double* totalValue) {
+    shared_ptr<const InventorySnapshot> snapshot = acquireSnapshot();
+    getSnapshotStatistics(snapshot.get(), totalProducts, lowStock, outOfStock, totalValue);
+}
+
+// Get per-product sales from the transaction history (call by address)
+void getTransactionSummary(int productId, int* count, int* unitsSold, double* revenue) {
+    *count = 0;
+    *unitsSold = 0;
+    *revenue = 0.0;
+
+    for (int i = 0; i < transactionCount; i++) {
+        if (transactions[i].productId == productId) {
+            (*count)++;
+            *unitsSold += transactions[i].quantity;
+            *revenue += transactions[i].totalPrice;
+        }
+    }
+}
+
+// Price a sale, update stock and record the transaction. Fills `invoice`
+// when it is not NULL. The caller must hold inventoryWriteMutex and have
+// checked the stock. Returns the stored transaction, or NULL if the
+// history is full.
+const Transaction* applyPurchase(int index, int quantity, double* unitPrice, double* subtotal,
+                                 double* discount, double* total, InvoiceJob* invoice) {
     // Calculate pricing using pointer-based function
-    double unitPrice = products[index].price;
-    double subtotal = unitPrice * quantity;
-    double discount = 0.0;
-    double total = 0.0;
+    *unitPrice = products[index].price;
+    *subtotal = *unitPrice * quantity;
+
+    // Call by address - discount and total are calculated via pointers
+    calculateDiscount(quantity, *subtotal, discount, total);
+
+    // Update inventory using pointer
+    updateInventoryStock(&products[index], quantity);
+
+    // Record transaction
+    const Transaction* trans = recordTransaction(&products[index], quantity,
+                                                 *unitPrice, *discount, *total);
+
+    if (invoice != NULL) {
+        invoice->transactionId = trans != NULL ? trans->transactionId : 0;
+        invoice->productName = products[index].name;
+        invoice->quantity = quantity;
+        invoice->unitPrice = *unitPrice;
+        invoice->subtotal = *subtotal;
+        invoice->discount = *discount;
+        invoice->total = *total;
+        invoice->timestamp = trans != NULL ? trans->timestamp : (long long)time(0);
+        invoice->lowStock = products[index].quantity <= MIN_STOCK_THRESHOLD;
+    }
+
+    publishProductChanges(index, index);
+    return trans;
+}
+
+// Commit a sale without any terminal I/O. Units held by reservations are
+// not for sale. Returns false if the available stock cannot cover it.
+// `recorded` (may be NULL) receives the stored transaction, NULL when the
+// history is full.
+bool commitPurchase(int index, int quantity, double* unitPrice, double* subtotal,
+                    double* discount, double* total, InvoiceJob* invoice,
+                    const Transaction** recorded) {
+    lock_guard<mutex> lock(inventoryWriteMutex);
+    expireReservations();
+
+    if (getAvailableStock(index) < quantity) {
+        return false;
+    }
+    const Transaction* trans = applyPurchase(index, quantity, unitPrice, subtotal, discount, total, invoice);
+    if (recorded != NULL) {
+        *recorded = trans;
+    }
+    return true;
+}
+
+void purchaseProduct() {
+    clearScreen();
+    printTableHeader("PURCHASE PRODUCT");
+
+    string requestId;
+    string name;
+    clearInputBuffer();
+    cout << "Enter Request ID (optional, for retries): ";
+    getline(cin, requestId);
+
+    if ((int)requestId.size() >= PURCHASE_REQUEST_ID_LENGTH) {
+        printError("Request ID is too long! Max " + to_string(PURCHASE_REQUEST_ID_LENGTH - 1) + " characters.");
+        return;
+    }
+
+    cout << "Enter Product Name: ";
+    getline(cin, name);
+
+    if (name.empty()) {
+        printError("Product name cannot be empty!");
+        return;
+    }
+
+    int index = findProductByName(name);
+    if (index == -1) {
+        printError("Product not found!");
+        return;
+    }
+
+    int quantity;
+    cout << "Enter Quantity to Purchase: ";
+    if (!(cin >> quantity)) {
+        clearInputBuffer();
+        printError("Invalid input! Quantity must be a number.");
+        return;
+    }
+
+    if (quantity <= 0) {
+        printError("Invalid quantity! Must be positive.");
+        return;
+    }
+
+    // Price the sale, update stock and record the transaction; the invoice
+    // is formatted and written by the renderer thread. A retried request
+    // gets its original invoice again.
+    InvoiceJob invoice;
+    PurchaseRequestStatus status = commitPurchaseRequest(requestId, index, quantity, &invoice);
+
+    if (status == REQUEST_OUT_OF_STOCK) {
+        printError("Insufficient stock!");
+        cout << "Available: " << getAvailableStock(index) << "\n";
+        if (reservedStock[index] > 0) {
+            cout << "Reserved:  " << reservedStock[index] << "\n";
+        }
+        cout << "Requested: " << quantity << "\n";
+        return;
+    }
+    if (status == REQUEST_CONFLICT) {
+        printError("Request ID " + requestId + " was already used for a different purchase!");
+        cout << "Original: " << invoice.quantity << " x " << invoice.productName
+             << " (Invoice #" << invoice.transactionId << ")\n";
+        return;
+    }
+
+    clearScreen();
+    if (status == REQUEST_DUPLICATE) {
+        printSuccess("Request " + requestId + " was already completed; stock was not changed again.");
+    }
+    if (status == REQUEST_JOURNAL_FAILED) {
+        printError("Could not write the purchase journal; it has been closed and request IDs "
+                   "are kept in memory only until it is opened again.");
+    }
+    if (status != REQUEST_DUPLICATE && invoice.transactionId == 0) {
+        printWarning("Transaction history limit reached!");
+    }
+    if (invoiceSpoolPath.empty()) {
+        printInvoice(&invoice); // on screen before the menu comes back
+    } else {
+        submitInvoice(&invoice);
+        printSuccess("Purchase complete! Invoice #" + to_string(invoice.transactionId) +
+                     " sent to " + invoiceSpoolPath);
+    }
+}
+
+void viewTransactionHistory() {
+    // Only transactions published in the snapshot are read, so a sale
+    // being recorded concurrently never shows up half-written
+    int visibleCount = acquireSnapshot()->transactionCount;
+
+    if (visibleCount == 0) {
+        printError("No transactions recorded!");
+        return;
+    }
+
+    clearScreen();
+    printTableHeader("TRANSACTION HISTORY");
+
+    cout << left << setw(8) << "Trans#" << setw(20) << "Product"
+         << setw(6) << "Qty" << setw(12) << "Unit Price"
+         << setw(12) << "Discount" << setw(12) << "Total"
+         << setw(12) << "Date" << "Time\n";
+    cout << "--------------------------------------------------------------------------------\n";
+
+    double totalRevenue = 0.0;
+
+    for (int i = visibleCount - 1; i >= 0; i--) {
+        cout << left << setw(8) << transactions[i].transactionId
+             << setw(20) << transactions[i].productName
+             << setw(6) << transactions[i].quantity
+             << "$" << setw(11) << fixed << setprecision(2) << transactions[i].unitPrice
+             << "$" << setw(11) << fixed << setprecision(2) << transactions[i].discount
+             << "$" << setw(11) << fixed << setprecision(2) << transactions[i].totalPrice
+             << setw(12) << transactions[i].date
+             << transactions[i].time << "\n";
+
+        totalRevenue += transactions[i].totalPrice;
+    }
+
+    cout << "--------------------------------------------------------------------------------\n";
+    cout << right << setw(70) << "Total Revenue: $" << fixed << setprecision(2) << totalRevenue << "\n";
+    cout << "================================================================================\n";
+}
+
+// ============================================================
+// STOCK RESERVATIONS
+// ============================================================
+// A reservation holds units of a product for a limited time (e.g. during
+// an online checkout). Held units are counted in reservedStock[] and stay
+// in products[].quantity until the hold is confirmed as a purchase, so
+// available-to-sell is one subtraction. Expiry uses a hierarchical timer
+// wheel: level 0 has one slot per tick, each higher level has 64 slots
+// covering a whole turn of the level below. A hold sits in the slot for
+// its expiry tick; when a lower level wraps, the next higher slot is
+// moved down a level. Adding, cancelling and expiring a hold are O(1),
+// and each hold moves down at most three times. After idle time the wheel
+// skips straight to the next tick that has a slot to process, so catching
+// up costs per hold, not per elapsed tick.
+//
+// Expiry runs lazily: from the reservation and purchase paths, and from
+// screens that show reserved stock (refreshReservations).
+const int RESERVATION_TICK_MS = 100;
+const int WHEEL_LEVEL0_BITS = 8;
+const int WHEEL_LEVEL_BITS = 6;
+const int WHEEL_LEVELS = 4;
+const int WHEEL_LEVEL0_SLOTS = 1 << WHEEL_LEVEL0_BITS;
+const int WHEEL_LEVEL_SLOTS = 1 << WHEEL_LEVEL_BITS;
+const long long WHEEL_MAX_TICKS =
+    (long long)WHEEL_LEVEL0_SLOTS << (WHEEL_LEVEL_BITS * (WHEEL_LEVELS - 1)); // about 77 days
+const int WHEEL_SKIP_TICKS = 16;    // further behind than this, look for the next busy tick
+const int MAX_RESERVATION_MINUTES = (int)(WHEEL_MAX_TICKS * RESERVATION_TICK_MS / 60000);
+
+struct Reservation {
+    int productIndex;
+    int quantity;
+    long long expiresAtTick;
+    int generation;          // bumped on reuse so stale handles are rejected
+    int next;                // wheel slot list, or free list
+    int prev;
+    short level;             // wheel position, -1 when not in the wheel
+    short slot;
+};
+
+Reservation reservations[MAX_RESERVATIONS];
+int reservationFreeHead = -1;
+int reservationPoolUsed = 0;         // slots handed out at least once
+int activeReservations = 0;
+
+// wheelSlots[level][slot] is the first reservation in that slot, or -1
+int wheelSlots[WHEEL_LEVELS][WHEEL_LEVEL0_SLOTS];
+long long wheelTick = -1;            // last tick processed; -1 before first use
+
+long long reservationNowTick() {
+    return steadyNowNs() / 1000000 / RESERVATION_TICK_MS;
+}
+
+void wheelUnlink(int r) {
+    Reservation* res = &reservations[r];
+    if (res->prev != -1) {
+        reservations[res->prev].next = res->next;
+    } else {
+        wheelSlots[res->level][res->slot] = res->next;
+    }
+    if (res->next != -1) {
+        reservations[res->next].prev = res->prev;
+    }
+    res->level = -1;
+}
+
+// Put a reservation in the slot for its expiry tick
+void wheelInsert(int r) {
+    Reservation* res = &reservations[r];
+    long long delta = res->expiresAtTick - wheelTick;
+    if (delta < 0) {
+        delta = 0;  // only while cascading: due this very tick
+        res->expiresAtTick = wheelTick;
+    }
+
+    int level = 0;
+    long long span = WHEEL_LEVEL0_SLOTS;
+    while (level < WHEEL_LEVELS - 1 && delta >= span) {
+        level++;
+        span <<= WHEEL_LEVEL_BITS;
+    }
+    if (delta >= WHEEL_MAX_TICKS) {
+        res->expiresAtTick = wheelTick + WHEEL_MAX_TICKS - 1;
+    }
+
+    int slot;
+    if (level == 0) {
+        slot = (int)(res->expiresAtTick & (WHEEL_LEVEL0_SLOTS - 1));
+    } else {
+        int shift = WHEEL_LEVEL0_BITS + (level - 1) * WHEEL_LEVEL_BITS;
+        slot = (int)((res->expiresAtTick >> shift) & (WHEEL_LEVEL_SLOTS - 1));
+    }
+
+    res->level = level;
+    res->slot = slot;
+    res->prev = -1;
+    res->next = wheelSlots[level][slot];
+    if (res->next != -1) {
+        reservations[res->next].prev = r;
+    }
+    wheelSlots[level][slot] = r;
+}
+
+void releaseReservationSlot(int r) {
+    reservations[r].generation++;
+    reservations[r].next = reservationFreeHead;
+    reservationFreeHead = r;
+    activeReservations--;
+}
+
+// The first tick after wheelTick at which stepping would find work: a
+// level-0 slot due, or a non-empty higher slot coming up to cascade.
+// LLONG_MAX if the wheel is empty.
+long long nextWheelEventTick() {
+    long long next = LLONG_MAX;
+    for (int slot = 0; slot < WHEEL_LEVEL0_SLOTS; slot++) {
+        if (wheelSlots[0][slot] != -1) {
+            long long tick = wheelTick + 1 + ((slot - (wheelTick + 1)) & (WHEEL_LEVEL0_SLOTS - 1));
+            next = min(next, tick);
+        }
+    }
+    int shift = WHEEL_LEVEL0_BITS;
+    for (int level = 1; level < WHEEL_LEVELS; level++) {
+        long long turn = (wheelTick >> shift) + 1;  // first boundary after wheelTick
+        for (int slot = 0; slot < WHEEL_LEVEL_SLOTS; slot++) {
+            if (wheelSlots[level][slot] != -1) {
+                long long boundary = turn + ((slot - turn) & (WHEEL_LEVEL_SLOTS - 1));
+                next = min(next, boundary << shift);
+            }
+        }
+        shift += WHEEL_LEVEL_BITS;
+    }
+    return next;
+}
+
+// Expire every hold due by tick `now`. The caller must hold
+// inventoryWriteMutex.
+void advanceReservationWheel(long long now) {
+    if (wheelTick < 0 || activeReservations == 0) {
+        // Nothing is waiting, so the wheel can jump straight to now
+        if (wheelTick < 0) {
+            for (int level = 0; level < WHEEL_LEVELS; level++) {
+                for (int slot = 0; slot < WHEEL_LEVEL0_SLOTS; slot++) {
+                    wheelSlots[level][slot] = -1;
+                }
+            }
+        }
+        wheelTick = now;
+        return;
+    }
+
+    while (wheelTick < now) {
+        if (now - wheelTick > WHEEL_SKIP_TICKS) {
+            // Ticks with nothing in their slots change nothing: skip them
+            long long next = nextWheelEventTick();
+            if (next > now) {
+                wheelTick = now;
+                break;
+            }
+            wheelTick = next - 1;
+        }
+        wheelTick++;
+
+        // Each time a level wraps, bring the next slot of the level above down
+        long long tick = wheelTick;
+        int shift = WHEEL_LEVEL0_BITS;
+        for (int level = 1; level < WHEEL_LEVELS && (tick & ((1LL << shift) - 1)) == 0; level++) {
+            int slot = (int)((tick >> shift) & (WHEEL_LEVEL_SLOTS - 1));
+            int r = wheelSlots[level][slot];
+            wheelSlots[level][slot] = -1;
+            while (r != -1) {
+                int next = reservations[r].next;
+                wheelInsert(r);
+                r = next;
+            }
+            shift += WHEEL_LEVEL_BITS;
+        }
+
+        int slot = (int)(wheelTick & (WHEEL_LEVEL0_SLOTS - 1));
+        int r = wheelSlots[0][slot];
+        wheelSlots[0][slot] = -1;
+        while (r != -1) {
+            int next = reservations[r].next;
+            reservedStock[reservations[r].productIndex] -= reservations[r].quantity;
+            logReservedStock(reservations[r].productIndex);
+            reservations[r].level = -1;
+            releaseReservationSlot(r);
+            r = next;
+        }
+
+        if (activeReservations == 0) {
+            wheelTick = now;
+        }
+    }
+}
+
+// Expire every hold whose time is up. Runs lazily from the reservation
+// and purchase paths; the caller must hold inventoryWriteMutex.
+void expireReservations() {
+    advanceReservationWheel(reservationNowTick());
+}
+
+// Expire lapsed holds before a screen shows reserved or available stock
+void refreshReservations() {
+    lock_guard<mutex> lock(inventoryWriteMutex);
+    expireReservations();
+}
+
+// Units that can still be sold or reserved; O(1). Reflects the last
+// expiry, so callers outside the write lock refresh first.
+int getAvailableStock(int index) {
+    return max(0, products[index].quantity - reservedStock[index]);
+}
+
+// Hold `quantity` units of a product for ttlSeconds. Returns a handle for
+// confirming or cancelling, or -1 if there is not enough available stock
+// or no free reservation slot.
+long long reserveStock(int index, int quantity, int ttlSeconds) {
+    lock_guard<mutex> lock(inventoryWriteMutex);
+    expireReservations();
+
+    if (quantity <= 0 || !products[index].active || getAvailableStock(index) < quantity) {
+        return -1;
+    }
+
+    int r;
+    if (reservationFreeHead != -1) {
+        r = reservationFreeHead;
+        reservationFreeHead = reservations[r].next;
+    } else if (reservationPoolUsed < MAX_RESERVATIONS) {
+        r = reservationPoolUsed++;
+        reservations[r].generation = 0;
+    } else {
+        return -1;
+    }
+
+    Reservation* res = &reservations[r];
+    res->productIndex = index;
+    res->quantity = quantity;
+    res->expiresAtTick = wheelTick + max(1LL, (long long)ttlSeconds * 1000 / RESERVATION_TICK_MS);
+    wheelInsert(r);
+
+    reservedStock[index] += quantity;
+    logReservedStock(index);
+    activeReservations++;
+    return (long long)res->generation * MAX_RESERVATIONS + r;
+}
+
+// Slot for a live handle, or -1 if it expired, was used or never existed
+int findReservation(long long handle) {
+    if (handle < 0) {
+        return -1;
+    }
+    int r = (int)(handle % MAX_RESERVATIONS);
+    if (r >= reservationPoolUsed || reservations[r].generation != handle / MAX_RESERVATIONS ||
+        reservations[r].level == -1) {
+        return -1;
+    }
+    return r;
+}
+
+// Take a live hold out of the wheel and give its units back. The caller
+// must hold inventoryWriteMutex.
+void dropReservation(int r) {
+    wheelUnlink(r);
+    reservedStock[reservations[r].productIndex] -= reservations[r].quantity;
+    logReservedStock(reservations[r].productIndex);
+    releaseReservationSlot(r);
+}
+
+// Drop a hold before it expires; returns false if it is no longer live
+bool cancelReservation(long long handle) {
+    lock_guard<mutex> lock(inventoryWriteMutex);
+    expireReservations();
+
+    int r = findReservation(handle);
+    if (r == -1) {
+        return false;
+    }
+    dropReservation(r);
+    return true;
+}
+
+// Drop every live hold on a product, e.g. when it is deleted. The caller
+// must hold inventoryWriteMutex.
+void releaseProductReservations(int index) {
+    for (int r = 0; r < reservationPoolUsed && reservedStock[index] > 0; r++) {
+        if (reservations[r].level != -1 && reservations[r].productIndex == index) {
+            dropReservation(r);
+        }
+    }
+}
+
+// Turn a live hold into a purchase (call by address for the price figures)
+bool confirmReservation(long long handle, int* index, int* quantity, double* unitPrice,
+                        double* subtotal, double* discount, double* total, InvoiceJob* invoice) {
+    lock_guard<mutex> lock(inventoryWriteMutex);
+    expireReservations();
+
+    int r = findReservation(handle);
+    if (r == -1) {
+        return false;
+    }
+    *index = reservations[r].productIndex;
+    *quantity = reservations[r].quantity;
+
+    // A deleted product cannot be sold, so its hold is simply dropped
+    if (!products[*index].active) {
+        dropReservation(r);
+        return false;
+    }
+
+    // The held units may have been edited away since; keep the hold then
+    if (products[*index].quantity < *quantity) {
+        return false;
+    }
+
+    wheelUnlink(r);
+    reservedStock[*index] -= *quantity;
+    logReservedStock(*index);
+    releaseReservationSlot(r);
+    applyPurchase(*index, *quantity, unitPrice, subtotal, discount, total, invoice);
+    return true;
+}
+
+void reserveProduct() {
+    clearScreen();
+    printTableHeader("RESERVE STOCK");
+
+    string name;
+    clearInputBuffer();
+    cout << "Enter Product Name: ";
+    getline(cin, name);
+
+    int index = findProductByName(name);
+    if (index == -1) {
+        printError("Product not found!");
+        return;
+    }
+
+    int quantity;
+    cout << "Enter Quantity to Reserve: ";
+    if (!(cin >> quantity) || quantity <= 0) {
+        clearInputBuffer();
+        printError("Invalid quantity! Must be positive.");
+        return;
+    }
+
+    int minutes;
+    cout << "Hold for how many minutes? ";
+    if (!(cin >> minutes) || minutes <= 0) {
+        clearInputBuffer();
+        printError("Invalid time! Must be positive.");
+        return;
+    }
+
+    if (minutes > MAX_RESERVATION_MINUTES) {
+        printError("Holds can last at most " + to_string(MAX_RESERVATION_MINUTES) + " minutes!");
+        return;
+    }
+
+    long long handle = reserveStock(index, quantity, minutes * 60);
+    if (handle == -1) {
+        printError("Could not reserve stock!");
+        cout << "Available: " << getAvailableStock(index) << "\n";
+        return;
+    }
+
+    printSuccess("Stock reserved!");
+    cout << "Reservation number: " << handle << "\n";
+    cout << "Expires in " << minutes << " minute(s) unless confirmed.\n";
+}
+
+void confirmProductReservation() {
+    clearScreen();
+    printTableHeader("CONFIRM RESERVATION");
+
+    long long handle;
+    cout << "Enter Reservation Number: ";
+    if (!(cin >> handle)) {
+        clearInputBuffer();
+        printError("Invalid input! Reservation number must be a number.");
+        return;
+    }
+
+    int index, quantity;
+    double unitPrice, subtotal, discount, total;
+    InvoiceJob invoice;
+    if (!confirmReservation(handle, &index, &quantity, &unitPrice, &subtotal, &discount, &total, &invoice)) {
+        printError("Reservation not found, expired, for a deleted product or no longer covered by stock!");
+        return;
+    }
+
+    clearScreen();
+    if (invoice.transactionId == 0) {
+        printWarning("Transaction history limit reached!");
+    }
+    if (invoiceSpoolPath.empty()) {
+        printInvoice(&invoice);
+    } else {
+        submitInvoice(&invoice);
+        printSuccess("Purchase complete! Invoice #" + to_string(invoice.transactionId) +
+                     " sent to " + invoiceSpoolPath);
+    }
+}
+
+void cancelProductReservation() {
+    clearScreen();
+    printTableHeader("CANCEL RESERVATION");
+
+    long long handle;
+    cout << "Enter Reservation Number: ";
+    if (!(cin >> handle)) {
+        clearInputBuffer();
+        printError("Invalid input! Reservation number must be a number.");
+        return;
+    }
+
+    if (!cancelReservation(handle)) {
+        printError("Reservation not found or already expired!");
+        return;
+    }
+    printSuccess("Reservation cancelled, stock released.");
+}
+
+// ============================================================
+// REPORTS & ANALYTICS
+// ============================================================
+void generateInventoryReport() {
+    clearScreen();
+    printTableHeader("INVENTORY REPORT");
+
+    int totalProducts = 0;
+    int lowStockProducts = 0;
+    int outOfStockProducts = 0;
+    double totalInventoryValue = 0.0;
+    int transactionsSeen = 0;
+    vector<long long> unitsByLocation;
+    vector<double> valueByLocation;
+
+    // Every figure comes from the same point-in-time snapshot, taken on a
+    // replica when one is attached and caught up
+    int replica = pickReadReplica();
+    if (replica == -1 ||
+        !getReplicaReport(replica, &totalProducts, &lowStockProducts, &outOfStockProducts,
+                          &totalInventoryValue, &transactionsSeen, &unitsByLocation, &valueByLocation)) {
+        replica = -1;
+        shared_ptr<const InventorySnapshot> snapshot = acquireSnapshot();
+        getSnapshotStatistics(snapshot.get(), &totalProducts, &lowStockProducts,
+                              &outOfStockProducts, &totalInventoryValue);
+        transactionsSeen = snapshot->transactionCount;
+        unitsByLocation = snapshot->locationUnits;
+        valueByLocation = snapshot->locationValue;
+    }
+
+    cout << "Total Products:        " << totalProducts << "\n";
+    cout << "Low Stock Products:    " << lowStockProducts << "\n";
+    cout << "Out of Stock Products: " << outOfStockProducts << "\n";
+    cout << "Total Inventory Value: $" << fixed << setprecision(2) << totalInventoryValue << "\n";
+    cout << "Total Categories:      " << categoryCount << "\n";
+    cout << "Total Suppliers:       " << supplierCount << "\n";
+    cout << "Total Transactions:    " << transactionsSeen << "\n";
+    cout << "----------------------------------------------------------------\n";
+    cout << left << setw(25) << "Location" << setw(10) << "Units" << "Value\n";
+    cout << "----------------------------------------------------------------\n";
+
+    for (size_t l = 0; l < unitsByLocation.size(); l++) {
+        cout << left << setw(25) << locations[l].name << setw(10) << unitsByLocation[l]
+             << "$" << fixed << setprecision(2) << valueByLocation[l] << "\n";
+    }
+    cout << "================================================================\n";
+    if (replica != -1) {
+        cout << "(served by replica " << replica + 1 << ")\n";
+    }
+}
+
+// ============================================================
+// QUERY ENGINE
+// ============================================================
+// Ad-hoc filters over products or transactions, e.g.
+//   products WHERE category = "Electronics" AND quantity < 10 SELECT name, price
+//   transactions WHERE total > 100 SUM(total)
+// The source defaults to products and WHERE may be left out. A query runs
+// over columns copied out of the current snapshot (one array per field,
+// strings replaced by dictionary codes). Each comparison is one tight loop
+// over a column that writes a bitmap, 64 rows per word; AND, OR and NOT
+// combine bitmaps word by word. COUNT, SUM, AVG, MIN, MAX or a field list
+// is then taken over the selected rows.
+//
+// The product columns are refreshed by comparing snapshot page pointers,
+// so only pages written since the last query are copied again; the
+// transaction columns only append rows recorded since the last query.
+const int QUERY_DEFAULT_LIMIT = 20;
+
+enum QueryFieldType { FIELD_INT, FIELD_DOUBLE, FIELD_STRING };
+
+struct QueryField {
+    const char* name;
+    QueryFieldType type;
+    int column;     // index into the table's ints, doubles or strings
+};
+
+const QueryField PRODUCT_FIELDS[] = {
+    {"id", FIELD_INT, 0},
+    {"name", FIELD_STRING, 0},
+    {"category", FIELD_STRING, 1},
+    {"quantity", FIELD_INT, 1},
+    {"price", FIELD_DOUBLE, 0},
+};
+const int PRODUCT_FIELD_COUNT = 5;
+
+const QueryField TRANSACTION_FIELDS[] = {
+    {"id", FIELD_INT, 0},
+    {"product_id", FIELD_INT, 1},
+    {"product", FIELD_STRING, 0},
+    {"quantity", FIELD_INT, 2},
+    {"unit_price", FIELD_DOUBLE, 0},
+    {"discount", FIELD_DOUBLE, 1},
+    {"total", FIELD_DOUBLE, 2},
+    {"date", FIELD_STRING, 1},
+};
+const int TRANSACTION_FIELD_COUNT = 8;
+
+// Values are only ever added, so a dictionary keeps names that no row
+// uses any more (renamed products, a cleared history). Once it holds more
+// than twice as many values as the table has rows it is rebuilt from the
+// rows, which keeps it within a constant factor of the live values.
+const int DICTIONARY_MIN_VALUES = 1024;
+
+struct StringDictionary {
+    vector<string> values;
+    unordered_map<string, int> codes;
+};
+
+struct ColumnTable {
+    int rows;
+    vector<vector<int> > ints;
+    vector<vector<double> > doubles;
+    vector<vector<int> > strings;           // dictionary codes
+    vector<StringDictionary> dictionaries;  // one per string column
+    vector<uint64_t> live;                  // rows that exist (active products)
+};
+
+ColumnTable productColumns;
+ColumnTable transactionColumns;
+shared_ptr<const InventorySnapshot> productColumnsSource;  // snapshot the columns match
+int transactionColumnsLastId = 0;   // ID in the last extracted row, to spot a reset
+mutex queryCacheMutex;
+
+int internString(StringDictionary* dictionary, const string& value) {
+    unordered_map<string, int>::const_iterator found = dictionary->codes.find(value);
+    if (found != dictionary->codes.end()) {
+        return found->second;
+    }
+    int code = (int)dictionary->values.size();
+    dictionary->values.push_back(value);
+    dictionary->codes[value] = code;
+    return code;
+}
+
+// Re-encode one string column with only the values its rows still use
+void compactStringColumn(ColumnTable* table, int column) {
+    StringDictionary* dictionary = &table->dictionaries[column];
+    vector<int>* codes = &table->strings[column];
+    StringDictionary kept;
+    vector<int> newCode(dictionary->values.size(), -1);
+
+    for (int row = 0; row < table->rows; row++) {
+        int code = (*codes)[row];
+        if (newCode[code] == -1) {
+            newCode[code] = (int)kept.values.size();
+            kept.values.push_back(dictionary->values[code]);
+            kept.codes[dictionary->values[code]] = newCode[code];
+        }
+        (*codes)[row] = newCode[code];
+    }
+    dictionary->values.swap(kept.values);
+    dictionary->codes.swap(kept.codes);
+}
+
+void compactDictionariesIfNeeded(ColumnTable* table) {
+    for (size_t c = 0; c < table->dictionaries.size(); c++) {
+        if (table->dictionaries[c].values.size() > (size_t)table->rows * 2 + DICTIONARY_MIN_VALUES) {
+            compactStringColumn(table, c);
+        }
+    }
+}
+
+void resizeColumnTable(ColumnTable* table, int rows, int intCount, int doubleCount, int stringCount) {
+    table->ints.resize(intCount);
+    table->doubles.resize(doubleCount);
+    table->strings.resize(stringCount);
+    table->dictionaries.resize(stringCount);
+    for (int c = 0; c < intCount; c++) table->ints[c].resize(rows);
+    for (int c = 0; c < doubleCount; c++) table->doubles[c].resize(rows);
+    for (int c = 0; c < stringCount; c++) table->strings[c].resize(rows);
+    table->live.resize((rows + 63) / 64, 0);
+    if (rows % 64 != 0) {
+        table->live.back() &= (1ULL << (rows % 64)) - 1; // clear rows that were dropped
+    }
+    table->rows = rows;
+}
+
+void setLiveBit(ColumnTable* table, int row, bool live) {
+    uint64_t bit = 1ULL << (row % 64);
+    if (live) {
+        table->live[row / 64] |= bit;
+    } else {
+        table->live[row / 64] &= ~bit;
+    }
+}
+
+// Copy the pages under node that are not shared with oldNode (the same
+// position in the snapshot the columns were last refreshed from)
+void copyChangedProductPages(ColumnTable* table, const SnapshotNode* node, const SnapshotNode* oldNode,
+                             int height, int basePage) {
+    int shift = SNAPSHOT_FANOUT_BITS * (height - 1);
+    for (int c = 0; c < SNAPSHOT_FANOUT; c++) {
+        int childBase = basePage + (c << shift);
+        if (height > 1) {
+            const SnapshotNode* child = node->children[c].get();
+            const SnapshotNode* oldChild = oldNode != NULL ? oldNode->children[c].get() : NULL;
+            if (child != NULL && child != oldChild) {
+                copyChangedProductPages(table, child, oldChild, height - 1, childBase);
+            }
+            continue;
+        }
+
+        const ProductPage* page = node->pages[c].get();
+        if (page == NULL || (oldNode != NULL && oldNode->pages[c].get() == page)) {
+            continue;
+        }
+        int base = childBase * SNAPSHOT_PAGE_SIZE;
+        for (int i = 0; i < SNAPSHOT_PAGE_SIZE && base + i < table->rows; i++) {
+            const Product* product = &page->items[i];
+            int row = base + i;
+            table->ints[0][row] = product->id;
+            table->ints[1][row] = product->quantity;
+            table->doubles[0][row] = product->price;
+            table->strings[0][row] = internString(&table->dictionaries[0], product->name);
+            table->strings[1][row] = internString(&table->dictionaries[1], product->category);
+            setLiveBit(table, row, product->active);
+        }
+    }
+}
+
+// Bring the product columns up to the current snapshot, copying only the
+// pages that were republished since the columns were last refreshed
+void refreshProductColumns() {
+    shared_ptr<const InventorySnapshot> snapshot = acquireSnapshot();
+    const InventorySnapshot* previous = productColumnsSource.get();
+    if (previous == snapshot.get()) {
+        return;
+    }
+
+    ColumnTable* table = &productColumns;
+    resizeColumnTable(table, snapshot->productCount, 2, 1, 2);
+
+    if (snapshot->root) {
+        const SnapshotNode* oldRoot = previous != NULL && previous->height == snapshot->height
+                                      ? previous->root.get() : NULL;
+        copyChangedProductPages(table, snapshot->root.get(), oldRoot, snapshot->height, 0);
+    }
+    compactDictionariesIfNeeded(table);
+    productColumnsSource = snapshot;
+}
+
+// Append transactions recorded since the last refresh. The history below
+// the snapshot's count is immutable, except when it is cleared and
+// refilled, which is caught by checking the last copied ID.
+void refreshTransactionColumns() {
+    int visibleCount = acquireSnapshot()->transactionCount;
+    ColumnTable* table = &transactionColumns;
+
+    int first = table->rows;
+    if (visibleCount < first ||
+        (first > 0 && transactions[first - 1].transactionId != transactionColumnsLastId)) {
+        first = 0;
+        table->dictionaries.clear();
+    }
+    if (first == visibleCount && first == table->rows) {
+        return;
+    }
+
+    resizeColumnTable(table, visibleCount, 3, 3, 2);
+    for (int row = first; row < visibleCount; row++) {
+        const Transaction* trans = &transactions[row];
+        table->ints[0][row] = trans->transactionId;
+        table->ints[1][row] = trans->productId;
+        table->ints[2][row] = trans->quantity;
+        table->doubles[0][row] = trans->unitPrice;
+        table->doubles[1][row] = trans->discount;
+        table->doubles[2][row] = trans->totalPrice;
+        table->strings[0][row] = internString(&table->dictionaries[0], trans->productName);
+        table->strings[1][row] = internString(&table->dictionaries[1], trans->date);
+        setLiveBit(table, row, true);
+    }
+    compactDictionariesIfNeeded(table);
+    transactionColumnsLastId = visibleCount > 0 ? transactions[visibleCount - 1].transactionId : 0;
+}
+
+// ---------- Tokens ----------
+enum QueryTokenType { TOKEN_WORD, TOKEN_NUMBER, TOKEN_STRING, TOKEN_OPERATOR, TOKEN_PUNCT, TOKEN_END };
+
+struct QueryToken {
+    QueryTokenType type;
+    string text;        // keywords and field names are lower-cased
+    double number;
+};
+
+// Split a query into tokens; returns false with a message on bad input
+bool tokenizeQuery(const string& text, vector<QueryToken>* tokens, string* error) {
+    size_t i = 0;
+    while (i < text.size()) {
+        char c = text[i];
+        QueryToken token;
+        token.number = 0.0;
+
+        if (c == ' ' || c == '\t' || c == '\r' || c == '\n') {
+            i++;
+            continue;
+        }
+        if (isalpha((unsigned char)c) || c == '_') {
+            size_t start = i;
+            while (i < text.size() && (isalnum((unsigned char)text[i]) || text[i] == '_')) {
+                i++;
+            }
+            token.type = TOKEN_WORD;
+            token.text = text.substr(start, i - start);
+            for (size_t k = 0; k < token.text.size(); k++) {
+                token.text[k] = (char)tolower((unsigned char)token.text[k]);
+            }
+        } else if (isdigit((unsigned char)c) || c == '.' ||
+                   (c == '-' && i + 1 < text.size() && (isdigit((unsigned char)text[i + 1]) || text[i + 1] == '.'))) {
+            char* end;
+            token.type = TOKEN_NUMBER;
+            token.number = strtod(text.c_str() + i, &end);
+            if (end == text.c_str() + i) {
+                *error = "Bad number at position " + to_string(i + 1);
+                return false;
+            }
+            i = end - text.c_str();
+        } else if (c == '"' || c == '\'') {
+            size_t close = text.find(c, i + 1);
+            if (close == string::npos) {
+                *error = "Unterminated string starting at position " + to_string(i + 1);
+                return false;
+            }
+            token.type = TOKEN_STRING;
+            token.text = text.substr(i + 1, close - i - 1);
+            i = close + 1;
+        } else if (c == '=' || c == '<' || c == '>' || c == '!') {
+            token.type = TOKEN_OPERATOR;
+            token.text = c;
+            i++;
+            if (i < text.size() && (text[i] == '=' || (c == '<' && text[i] == '>'))) {
+                token.text += text[i++];
+            }
+            if (token.text == "!") {
+                *error = "Expected != at position " + to_string(i);
+                return false;
+            }
+            if (token.text == "==") token.text = "=";
+            if (token.text == "<>") token.text = "!=";
+        } else if (c == '(' || c == ')' || c == ',' || c == '*') {
+            token.type = TOKEN_PUNCT;
+            token.text = c;
+            i++;
+        } else {
+            *error = string("Unexpected character '") + c + "' at position " + to_string(i + 1);
+            return false;
+        }
+        tokens->push_back(token);
+    }
+
+    QueryToken end;
+    end.type = TOKEN_END;
+    end.number = 0.0;
+    tokens->push_back(end);
+    return true;
+}
+
+// ---------- Parsed query ----------
+enum QueryOperator { QUERY_EQ, QUERY_NE, QUERY_LT, QUERY_LE, QUERY_GT, QUERY_GE };
+enum QueryNodeKind { NODE_COMPARE, NODE_AND, NODE_OR, NODE_NOT };
+enum QueryAggregate { AGGREGATE_NONE, AGGREGATE_COUNT, AGGREGATE_SUM, AGGREGATE_AVG,
+                      AGGREGATE_MIN, AGGREGATE_MAX };
+
+struct QueryNode {
+    QueryNodeKind kind;
+    int left, right;        // child nodes (NOT uses left only)
+    int field;              // NODE_COMPARE: index into the source's field list
+    QueryOperator op;
+    double number;
+    string text;
+};
+
+struct ParsedQuery {
+    bool transactions;      // source table
+    vector<QueryNode> nodes;
+    int root;               // -1 when there is no WHERE clause
+    QueryAggregate aggregate;
+    int aggregateField;
+    vector<int> selectFields;
+    int limit;
+};
+
+struct QueryParser {
+    const vector<QueryToken>* tokens;
+    size_t position;
+    ParsedQuery* query;
+    string error;
+};
+
+const QueryToken* peekToken(QueryParser* parser) {
+    return &(*parser->tokens)[parser->position];
+}
+
+bool isKeyword(const QueryToken* token, const char* word) {
+    return token->type == TOKEN_WORD && token->text == word;
+}
+
+bool isPunct(const QueryToken* token, const char* punct) {
+    return token->type == TOKEN_PUNCT && token->text == punct;
+}
+
+const QueryField* queryFields(const ParsedQuery* query, int* count) {
+    *count = query->transactions ? TRANSACTION_FIELD_COUNT : PRODUCT_FIELD_COUNT;
+    return query->transactions ? TRANSACTION_FIELDS : PRODUCT_FIELDS;
+}
+
+int parseFieldName(QueryParser* parser) {
+    const QueryToken* token = peekToken(parser);
+    int count;
+    const QueryField* fields = queryFields(parser->query, &count);
+    if (token->type == TOKEN_WORD) {
+        for (int f = 0; f < count; f++) {
+            if (token->text == fields[f].name) {
+                parser->position++;
+                return f;
+            }
+        }
+    }
+
+    parser->error = "Unknown field '" + token->text + "'. Fields:";
+    for (int f = 0; f < count; f++) {
+        parser->error += string(" ") + fields[f].name;
+    }
+    return -1;
+}
+
+int addQueryNode(QueryParser* parser, QueryNodeKind kind, int left, int right) {
+    QueryNode node;
+    node.kind = kind;
+    node.left = left;
+    node.right = right;
+    node.field = -1;
+    node.op = QUERY_EQ;
+    node.number = 0.0;
+    parser->query->nodes.push_back(node);
+    return (int)parser->query->nodes.size() - 1;
+}
+
+int parseOrExpression(QueryParser* parser);
+
+// comparison | NOT term | ( expression )
+int parseTerm(QueryParser* parser) {
+    const QueryToken* token = peekToken(parser);
+    if (isKeyword(token, "not")) {
+        parser->position++;
+        int operand = parseTerm(parser);
+        return operand < 0 ? -1 : addQueryNode(parser, NODE_NOT, operand, -1);
+    }
+    if (isPunct(token, "(")) {
+        parser->position++;
+        int inner = parseOrExpression(parser);
+        if (inner < 0) {
+            return -1;
+        }
+        if (!isPunct(peekToken(parser), ")")) {
+            parser->error = "Expected )";
+            return -1;
+        }
+        parser->position++;
+        return inner;
+    }
+
+    int field = parseFieldName(parser);
+    if (field < 0) {
+        return -1;
+    }
+
+    token = peekToken(parser);
+    if (token->type != TOKEN_OPERATOR) {
+        parser->error = "Expected a comparison (=, !=, <, <=, >, >=) after the field name";
+        return -1;
+    }
+    static const char* OPERATOR_TEXT[] = {"=", "!=", "<", "<=", ">", ">="};
+    QueryOperator op = QUERY_EQ;
+    for (int o = 0; o < 6; o++) {
+        if (token->text == OPERATOR_TEXT[o]) {
+            op = (QueryOperator)o;
+        }
+    }
+    parser->position++;
+
+    int count;
+    const QueryField* fields = queryFields(parser->query, &count);
+    const QueryToken* value = peekToken(parser);
+    bool stringField = fields[field].type == FIELD_STRING;
+    if (stringField && value->type != TOKEN_STRING) {
+        parser->error = string("Field '") + fields[field].name + "' needs a quoted text value";
+        return -1;
+    }
+    if (!stringField && value->type != TOKEN_NUMBER) {
+        parser->error = string("Field '") + fields[field].name + "' needs a number";
+        return -1;
+    }
+    if (stringField && op != QUERY_EQ && op != QUERY_NE) {
+        parser->error = "Text fields only support = and !=";
+        return -1;
+    }
+    parser->position++;
+
+    int node = addQueryNode(parser, NODE_COMPARE, -1, -1);
+    parser->query->nodes[node].field = field;
+    parser->query->nodes[node].op = op;
+    parser->query->nodes[node].number = value->number;
+    parser->query->nodes[node].text = value->text;
+    return node;
+}
+
+int parseAndExpression(QueryParser* parser) {
+    int left = parseTerm(parser);
+    while (left >= 0 && isKeyword(peekToken(parser), "and")) {
+        parser->position++;
+        int right = parseTerm(parser);
+        left = right < 0 ? -1 : addQueryNode(parser, NODE_AND, left, right);
+    }
+    return left;
+}
+
+int parseOrExpression(QueryParser* parser) {
+    int left = parseAndExpression(parser);
+    while (left >= 0 && isKeyword(peekToken(parser), "or")) {
+        parser->position++;
+        int right = parseAndExpression(parser);
+        left = right < 0 ? -1 : addQueryNode(parser, NODE_OR, left, right);
+    }
+    return left;
+}
+
+// [products|transactions] [WHERE] [expression] [SELECT] [output] [LIMIT n]
+bool parseQuery(const string& text, ParsedQuery* query, string* error) {
+    vector<QueryToken> tokens;
+    if (!tokenizeQuery(text, &tokens, error)) {
+        return false;
+    }
+
+    QueryParser parser = {&tokens, 0, query, ""};
+    query->transactions = false;
+    query->nodes.clear();
+    query->root = -1;
+    query->aggregate = AGGREGATE_NONE;
+    query->aggregateField = -1;
+    query->selectFields.clear();
+    query->limit = QUERY_DEFAULT_LIMIT;
+
+    if (isKeyword(peekToken(&parser), "products") || isKeyword(peekToken(&parser), "transactions")) {
+        query->transactions = peekToken(&parser)->text == "transactions";
+        parser.position++;
+    }
+    bool hasWhere = isKeyword(peekToken(&parser), "where");
+    if (hasWhere) {
+        parser.position++;
+    }
+
+    static const char* OUTPUT_WORDS[] = {"select", "count", "sum", "avg", "min", "max", "limit"};
+    bool startsOutput = peekToken(&parser)->type == TOKEN_END;
+    for (int w = 0; w < 7 && !startsOutput; w++) {
+        startsOutput = isKeyword(peekToken(&parser), OUTPUT_WORDS[w]);
+    }
+    if (hasWhere || !startsOutput) {
+        query->root = parseOrExpression(&parser);
+        if (query->root < 0) {
+            *error = parser.error;
+            return false;
+        }
+    }
+
+    if (isKeyword(peekToken(&parser), "select")) {
+        parser.position++;
+    }
+
+    const QueryToken* token = peekToken(&parser);
+    static const char* AGGREGATE_WORDS[] = {"", "count", "sum", "avg", "min", "max"};
+    for (int a = AGGREGATE_COUNT; a <= AGGREGATE_MAX; a++) {
+        if (isKeyword(token, AGGREGATE_WORDS[a])) {
+            query->aggregate = (QueryAggregate)a;
+        }
+    }
+
+    if (query->aggregate == AGGREGATE_COUNT) {
+        parser.position++;
+        if (isPunct(peekToken(&parser), "(")) {
+            parser.position++;
+            if (isPunct(peekToken(&parser), "*")) {
+                parser.position++;
+            }
+            if (!isPunct(peekToken(&parser), ")")) {
+                *error = "Expected ) after COUNT(";
+                return false;
+            }
+            parser.position++;
+        }
+    } else if (query->aggregate != AGGREGATE_NONE) {
+        parser.position++;
+        bool parenthesised = isPunct(peekToken(&parser), "(");
+        if (parenthesised) {
+            parser.position++;
+        }
+        query->aggregateField = parseFieldName(&parser);
+        if (query->aggregateField < 0) {
+            *error = parser.error;
+            return false;
+        }
+        int count;
+        if (queryFields(query, &count)[query->aggregateField].type == FIELD_STRING) {
+            *error = "SUM, AVG, MIN and MAX need a numeric field";
+            return false;
+        }
+        if (parenthesised) {
+            if (!isPunct(peekToken(&parser), ")")) {
+                *error = "Expected )";
+                return false;
+            }
+            parser.position++;
+        }
+    } else if (isPunct(token, "*")) {
+        parser.position++;
+    } else if (token->type == TOKEN_WORD && !isKeyword(token, "limit")) {
+        do {
+            if (isPunct(peekToken(&parser), ",")) {
+                parser.position++;
+            }
+            int field = parseFieldName(&parser);
+            if (field < 0) {
+                *error = parser.error;
+                return false;
+            }
+            query->selectFields.push_back(field);
+        } while (isPunct(peekToken(&parser), ","));
+    }
+
+    if (isKeyword(peekToken(&parser), "limit")) {
+        parser.position++;
+        if (peekToken(&parser)->type != TOKEN_NUMBER || peekToken(&parser)->number < 0) {
+            *error = "LIMIT needs a number";
+            return false;
+        }
+        query->limit = (int)peekToken(&parser)->number;
+        parser.position++;
+    }
+
+    if (peekToken(&parser)->type != TOKEN_END) {
+        *error = "Unexpected '" + peekToken(&parser)->text + "'";
+        return false;
+    }
+    if (query->selectFields.empty() && query->aggregate == AGGREGATE_NONE) {
+        int count;
+        queryFields(query, &count);
+        for (int f = 0; f < count; f++) {
+            query->selectFields.push_back(f);
+        }
+    }
+    return true;
+}
+
+// ---------- Predicate kernels ----------
+// One pass over a column per comparison; the operator is fixed per call so
+// the inner loop is branch-free and the compiler can vectorise it.
+struct CompareEqual { double v; bool operator()(double x) const { return x == v; } };
+struct CompareNotEqual { double v; bool operator()(double x) const { return x != v; } };
+struct CompareLess { double v; bool operator()(double x) const { return x < v; } };
+struct CompareLessEqual { double v; bool operator()(double x) const { return x <= v; } };
+struct CompareGreater { double v; bool operator()(double x) const { return x > v; } };
+struct CompareGreaterEqual { double v; bool operator()(double x) const { return x >= v; } };
+
+template <typename T, typename Compare>
+void fillSelection(const T* column, int rows, Compare compare, uint64_t* out) {
+    int fullWords = rows / 64;
+    for (int w = 0; w < fullWords; w++) {
+        const T* block = column + w * 64;
+        uint64_t bits = 0;
+        for (int b = 0; b < 64; b++) {
+            bits |= (uint64_t)compare((double)block[b]) << b;
+        }
+        out[w] = bits;
+    }
+    if (rows % 64 != 0) {
+        uint64_t bits = 0;
+        for (int b = 0; b < rows % 64; b++) {
+            bits |= (uint64_t)compare((double)column[fullWords * 64 + b]) << b;
+        }
+        out[fullWords] = bits;
+    }
+}
+
+template <typename T>
+void compareColumn(const T* column, int rows, QueryOperator op, double value, uint64_t* out) {
+    switch (op) {
+        case QUERY_EQ: { CompareEqual c = {value}; fillSelection(column, rows, c, out); break; }
+        case QUERY_NE: { CompareNotEqual c = {value}; fillSelection(column, rows, c, out); break; }
+        case QUERY_LT: { CompareLess c = {value}; fillSelection(column, rows, c, out); break; }
+        case QUERY_LE: { CompareLessEqual c = {value}; fillSelection(column, rows, c, out); break; }
+        case QUERY_GT: { CompareGreater c = {value}; fillSelection(column, rows, c, out); break; }
+        case QUERY_GE: { CompareGreaterEqual c = {value}; fillSelection(column, rows, c, out); break; }
+    }
+}
+
+int popCount64(uint64_t bits) {
+#ifdef __GNUC__
+    return __builtin_popcountll(bits);
+#else
+    int count = 0;
+    while (bits != 0) {
+        bits &= bits - 1;
+        count++;
+    }
+    return count;
+#endif
+}
+
+int lowestBit64(uint64_t bits) {
+#ifdef __GNUC__
+    return __builtin_ctzll(bits);
+#else
+    int bit = 0;
+    while ((bits & 1) == 0) {
+        bits >>= 1;
+        bit++;
+    }
+    return bit;
+#endif
+}
+
+// Evaluate one expression node into a selection bitmap
+void evaluateQueryNode(const ParsedQuery* query, int node, const ColumnTable* table, vector<uint64_t>* out) {
+    const QueryNode* current = &query->nodes[node];
+    size_t words = table->live.size();
+    out->assign(words, 0);
+    if (words == 0) {
+        return;
+    }
+
+    if (current->kind == NODE_COMPARE) {
+        int count;
+        const QueryField* field = &queryFields(query, &count)[current->field];
+        if (field->type == FIELD_INT) {
+            compareColumn(&table->ints[field->column][0], table->rows, current->op, current->number, &(*out)[0]);
+        } else if (field->type == FIELD_DOUBLE) {
+            compareColumn(&table->doubles[field->column][0], table->rows, current->op, current->number, &(*out)[0]);
+        } else {
+            // Text compares as its dictionary code; unknown text matches no row
+            const StringDictionary* dictionary = &table->dictionaries[field->column];
+            unordered_map<string, int>::const_iterator found = dictionary->codes.find(current->text);
+            double code = found != dictionary->codes.end() ? found->second : -1;
+            compareColumn(&table->strings[field->column][0], table->rows, current->op, code, &(*out)[0]);
+        }
+        return;
+    }
+
+    evaluateQueryNode(query, current->left, table, out);
+    if (current->kind == NODE_NOT) {
+        for (size_t w = 0; w < words; w++) {
+            (*out)[w] = ~(*out)[w];
+        }
+        return;   // rows past the end are cleared by the final AND with live
+    }
+
+    vector<uint64_t> right;
+    evaluateQueryNode(query, current->right, table, &right);
+    if (current->kind == NODE_AND) {
+        for (size_t w = 0; w < words; w++) {
+            (*out)[w] &= right[w];
+        }
+    } else {
+        for (size_t w = 0; w < words; w++) {
+            (*out)[w] |= right[w];
+        }
+    }
+}
+
+struct QueryResult {
+    bool transactions;
+    int matched;
+    QueryAggregate aggregate;
+    int aggregateField;
+    double aggregateValue;
+    vector<int> selectFields;
+    vector<vector<string> > rows;   // projected values, at most `limit` rows
+};
+
+string formatQueryValue(const ColumnTable* table, const QueryField* field, int row) {
+    if (field->type == FIELD_INT) {
+        return to_string(table->ints[field->column][row]);
+    }
+    if (field->type == FIELD_STRING) {
+        return table->dictionaries[field->column].values[table->strings[field->column][row]];
+    }
+    char buffer[32];
+    snprintf(buffer, sizeof(buffer), "%.2f", table->doubles[field->column][row]);
+    return buffer;
+}
+
+// Parse and run a query (call by address for the result). Returns false
+// with a message in `error` if the query does not parse.
+bool runQuery(const string& text, QueryResult* result, string* error) {
+    ParsedQuery query;
+    if (!parseQuery(text, &query, error)) {
+        return false;
+    }
+
+    lock_guard<mutex> lock(queryCacheMutex);
+    ColumnTable* table;
+    if (query.transactions) {
+        refreshTransactionColumns();
+        table = &transactionColumns;
+    } else {
+        refreshProductColumns();
+        table = &productColumns;
+    }
+
+    vector<uint64_t> selection;
+    if (query.root >= 0) {
+        evaluateQueryNode(&query, query.root, table, &selection);
+        for (size_t w = 0; w < selection.size(); w++) {
+            selection[w] &= table->live[w];
+        }
+    } else {
+        selection = table->live;
+    }
+
+    result->transactions = query.transactions;
+    result->aggregate = query.aggregate;
+    result->aggregateField = query.aggregateField;
+    result->selectFields = query.selectFields;
+    result->rows.clear();
+    result->matched = 0;
+    for (size_t w = 0; w < selection.size(); w++) {
+        result->matched += popCount64(selection[w]);
+    }
+
+    int fieldCount;
+    const QueryField* fields = queryFields(&query, &fieldCount);
+    result->aggregateValue = result->matched;
+
+    if (query.aggregate >= AGGREGATE_SUM) {
+        const QueryField* field = &fields[query.aggregateField];
+        double sum = 0.0, low = 0.0, high = 0.0;
+        bool first = true;
+        for (size_t w = 0; w < selection.size(); w++) {
+            uint64_t bits = selection[w];
+            while (bits != 0) {
+                int row = (int)(w * 64) + lowestBit64(bits);
+                bits &= bits - 1;
+                double value = field->type == FIELD_INT ? table->ints[field->column][row]
+                                                        : table->doubles[field->column][row];
+                sum += value;
+                low = first || value < low ? value : low;
+                high = first || value > high ? value : high;
+                first = false;
+            }
+        }
+        if (query.aggregate == AGGREGATE_SUM) result->aggregateValue = sum;
+        if (query.aggregate == AGGREGATE_AVG) result->aggregateValue = result->matched > 0 ? sum / result->matched : 0.0;
+        if (query.aggregate == AGGREGATE_MIN) result->aggregateValue = low;
+        if (query.aggregate == AGGREGATE_MAX) result->aggregateValue = high;
+    } else if (query.aggregate == AGGREGATE_NONE) {
+        for (size_t w = 0; w < selection.size() && (int)result->rows.size() < query.limit; w++) {
+            uint64_t bits = selection[w];
+            while (bits != 0 && (int)result->rows.size() < query.limit) {
+                int row = (int)(w * 64) + lowestBit64(bits);
+                bits &= bits - 1;
+                vector<string> values;
+                for (size_t f = 0; f < query.selectFields.size(); f++) {
+                    values.push_back(formatQueryValue(table, &fields[query.selectFields[f]], row));
+                }
+                result->rows.push_back(values);
+            }
+        }
+    }
+    return true;
+}
+
+void runQueryPrompt() {
+    clearScreen();
+    printTableHeader("RUN QUERY");
+
+    cout << "Examples:\n";
+    cout << "  category = \"Electronics\" AND quantity < 10 AND price > 100\n";
+    cout << "  products WHERE price >= 20 AND NOT category = \"Food\" SELECT name, price LIMIT 5\n";
+    cout << "  transactions WHERE quantity >= 5 SUM(total)\n";
+    cout << "Product fields: id, name, category, quantity, price\n";
+    cout << "Transaction fields: id, product_id, product, quantity, unit_price, discount, total, date\n\n";
+
+    string text;
+    clearInputBuffer();
+    cout << "Query: ";
+    getline(cin, text);
+    if (text.empty()) {
+        printError("Query cannot be empty!");
+        return;
+    }
+
+    QueryResult result;
+    string error;
+    if (!runQuery(text, &result, &error)) {
+        printError(error);
+        return;
+    }
+
+    cout << "\n";
+    static const char* AGGREGATE_NAMES[] = {"", "COUNT", "SUM", "AVG", "MIN", "MAX"};
+    const QueryField* fields = result.transactions ? TRANSACTION_FIELDS : PRODUCT_FIELDS;
+
+    if (result.aggregate == AGGREGATE_COUNT) {
+        cout << "COUNT = " << result.matched << "\n";
+    } else if (result.aggregate != AGGREGATE_NONE) {
+        cout << AGGREGATE_NAMES[result.aggregate] << "(" << fields[result.aggregateField].name << ") = "
+             << fixed << setprecision(2) << result.aggregateValue
+             << "  over " << result.matched << " row(s)\n";
+    } else {
+        for (size_t f = 0; f < result.selectFields.size(); f++) {
+            cout << left << setw(f + 1 < result.selectFields.size() ? 15 : 0)
+                 << fields[result.selectFields[f]].name;
+        }
+        cout << "\n----------------------------------------------------------------\n";
+        for (size_t r = 0; r < result.rows.size(); r++) {
+            for (size_t f = 0; f < result.rows[r].size(); f++) {
+                cout << left << setw(f + 1 < result.rows[r].size() ? 15 : 0) << result.rows[r][f];
+            }
+            cout << "\n";
+        }
+        cout << "----------------------------------------------------------------\n";
+        cout << result.matched << " row(s) matched";
+        if ((int)result.rows.size() < result.matched) {
+            cout << ", showing " << result.rows.size();
+        }
+        cout << "\n";
+    }
+}
+
+// ============================================================
+// PRODUCT VERSION HISTORY
+// ============================================================
+// Every product write that goes through publishProductChanges adds a
+// version: a small entry holding only the fields that changed, appended
+// to a chunked byte arena that is never rewritten. Entries keep what is
+// needed to undo them (old name, category and price, and the change in
+// ID and quantity), and each one points back at the product's previous
+// entry. The state at time T is a later state with the entries after T
+// undone one by one, walking the chain back. So that walk stays short,
+// every 64th version of a product also keeps a full copy of the product
+// (a keyframe); a lookup starts from the first keyframe after T.
+//
+// Entries are appended in time order, so a time window is found by a
+// binary search over a sparse index (every 256th entry) and a forward scan.
+//
+// Entry layout, integers as varints:
+//   distance back to the product's previous entry (0 = first version)
+//   product slot
+//   milliseconds since the chunk's first entry
+//   one byte of HISTORY_* flags, then one value per flag set, in flag order
+const int HISTORY_CHUNK_SIZE = 1 << 20;    // 1 MB
+const int HISTORY_KEYFRAME_INTERVAL = 64;  // versions between full copies
+const int HISTORY_MARK_INTERVAL = 256;     // entries between time index marks
+
+const int HISTORY_ID = 1;           // ID change (zigzag)
+const int HISTORY_NAME = 2;         // old name (length, bytes)
+const int HISTORY_CATEGORY = 4;     // old category (length, bytes)
+const int HISTORY_QUANTITY = 8;     // quantity change (zigzag)
+const int HISTORY_PRICE = 16;       // old price (8 raw bytes)
+const int HISTORY_ACTIVE = 32;      // active flag flipped (no value)
+const int HISTORY_CREATED = 64;     // first version of the slot (no value)
+
+struct HistoryChunk {
+    vector<unsigned char> bytes;    // capacity fixed when the chunk starts
+    long long baseTime;             // ms timestamp of the chunk's first entry
+};
+
+struct HistoryEntry {
+    long long handle;       // (chunk << 32) | offset
+    long long previous;     // handle of the product's previous entry, or -1
+    int productIndex;
+    long long time;         // ms since epoch
+    int flags;
+    int idChange;
+    int quantityChange;
+    double oldPrice;
+    string oldName;
+    string oldCategory;
+};
+
+// Product state right after the entry at `handle`
+struct HistoryKeyframe {
+    long long handle;
+    long long time;
+    int version;
+    Product state;
+};
+
+struct HistoryMark {
+    long long time;
+    long long handle;
+};
+
+vector<HistoryChunk> historyChunks;
+vector<HistoryMark> historyMarks;
+vector<HistoryKeyframe> historyKeyframes[MAX_ITEMS];   // oldest first
+long long historyHead[MAX_ITEMS];       // newest entry per product slot
+int historyVersions[MAX_ITEMS];         // versions recorded per slot; 0 = no history
+Product versionedProducts[MAX_ITEMS];   // state as of each slot's newest entry
+long long historyLastTime = 0;
+long long historyEntryCount = 0;
+long long historyByteCount = 0;
+
+// Forget all versions, e.g. after product slots were renumbered
+void resetProductHistory() {
+    historyChunks.clear();
+    historyMarks.clear();
+    for (int i = 0; i < MAX_ITEMS; i++) {
+        historyVersions[i] = 0;
+        historyKeyframes[i].clear();
+    }
+    historyLastTime = 0;
+    historyEntryCount = 0;
+    historyByteCount = 0;
+}
+
+long long newestHistoryEntry(int index) {
+    return historyVersions[index] > 0 ? historyHead[index] : -1;
+}
+
+long long currentTimeMs() {
+    return chrono::duration_cast<chrono::milliseconds>(
+        chrono::system_clock::now().time_since_epoch()).count();
+}
+
+void putHistoryVarint(unsigned char** out, unsigned long long value) {
+    while (value >= 0x80) {
+        *(*out)++ = (unsigned char)(value | 0x80);
+        value >>= 7;
+    }
+    *(*out)++ = (unsigned char)value;
+}
+
+unsigned long long getHistoryVarint(const unsigned char** in) {
+    unsigned long long value = 0;
+    int shift = 0;
+    while (**in & 0x80) {
+        value |= (unsigned long long)(*(*in)++ & 0x7f) << shift;
+        shift += 7;
+    }
+    value |= (unsigned long long)*(*in)++ << shift;
+    return value;
+}
+
+unsigned long long zigzagEncode(long long value) {
+    return ((unsigned long long)value << 1) ^ (unsigned long long)(value >> 63);
+}
+
+long long zigzagDecode(unsigned long long value) {
+    return (long long)(value >> 1) ^ -(long long)(value & 1);
+}
+
+// Append a version for each product slot whose fields differ from its
+// last recorded state. Called from publishProductChanges; the caller must
+// hold inventoryWriteMutex.
+void recordProductVersions(int firstIndex, int lastIndex) {
+    long long now = 0;
+    for (int i = firstIndex; i <= lastIndex && i < productCount; i++) {
+        const Product* product = &products[i];
+        Product* known = &versionedProducts[i];
+        bool created = historyVersions[i] == 0;
+
+        int flags = 0;
+        if (created) {
+            flags = HISTORY_CREATED;   // nothing to undo into
+        } else {
+            if (product->id != known->id) flags |= HISTORY_ID;
+            if (product->name != known->name) flags |= HISTORY_NAME;
+            if (product->category != known->category) flags |= HISTORY_CATEGORY;
+            if (product->quantity != known->quantity) flags |= HISTORY_QUANTITY;
+            if (product->price != known->price) flags |= HISTORY_PRICE;
+            if (product->active != known->active) flags |= HISTORY_ACTIVE;
+            if (flags == 0) {
+                continue;
+            }
+        }
+
+        if (now == 0) {
+            now = max(currentTimeMs(), historyLastTime); // never step backwards
+            historyLastTime = now;
+        }
+
+        // Varints take at most 10 bytes; strings add their length
+        size_t bound = 5 * 10 + 1 + 8;
+        if (flags & HISTORY_NAME) bound += 10 + known->name.size();
+        if (flags & HISTORY_CATEGORY) bound += 10 + known->category.size();
+        if (historyChunks.empty() ||
+            historyChunks.back().bytes.size() + bound > historyChunks.back().bytes.capacity()) {
+            historyChunks.push_back(HistoryChunk());
+            historyChunks.back().bytes.reserve(max((size_t)HISTORY_CHUNK_SIZE, bound));
+            historyChunks.back().baseTime = now;
+        }
+        HistoryChunk* chunk = &historyChunks.back();
+        long long handle = ((long long)(historyChunks.size() - 1) << 32) | (long long)chunk->bytes.size();
+
+        unsigned char scratch[256];
+        vector<unsigned char> large;
+        unsigned char* start = scratch;
+        if (bound > sizeof(scratch)) {
+            large.resize(bound);
+            start = &large[0];
+        }
+
+        unsigned char* out = start;
+        putHistoryVarint(&out, created ? 0 : (unsigned long long)(handle - historyHead[i]));
+        putHistoryVarint(&out, (unsigned long long)i);
+        putHistoryVarint(&out, (unsigned long long)(now - chunk->baseTime));
+        *out++ = (unsigned char)flags;
+        if (flags & HISTORY_ID) putHistoryVarint(&out, zigzagEncode((long long)product->id - known->id));
+        if (flags & HISTORY_NAME) {
+            putHistoryVarint(&out, known->name.size());
+            memcpy(out, known->name.data(), known->name.size());
+            out += known->name.size();
+        }
+        if (flags & HISTORY_CATEGORY) {
+            putHistoryVarint(&out, known->category.size());
+            memcpy(out, known->category.data(), known->category.size());
+            out += known->category.size();
+        }
+        if (flags & HISTORY_QUANTITY) {
+            putHistoryVarint(&out, zigzagEncode((long long)product->quantity - known->quantity));
+        }
+        if (flags & HISTORY_PRICE) {
+            memcpy(out, &known->price, sizeof(double));
+            out += sizeof(double);
+        }
+
+        size_t size = out - start;
+        chunk->bytes.insert(chunk->bytes.end(), start, out); // within capacity, never moves
+        if (historyEntryCount % HISTORY_MARK_INTERVAL == 0) {
+            HistoryMark mark = {now, handle};
+            historyMarks.push_back(mark);
+        }
+        historyHead[i] = handle;
+        historyVersions[i]++;
+        historyEntryCount++;
+        historyByteCount += size;
+        if (created) {
+            *known = *product;
+        } else {
+            // Only what changed, so a sale does not copy the strings
+            if (flags & HISTORY_ID) known->id = product->id;
+            if (flags & HISTORY_NAME) known->name = product->name;
+            if (flags & HISTORY_CATEGORY) known->category = product->category;
+            if (flags & HISTORY_QUANTITY) known->quantity = product->quantity;
+            if (flags & HISTORY_PRICE) known->price = product->price;
+            if (flags & HISTORY_ACTIVE) known->active = product->active;
+        }
+        if (historyVersions[i] % HISTORY_KEYFRAME_INTERVAL == 0) {
+            HistoryKeyframe keyframe = {handle, now, historyVersions[i], *known};
+            historyKeyframes[i].push_back(keyframe);
+        }
+    }
+}
+
+// Decode the entry at `handle` (call by address); returns the handle of
+// the entry stored right after it in the arena, or -1 at the end
+long long decodeHistoryEntry(long long handle, HistoryEntry* entry) {
+    const HistoryChunk* chunk = &historyChunks[handle >> 32];
+    const unsigned char* in = &chunk->bytes[handle & 0xffffffffLL];
+
+    entry->handle = handle;
+    unsigned long long back = getHistoryVarint(&in);
+    entry->previous = back == 0 ? -1 : handle - (long long)back;
+    entry->productIndex = (int)getHistoryVarint(&in);
+    entry->time = chunk->baseTime + (long long)getHistoryVarint(&in);
+    entry->flags = *in++;
+    entry->idChange = 0;
+    entry->quantityChange = 0;
+    entry->oldPrice = 0.0;
+    entry->oldName.clear();
+    entry->oldCategory.clear();
+
+    if (entry->flags & HISTORY_ID) entry->idChange = (int)zigzagDecode(getHistoryVarint(&in));
+    if (entry->flags & HISTORY_NAME) {
+        size_t length = (size_t)getHistoryVarint(&in);
+        entry->oldName.assign((const char*)in, length);
+        in += length;
+    }
+    if (entry->flags & HISTORY_CATEGORY) {
+        size_t length = (size_t)getHistoryVarint(&in);
+        entry->oldCategory.assign((const char*)in, length);
+        in += length;
+    }
+    if (entry->flags & HISTORY_QUANTITY) entry->quantityChange = (int)zigzagDecode(getHistoryVarint(&in));
+    if (entry->flags & HISTORY_PRICE) {
+        memcpy(&entry->oldPrice, in, sizeof(double));
+        in += sizeof(double);
+    }
+
+    size_t next = in - &chunk->bytes[0];
+    if (next < chunk->bytes.size()) {
+        return (handle & ~0xffffffffLL) | (long long)next;
+    }
+    return (size_t)(handle >> 32) + 1 < historyChunks.size() ? ((handle >> 32) + 1) << 32 : -1;
+}
+
+// Turn the state after `entry` into the state before it
+void undoHistoryEntry(const HistoryEntry* entry, Product* state) {
+    if (entry->flags & HISTORY_ID) state->id -= entry->idChange;
+    if (entry->flags & HISTORY_NAME) state->name = entry->oldName;
+    if (entry->flags & HISTORY_CATEGORY) state->category = entry->oldCategory;
+    if (entry->flags & HISTORY_QUANTITY) state->quantity -= entry->quantityChange;
+    if (entry->flags & HISTORY_PRICE) state->price = entry->oldPrice;
+    if (entry->flags & HISTORY_ACTIVE) state->active = !state->active;
+}
+
+// Start a backward walk for the product slot (call by address): from the
+// first keyframe whose entry comes after `time` / at or after `handle`,
+// or from the newest state when there is none
+long long startHistoryWalk(int index, long long time, long long handle, Product* state, int* version) {
+    const vector<HistoryKeyframe>* keyframes = &historyKeyframes[index];
+    int low = 0;
+    int high = (int)keyframes->size();
+    while (low < high) {
+        int middle = (low + high) / 2;
+        const HistoryKeyframe* keyframe = &(*keyframes)[middle];
+        bool after = handle >= 0 ? keyframe->handle >= handle : keyframe->time > time;
+        if (after) {
+            high = middle;
+        } else {
+            low = middle + 1;
+        }
+    }
+    if (low == (int)keyframes->size()) {
+        *state = versionedProducts[index];
+        *version = historyVersions[index];
+        return newestHistoryEntry(index);
+    }
+    *state = (*keyframes)[low].state;
+    *version = (*keyframes)[low].version;
+    return (*keyframes)[low].handle;
+}
+
+// The product slot as it was at `time` (ms since epoch), call by address.
+// Returns false if the slot held no product yet. The caller must hold
+// inventoryWriteMutex.
+bool getProductStateAt(int index, long long time, Product* state, int* version) {
+    HistoryEntry entry;
+    for (long long handle = startHistoryWalk(index, time, -1, state, version); handle != -1;
+         handle = entry.previous) {
+        decodeHistoryEntry(handle, &entry);
+        if (entry.time <= time) {
+            return true;
+        }
+        if (entry.flags & HISTORY_CREATED) {
+            return false;
+        }
+        undoHistoryEntry(&entry, state);
+        (*version)--;
+    }
+    return false;
+}
+
+// The product slot right after the entry at `handle` (call by address).
+// The caller must hold inventoryWriteMutex.
+void getProductStateAfter(int index, long long handle, Product* state) {
+    int version;
+    HistoryEntry entry;
+    for (long long current = startHistoryWalk(index, 0, handle, state, &version);
+         current != handle && current != -1; current = entry.previous) {
+        decodeHistoryEntry(current, &entry);
+        undoHistoryEntry(&entry, state);
+    }
+}
+
+// Entries with from <= time <= to for any product, oldest first, at most
+// `limit` of them. Returns false if more were left out. The caller must
+// hold inventoryWriteMutex.
+bool findHistoryInWindow(long long from, long long to, int limit, vector<HistoryEntry>* out) {
+    // Start at the last mark before `from` (or the very first entry)
+    int low = 0;
+    int high = (int)historyMarks.size();
+    while (low < high) {
+        int middle = (low + high) / 2;
+        if (historyMarks[middle].time < from) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+
+    HistoryEntry entry;
+    long long handle = historyMarks.empty() ? -1 : low > 0 ? historyMarks[low - 1].handle : historyMarks[0].handle;
+    while (handle != -1) {
+        long long next = decodeHistoryEntry(handle, &entry);
+        if (entry.time > to) {
+            return true;
+        }
+        if (entry.time >= from) {
+            if ((int)out->size() == limit) {
+                return false;
+            }
+            out->push_back(entry);
+        }
+        handle = next;
+    }
+    return true;
+}
+
+// "DD/MM/YYYY HH:MM[:SS]" or "DD/MM/YYYY" in local time, to ms since epoch
+bool parseDateTime(const string& text, long long* time) {
+    int day, month, year, hour = 0, minute = 0, second = 0;
+    int fields = sscanf(text.c_str(), "%d/%d/%d %d:%d:%d", &day, &month, &year, &hour, &minute, &second);
+    if (fields != 3 && fields != 5 && fields != 6) {
+        return false;
+    }
+    tm parts;
+    memset(&parts, 0, sizeof(parts));
+    parts.tm_mday = day;
+    parts.tm_mon = month - 1;
+    parts.tm_year = year - 1900;
+    parts.tm_hour = hour;
+    parts.tm_min = minute;
+    parts.tm_sec = second;
+    parts.tm_isdst = -1;
+    time_t seconds = mktime(&parts);
+    if (seconds == (time_t)-1) {
+        return false;
+    }
+    *time = (long long)seconds * 1000 + 999; // the whole second is included
+    return true;
+}
+
+string formatHistoryTime(long long time) {
+    return formatDate((time_t)(time / 1000)) + " " + formatTime((time_t)(time / 1000));
+}
+
+// One line per changed field, "before -> after"
+void printHistoryChanges(const HistoryEntry* entry, const Product* before, const Product* after) {
+    if (entry->flags & HISTORY_CREATED) {
+        cout << "    created: " << after->name << " (" << after->category << "), qty "
+             << after->quantity << ", $" << fixed << setprecision(2) << after->price << "\n";
+        return;
+    }
+    if (entry->flags & HISTORY_ID) cout << "    id:       " << before->id << " -> " << after->id << "\n";
+    if (entry->flags & HISTORY_NAME) cout << "    name:     " << before->name << " -> " << after->name << "\n";
+    if (entry->flags & HISTORY_CATEGORY) cout << "    category: " << before->category << " -> " << after->category << "\n";
+    if (entry->flags & HISTORY_QUANTITY) cout << "    quantity: " << before->quantity << " -> " << after->quantity << "\n";
+    if (entry->flags & HISTORY_PRICE) {
+        cout << "    price:    $" << fixed << setprecision(2) << before->price
+             << " -> $" << after->price << "\n";
+    }
+    if (entry->flags & HISTORY_ACTIVE) cout << "    " << (after->active ? "restored" : "deleted") << "\n";
+}
+
+// Slot of the product with this ID, deleted products included (newest
+// slot first, as IDs of deleted products can be reused)
+int findProductSlotById(int id) {
+    for (int i = productCount - 1; i >= 0; i--) {
+        if (products[i].id == id) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+void viewProductVersions() {
+    int id;
+    cout << "Enter Product ID: ";
+    if (!(cin >> id)) {
+        clearInputBuffer();
+        printError("Invalid input! ID must be a number.");
+        return;
+    }
+    int index = findProductSlotById(id);
+    if (index == -1) {
+        printError("Product not found!");
+        return;
+    }
+
+    lock_guard<mutex> lock(inventoryWriteMutex);
+    cout << "\nVersions of " << products[index].name << " (newest first, at most 20):\n";
+    cout << "----------------------------------------------------------------\n";
+
+    Product after = versionedProducts[index];
+    int version = historyVersions[index];
+    HistoryEntry entry;
+    for (long long handle = newestHistoryEntry(index); handle != -1 && version > historyVersions[index] - 20;
+         handle = entry.previous) {
+        decodeHistoryEntry(handle, &entry);
+        Product before = after;
+        undoHistoryEntry(&entry, &before);
+        cout << "  v" << version << "  " << formatHistoryTime(entry.time) << "\n";
+        printHistoryChanges(&entry, &before, &after);
+        after = before;
+        version--;
+    }
+    cout << "----------------------------------------------------------------\n";
+}
+
+void viewProductAtTime() {
+    int id;
+    cout << "Enter Product ID: ";
+    if (!(cin >> id)) {
+        clearInputBuffer();
+        printError("Invalid input! ID must be a number.");
+        return;
+    }
+    int index = findProductSlotById(id);
+    if (index == -1) {
+        printError("Product not found!");
+        return;
+    }
+
+    string text;
+    long long time;
+    clearInputBuffer();
+    cout << "Enter date and time (DD/MM/YYYY HH:MM:SS): ";
+    getline(cin, text);
+    if (!parseDateTime(text, &time)) {
+        printError("Invalid date! Use DD/MM/YYYY HH:MM:SS.");
+        return;
+    }
+
+    lock_guard<mutex> lock(inventoryWriteMutex);
+    Product state;
+    int version;
+    if (!getProductStateAt(index, time, &state, &version)) {
+        printError("Product did not exist yet at " + text + ".");
+        return;
+    }
+
+    cout << "\nProduct as of " << text << " (version " << version << " of "
+         << historyVersions[index] << "):\n";
+    cout << "  ID:       " << state.id << "\n";
+    cout << "  Name:     " << state.name << "\n";
+    cout << "  Category: " << state.category << "\n";
+    cout << "  Quantity: " << state.quantity << "\n";
+    cout << "  Price:    $" << fixed << setprecision(2) << state.price << "\n";
+    cout << "  Status:   " << (state.active ? "Active" : "Deleted") << "\n";
+}
+
+void viewChangesInWindow() {
+    string fromText, toText;
+    long long from, to;
+    clearInputBuffer();
+    cout << "From (DD/MM/YYYY HH:MM:SS): ";
+    getline(cin, fromText);
+    cout << "To   (DD/MM/YYYY HH:MM:SS): ";
+    getline(cin, toText);
+    if (!parseDateTime(fromText, &from) || !parseDateTime(toText, &to)) {
+        printError("Invalid date! Use DD/MM/YYYY HH:MM:SS.");
+        return;
+    }
+    from -= 999; // from the start of that second
+
+    lock_guard<mutex> lock(inventoryWriteMutex);
+    vector<HistoryEntry> entries;
+    bool complete = findHistoryInWindow(from, to, 50, &entries);
+
+    cout << "\n" << entries.size() << " change(s) between " << fromText << " and " << toText << ":\n";
+    cout << "----------------------------------------------------------------\n";
+    for (size_t e = 0; e < entries.size(); e++) {
+        Product before, after;
+        getProductStateAfter(entries[e].productIndex, entries[e].handle, &after);
+        before = after;
+        undoHistoryEntry(&entries[e], &before);
+        cout << "  " << formatHistoryTime(entries[e].time) << "  #" << after.id << " " << after.name << "\n";
+        printHistoryChanges(&entries[e], &before, &after);
+    }
+    cout << "----------------------------------------------------------------\n";
+    if (!complete) {
+        cout << "Only the first 50 changes are shown; narrow the window for more.\n";
+    }
+}
+
+void viewProductHistory() {
+    clearScreen();
+    printTableHeader("PRODUCT CHANGE HISTORY");
+
+    cout << historyEntryCount << " version(s) recorded in " << historyByteCount << " bytes\n\n";
+    cout << "  1. Versions of one product\n";
+    cout << "  2. One product at a date and time\n";
+    cout << "  3. All changes in a time window\n";
+    cout << "Enter your choice: ";
+
+    int choice;
+    if (!(cin >> choice) || choice < 1 || choice > 3) {
+        clearInputBuffer();
+        printError("Invalid choice!");
+        return;
+    }
+
+    if (choice == 1) {
+        viewProductVersions();
+    } else if (choice == 2) {
+        viewProductAtTime();
+    } else {
+        viewChangesInWindow();
+    }
+}
+
+// ============================================================
+// DATA EXPORT (CSV / NDJSON)
+// ============================================================
+// Rows are formatted by hand straight into one large buffer that is
+// written out with fwrite when it fills, so no row allocates memory.
+const int EXPORT_BUFFER_SIZE = 1 << 20; // 1 MB
+
+char exportBuffer[EXPORT_BUFFER_SIZE];
+
+struct ExportWriter {
+    FILE* file;
+    int used;
+    long long bytesWritten;
+    bool failed;
+};
+
+bool exportOpen(ExportWriter* writer, const char* path) {
+    writer->file = fopen(path, "wb");
+    writer->used = 0;
+    writer->bytesWritten = 0;
+    writer->failed = (writer->file == NULL);
+    return !writer->failed;
+}
+
+void exportFlush(ExportWriter* writer) {
+    if (writer->used > 0 && !writer->failed) {
+        if (fwrite(exportBuffer, 1, writer->used, writer->file) != (size_t)writer->used) {
+            writer->failed = true;
+        }
+        writer->bytesWritten += writer->used;
+    }
+    writer->used = 0;
+}
+
+// Flush and close; returns false if any write failed
+bool exportClose(ExportWriter* writer) {
+    exportFlush(writer);
+    if (writer->file != NULL && fclose(writer->file) != 0) {
+        writer->failed = true;
+    }
+    writer->file = NULL;
+    return !writer->failed;
+}
+
+// Make sure at least `bytes` bytes are free in the buffer
+void exportReserve(ExportWriter* writer, int bytes) {
+    if (writer->used + bytes > EXPORT_BUFFER_SIZE) {
+        exportFlush(writer);
+    }
+}
+
+void exportRaw(ExportWriter* writer, const char* data, int length) {
+    if (length > EXPORT_BUFFER_SIZE / 2) {
+        // Too big to be worth copying: write it through directly
+        exportFlush(writer);
+        if (!writer->failed && fwrite(data, 1, length, writer->file) != (size_t)length) {
+            writer->failed = true;
+        }
+        writer->bytesWritten += length;
+        return;
+    }
+    exportReserve(writer, length);
+    memcpy(exportBuffer + writer->used, data, length);
+    writer->used += length;
+}
+
+void exportChar(ExportWriter* writer, char c) {
+    exportReserve(writer, 1);
+    exportBuffer[writer->used++] = c;
+}
+
+// Format an integer without going through iostreams
+void exportInt(ExportWriter* writer, long long value) {
+    char digits[24];
+    int length = 0;
+    unsigned long long magnitude = value < 0 ? 0ULL - (unsigned long long)value
+                                             : (unsigned long long)value;
+    do {
+        digits[length++] = (char)('0' + magnitude % 10);
+        magnitude /= 10;
+    } while (magnitude > 0);
+
+    exportReserve(writer, length + 1);
+    char* out = exportBuffer + writer->used;
+    if (value < 0) {
+        *out++ = '-';
+    }
+    while (length > 0) {
+        *out++ = digits[--length];
+    }
+    writer->used = out - exportBuffer;
+}
+
+// Money values are written with exactly two decimals, like setprecision(2)
+void exportMoney(ExportWriter* writer, double value) {
+    long long cents = llround(value * 100.0);
+    if (cents < 0) {
+        exportChar(writer, '-');
+        cents = -cents;
+    }
+    exportInt(writer, cents / 100);
+    exportReserve(writer, 3);
+    exportBuffer[writer->used++] = '.';
+    exportBuffer[writer->used++] = (char)('0' + (cents % 100) / 10);
+    exportBuffer[writer->used++] = (char)('0' + cents % 10);
+}
+
+// CSV field, quoted only when it contains a separator, quote or newline
+void exportCsvField(ExportWriter* writer, const string& text) {
+    if (text.find_first_of(",\"\r\n") == string::npos) {
+        exportRaw(writer, text.data(), text.size());
+        return;
+    }
+    exportChar(writer, '"');
+    for (size_t i = 0; i < text.size(); i++) {
+        if (text[i] == '"') {
+            exportChar(writer, '"');
+        }
+        exportChar(writer, text[i]);
+    }
+    exportChar(writer, '"');
+}
+
+// JSON string literal with the mandatory escapes
+void exportJsonString(ExportWriter* writer, const string& text) {
+    static const char HEX[] = "0123456789abcdef";
+    exportChar(writer, '"');
+    for (size_t i = 0; i < text.size(); i++) {
+        unsigned char c = text[i];
+        if (c == '"' || c == '\\') {
+            exportChar(writer, '\\');
+            exportChar(writer, c);
+        } else if (c < 0x20) {
+            char escape[6] = {'\\', 'u', '0', '0', HEX[c >> 4], HEX[c & 0xF]};
+            exportRaw(writer, escape, 6);
+        } else {
+            exportChar(writer, c);
+        }
+    }
+    exportChar(writer, '"');
+}
+
+void exportLiteral(ExportWriter* writer, const char* text) {
+    exportRaw(writer, text, strlen(text));
+}
+
+// Write every active product; rowsWritten is returned by address
+bool exportProducts(const char* path, bool json, int* rowsWritten) {
+    ExportWriter writer;
+    *rowsWritten = 0;
+    if (!exportOpen(&writer, path)) {
+        return false;
+    }
+
+    if (!json) {
+        exportLiteral(&writer, "id,name,category,quantity,price\n");
+    }
+
+    shared_ptr<const InventorySnapshot> snapshot = acquireSnapshot();
+    for (int i = 0; i < snapshot->productCount; i++) {
+        const Product* product = snapshotProduct(snapshot.get(), i);
+        if (!product->active) {
+            continue;
+        }
+
+        if (json) {
+            exportLiteral(&writer, "{\"id\":");
+            exportInt(&writer, product->id);
+            exportLiteral(&writer, ",\"name\":");
+            exportJsonString(&writer, product->name);
+            exportLiteral(&writer, ",\"category\":");
+            exportJsonString(&writer, product->category);
+            exportLiteral(&writer, ",\"quantity\":");
+            exportInt(&writer, product->quantity);
+            exportLiteral(&writer, ",\"price\":");
+            exportMoney(&writer, product->price);
+            exportLiteral(&writer, "}\n");
+        } else {
+            exportInt(&writer, product->id);
+            exportChar(&writer, ',');
+            exportCsvField(&writer, product->name);
+            exportChar(&writer, ',');
+            exportCsvField(&writer, product->category);
+            exportChar(&writer, ',');
+            exportInt(&writer, product->quantity);
+            exportChar(&writer, ',');
+            exportMoney(&writer, product->price);
+            exportChar(&writer, '\n');
+        }
+        (*rowsWritten)++;
+    }
+
+    return exportClose(&writer);
+}
+
+// Write the transactions whose ID is above *watermark and advance the
+// watermark to the last one written. Pass a watermark of 0 for a full export.
+bool exportTransactions(const char* path, bool json, int* watermark, int* rowsWritten) {
+    ExportWriter writer;
+    *rowsWritten = 0;
+    if (!exportOpen(&writer, path)) {
+        return false;
+    }
+
+    if (!json) {
+        exportLiteral(&writer, "transaction_id,product_id,product_name,quantity,"
+                               "unit_price,discount,total,date,time\n");
+    }
+
+    // Transaction IDs only grow, so binary search for the first new one
+    int visibleCount = acquireSnapshot()->transactionCount;
+    int low = 0;
+    int high = visibleCount;
+    while (low < high) {
+        int mid = (low + high) / 2;
+        if (transactions[mid].transactionId <= *watermark) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+
+    for (int i = low; i < visibleCount; i++) {
+        const Transaction* trans = &transactions[i];
+
+        if (json) {
+            exportLiteral(&writer, "{\"transaction_id\":");
+            exportInt(&writer, trans->transactionId);
+            exportLiteral(&writer, ",\"product_id\":");
+            exportInt(&writer, trans->productId);
+            exportLiteral(&writer, ",\"product_name\":");
+            exportJsonString(&writer, trans->productName);
+            exportLiteral(&writer, ",\"quantity\":");
+            exportInt(&writer, trans->quantity);
+            exportLiteral(&writer, ",\"unit_price\":");
+            exportMoney(&writer, trans->unitPrice);
+            exportLiteral(&writer, ",\"discount\":");
+            exportMoney(&writer, trans->discount);
+            exportLiteral(&writer, ",\"total\":");
+            exportMoney(&writer, trans->totalPrice);
+            exportLiteral(&writer, ",\"date\":");
+            exportJsonString(&writer, trans->date);
+            exportLiteral(&writer, ",\"time\":");
+            exportJsonString(&writer, trans->time);
+            exportLiteral(&writer, "}\n");
+        } else {
+            exportInt(&writer, trans->transactionId);
+            exportChar(&writer, ',');
+            exportInt(&writer, trans->productId);
+            exportChar(&writer, ',');
+            exportCsvField(&writer, trans->productName);
+            exportChar(&writer, ',');
+            exportInt(&writer, trans->quantity);
+            exportChar(&writer, ',');
+            exportMoney(&writer, trans->unitPrice);
+            exportChar(&writer, ',');
+            exportMoney(&writer, trans->discount);
+            exportChar(&writer, ',');
+            exportMoney(&writer, trans->totalPrice);
+            exportChar(&writer, ',');
+            exportCsvField(&writer, trans->date);
+            exportChar(&writer, ',');
+            exportCsvField(&writer, trans->time);
+            exportChar(&writer, '\n');
+        }
+        (*rowsWritten)++;
+    }
+
+    if (!exportClose(&writer)) {
+        return false;
+    }
+
+    if (low < visibleCount) {
+        *watermark = transactions[visibleCount - 1].transactionId;
+    }
+    return true;
+}
+
+// The incremental watermark is kept next to the export, in PATH.watermark,
+// as "<last transaction ID> <time of the history's first transaction>".
+// Transaction IDs start over with the history when the program restarts,
+// so a watermark saved for another history is ignored and every
+// transaction in memory counts as new.
+int loadExportWatermark(const string& path) {
+    FILE* in = fopen((path + ".watermark").c_str(), "r");
+    if (in == NULL) {
+        return 0;
+    }
+    int watermark = 0;
+    long long historyStart = 0;
+    if (fscanf(in, "%d %lld", &watermark, &historyStart) != 2) {
+        watermark = 0;
+    }
+    fclose(in);
+
+    shared_ptr<const InventorySnapshot> snapshot = acquireSnapshot();
+    if (snapshot->transactionCount == 0 || transactions[0].timestamp != historyStart) {
+        return 0;
+    }
+    return watermark;
+}
+
+bool saveExportWatermark(const string& path, int watermark) {
+    if (acquireSnapshot()->transactionCount == 0) {
+        return true; // nothing exported yet, nothing to remember
+    }
+    string temporary = path + ".watermark.tmp";
+    FILE* out = fopen(temporary.c_str(), "w");
+    if (out == NULL) {
+        return false;
+    }
+    bool ok = fprintf(out, "%d %lld\n", watermark, (long long)transactions[0].timestamp) > 0;
+    if (fclose(out) != 0 || !ok || rename(temporary.c_str(), (path + ".watermark").c_str()) != 0) {
+        remove(temporary.c_str());
+        return false;
+    }
+    return true;
+}
+
+void exportData() {
+    clearScreen();
+    printTableHeader("EXPORT DATA");
+
+    cout << "  1. Products (CSV)\n";
+    cout << "  2. Products (NDJSON)\n";
+    cout << "  3. New transactions since last export (CSV)\n";
+    cout << "  4. New transactions since last export (NDJSON)\n";
+    cout << "  5. All transactions (CSV)\n";
+    cout << "  6. All transactions (NDJSON)\n";
+    cout << "Enter your choice: ";
+
+    int choice;
+    if (!(cin >> choice) || choice < 1 || choice > 6) {
+        clearInputBuffer();
+        printError("Invalid choice!");
+        return;
+    }
+
+    string path;
+    clearInputBuffer();
+    cout << "Enter output file name: ";
+    getline(cin, path);
+
+    if (path.empty()) {
+        printError("File name cannot be empty!");
+        return;
+    }
+
+    bool json = (choice % 2 == 0);
+    int rows = 0;
+    int watermark = 0;
+    bool ok;
+
+    if (choice <= 2) {
+        ok = exportProducts(path.c_str(), json, &rows);
+    } else if (choice <= 4) {
+        watermark = loadExportWatermark(path);
+        ok = exportTransactions(path.c_str(), json, &watermark, &rows);
+        if (ok && !saveExportWatermark(path, watermark)) {
+            printError("Could not save the watermark to " + path + ".watermark");
+            return;
+        }
+    } else {
+        ok = exportTransactions(path.c_str(), json, &watermark, &rows);
+    }
+
+    if (!ok) {
+        printError("Could not write to " + path);
+        return;
+    }
+
+    printSuccess("Export complete!");
+    cout << "Rows written: " << rows << "\n";
+    if (choice == 3 || choice == 4) {
+        cout << "Watermark now at transaction #" << watermark << " (saved in " << path << ".watermark)\n";
+    }
+}
+
+// ============================================================
+// BULK IMPORT (CSV)
+// ============================================================
+// The file is memory-mapped and cut into chunks at line boundaries. Each
+// chunk is parsed on its own thread, then all rows are validated in one
+// pass against hashed ID and category sets and published together.
+const size_t IMPORT_MIN_CHUNK_BYTES = 1 << 20; // below this, one thread is enough
+const int IMPORT_MAX_ERRORS_SHOWN = 20;
+
+struct ImportError {
+    int line;
+    string message;
+};
+
+struct ImportRow {
+    int line;
+    Product product;
+};
+
+struct ImportChunk {
+    const char* begin;
+    const char* end;
+    int lineCount;               // lines seen, used to number later chunks
+    vector<ImportRow> rows;      // line numbers relative to the chunk
+    vector<ImportError> errors;
+};
+
+struct MappedFile {
+    const char* data;
+    size_t size;
+#ifdef _WIN32
+    char* heapCopy;
+#else
+    int fd;
+#endif
+};
+
+bool mapInputFile(const char* path, MappedFile* file) {
+    file->data = NULL;
+    file->size = 0;
+#ifdef _WIN32
+    // No mmap here: read the whole file into one heap block instead
+    file->heapCopy = NULL;
+    FILE* in = fopen(path, "rb");
+    if (in == NULL) {
+        return false;
+    }
+    fseek(in, 0, SEEK_END);
+    long length = ftell(in);
+    fseek(in, 0, SEEK_SET);
+    if (length > 0) {
+        file->heapCopy = (char*)malloc(length);
+        if (file->heapCopy == NULL || fread(file->heapCopy, 1, length, in) != (size_t)length) {
+            free(file->heapCopy);
+            fclose(in);
+            return false;
+        }
+    }
+    fclose(in);
+    file->data = file->heapCopy;
+    file->size = length > 0 ? length : 0;
+    return true;
+#else
+    file->fd = open(path, O_RDONLY);
+    if (file->fd < 0) {
+        return false;
+    }
+    struct stat info;
+    if (fstat(file->fd, &info) != 0) {
+        close(file->fd);
+        return false;
+    }
+    file->size = info.st_size;
+    if (file->size > 0) {
+        void* mapped = mmap(NULL, file->size, PROT_READ, MAP_PRIVATE, file->fd, 0);
+        if (mapped == MAP_FAILED) {
+            close(file->fd);
+            return false;
+        }
+        madvise(mapped, file->size, MADV_SEQUENTIAL);
+        file->data = (const char*)mapped;
+    }
+    return true;
+#endif
+}
+
+void unmapInputFile(MappedFile* file) {
+#ifdef _WIN32
+    free(file->heapCopy);
+#else
+    if (file->data != NULL) {
+        munmap((void*)file->data, file->size);
+    }
+    close(file->fd);
+#endif
+    file->data = NULL;
+}
+
+// Read one CSV field starting at *cursor and move past its separator.
+// Quoted fields may contain commas and doubled quotes.
+void readCsvField(const char** cursor, const char* lineEnd, string* field) {
+    const char* p = *cursor;
+    field->clear();
+
+    if (p < lineEnd && *p == '"') {
+        p++;
+        while (p < lineEnd) {
+            if (*p == '"') {
+                if (p + 1 < lineEnd && p[1] == '"') {
+                    field->push_back('"');
+                    p += 2;
+                    continue;
+                }
+                p++;
+                break;
+            }
+            field->push_back(*p++);
+        }
+        while (p < lineEnd && *p != ',') {
+            p++;
+        }
+    } else {
+        const char* start = p;
+        while (p < lineEnd && *p != ',') {
+            p++;
+        }
+        field->assign(start, p - start);
+    }
+
+    if (p < lineEnd) {
+        p++; // skip the comma
+    }
+    *cursor = p;
+}
+
+// Whole-string integer parse; rejects signs other than '-' and trailing text
+bool parseIntField(const string& text, int* value) {
+    size_t i = 0;
+    bool negative = false;
+    if (i < text.size() && text[i] == '-') {
+        negative = true;
+        i++;
+    }
+    if (i == text.size()) {
+        return false;
+    }
+
+    long long result = 0;
+    for (; i < text.size(); i++) {
+        if (text[i] < '0' || text[i] > '9') {
+            return false;
+        }
+        result = result * 10 + (text[i] - '0');
+        if (result > numeric_limits<int>::max()) {
+            return false;
+        }
+    }
+    *value = (int)(negative ? -result : result);
+    return true;
+}
+
+// Plain decimal such as 12, 12.5 or 899.99 (no exponent)
+bool parsePriceField(const string& text, double* value) {
+    size_t i = 0;
+    bool negative = false;
+    if (i < text.size() && text[i] == '-') {
+        negative = true;
+        i++;
+    }
+
+    double whole = 0.0;
+    double fraction = 0.0;
+    double scale = 1.0;
+    bool digits = false;
+
+    for (; i < text.size() && text[i] >= '0' && text[i] <= '9'; i++) {
+        whole = whole * 10.0 + (text[i] - '0');
+        digits = true;
+    }
+    if (i < text.size() && text[i] == '.') {
+        for (i++; i < text.size() && text[i] >= '0' && text[i] <= '9'; i++) {
+            fraction = fraction * 10.0 + (text[i] - '0');
+            scale *= 10.0;
+            digits = true;
+        }
+    }
+    if (!digits || i != text.size()) {
+        return false;
+    }
+
+    *value = (whole + fraction / scale) * (negative ? -1.0 : 1.0);
+    return true;
+}
+
+// Parse one chunk into rows; runs on a worker thread and touches no globals
+void parseImportChunk(ImportChunk* chunk) {
+    string idText, quantityText, priceText;
+    const char* p = chunk->begin;
+    int line = 0;
+
+    while (p < chunk->end) {
+        const char* lineEnd = (const char*)memchr(p, '\n', chunk->end - p);
+        if (lineEnd == NULL) {
+            lineEnd = chunk->end;
+        }
+        const char* next = lineEnd < chunk->end ? lineEnd + 1 : lineEnd;
+        if (lineEnd > p && lineEnd[-1] == '\r') {
+            lineEnd--;
+        }
+        line++;
+
+        if (lineEnd == p) {
+            p = next; // blank line
+            continue;
+        }
+
+        ImportRow row;
+        row.line = line;
+        const char* cursor = p;
+        readCsvField(&cursor, lineEnd, &idText);
+        readCsvField(&cursor, lineEnd, &row.product.name);
+        readCsvField(&cursor, lineEnd, &row.product.category);
+        readCsvField(&cursor, lineEnd, &quantityText);
+        readCsvField(&cursor, lineEnd, &priceText);
+
+        ImportError error;
+        error.line = line;
+        if (priceText.empty()) {
+            error.message = "Expected id,name,category,quantity,price";
+        } else if (!parseIntField(idText, &row.product.id)) {
+            error.message = "Invalid ID '" + idText + "'";
+        } else if (!parseIntField(quantityText, &row.product.quantity)) {
+            error.message = "Invalid quantity '" + quantityText + "'";
+        } else if (!parsePriceField(priceText, &row.product.price)) {
+            error.message = "Invalid price '" + priceText + "'";
+        }
+
+        if (error.message.empty()) {
+            row.product.active = true;
+            chunk->rows.push_back(row);
+        } else {
+            chunk->errors.push_back(error);
+        }
+        p = next;
+    }
+    chunk->lineCount = line;
+}
+
+// Import products from a CSV file (id,name,category,quantity,price).
+// A header line is skipped. Valid rows are added together at the end;
+// invalid rows are reported by line number and do not stop the import.
+bool importProductsCsv(const char* path, int* imported, vector<ImportError>* errors) {
+    *imported = 0;
+    errors->clear();
+
+    MappedFile file;
+    if (!mapInputFile(path, &file)) {
+        return false;
+    }
+
+    const char* begin = file.data;
+    const char* end = file.data + file.size;
+    int headerLines = 0;
+    if (file.size >= 3 && (begin[0] == 'i' || begin[0] == 'I') && (begin[1] == 'd' || begin[1] == 'D')) {
+        const char* headerEnd = (const char*)memchr(begin, '\n', file.size);
+        begin = headerEnd != NULL ? headerEnd + 1 : end;
+        headerLines = 1;
+    }
+
+    // Cut the input into roughly equal chunks that end on a newline
+    size_t total = end - begin;
+    int threadCount = (int)thread::hardware_concurrency();
+    if (threadCount < 1) {
+        threadCount = 1;
+    }
+    int chunkCount = (int)min((size_t)threadCount, total / IMPORT_MIN_CHUNK_BYTES + 1);
+
+    vector<ImportChunk> chunks(chunkCount);
+    const char* chunkStart = begin;
+    for (int c = 0; c < chunkCount; c++) {
+        const char* chunkEnd = (c == chunkCount - 1) ? end : begin + total * (c + 1) / chunkCount;
+        if (chunkEnd < chunkStart) {
+            chunkEnd = chunkStart;
+        }
+        if (chunkEnd < end) {
+            const char* newline = (const char*)memchr(chunkEnd, '\n', end - chunkEnd);
+            chunkEnd = newline != NULL ? newline + 1 : end;
+        }
+        chunks[c].begin = chunkStart;
+        chunks[c].end = chunkEnd;
+        chunks[c].lineCount = 0;
+        chunkStart = chunkEnd;
+    }
+
+    vector<thread> workers;
+    for (int c = 1; c < chunkCount; c++) {
+        workers.push_back(thread(parseImportChunk, &chunks[c]));
+    }
+    parseImportChunk(&chunks[0]);
+    for (size_t w = 0; w < workers.size(); w++) {
+        workers[w].join();
+    }
+    unmapInputFile(&file);
+
+    // Validate every row against hashed sets instead of per-row scans
+    lock_guard<mutex> lock(inventoryWriteMutex);
+    unordered_set<int> knownIds;
+    knownIds.reserve(productCount * 2 + 16);
+    for (int i = 0; i < productCount; i++) {
+        if (products[i].active) {
+            knownIds.insert(products[i].id);
+        }
+    }
+    unordered_set<string> knownCategories;
+    for (int i = 0; i < categoryCount; i++) {
+        if (categories[i].active) {
+            knownCategories.insert(categories[i].name);
+        }
+    }
+
+    vector<const Product*> accepted;
+    int lineOffset = headerLines;
+
+    for (int c = 0; c < chunkCount; c++) {
+        ImportChunk* chunk = &chunks[c];
+        size_t nextError = 0;
+
+        for (size_t r = 0; r <= chunk->rows.size(); r++) {
+            int rowLine = r < chunk->rows.size() ? chunk->rows[r].line : numeric_limits<int>::max();
+
+            // Keep the error list in file order by merging parse errors in
+            while (nextError < chunk->errors.size() && chunk->errors[nextError].line < rowLine) {
+                ImportError error = chunk->errors[nextError++];
+                error.line += lineOffset;
+                errors->push_back(error);
+            }
+            if (r == chunk->rows.size()) {
+                break;
+            }
+
+            const Product* product = &chunk->rows[r].product;
+            ImportError error;
+            error.line = rowLine + lineOffset;
+
+            if (!isValidId(product->id)) {
+                error.message = "Invalid ID! Must be positive.";
+            } else if (product->name.empty()) {
+                error.message = "Product name cannot be empty!";
+            } else if (!isValidQuantity(product->quantity)) {
+                error.message = "Invalid quantity! Must be non-negative.";
+            } else if (!isValidPrice(product->price)) {
+                error.message = "Invalid price! Must be non-negative.";
+            } else if (knownCategories.count(product->category) == 0) {
+                error.message = "Category '" + product->category + "' does not exist!";
+            } else if (!knownIds.insert(product->id).second) {
+                error.message = "Product ID already exists!";
+            } else if (productCount + (int)accepted.size() >= MAX_ITEMS) {
+                error.message = "Product limit reached!";
+            }
+
+            if (error.message.empty()) {
+                accepted.push_back(product);
+            } else {
+                errors->push_back(error);
+            }
+        }
+        lineOffset += chunk->lineCount;
+    }
+
+    // Publish: fill the slots past the end first, then move productCount
+    for (size_t i = 0; i < accepted.size(); i++) {
+        products[productCount + i] = *accepted[i];
+        initProductStock(productCount + i, accepted[i]->quantity);
+        resetDemandForecast(productCount + i);
+    }
+    productCount += accepted.size();
+    for (int i = productCount - accepted.size(); i < productCount; i++) {
+        adjustLocationTotals(i, 1);
+    }
+    publishProductChanges(productCount - accepted.size(), productCount - 1);
+    *imported = accepted.size();
+    return true;
+}
+
+void importProducts() {
+    clearScreen();
+    printTableHeader("BULK IMPORT PRODUCTS");
+
+    cout << "Expected columns: id,name,category,quantity,price\n";
+
+    string path;
+    clearInputBuffer();
+    cout << "Enter CSV file name: ";
+    getline(cin, path);
+
+    if (path.empty()) {
+        printError("File name cannot be empty!");
+        return;
+    }
+
+    int imported = 0;
+    vector<ImportError> errors;
+    if (!importProductsCsv(path.c_str(), &imported, &errors)) {
+        printError("Could not open " + path);
+        return;
+    }
+
+    printSuccess("Import finished!");
+    cout << "Products imported: " << imported << "\n";
+    cout << "Rows rejected:     " << errors.size() << "\n";
+
+    if (!errors.empty()) {
+        cout << "----------------------------------------------------------------\n";
+        cout << left << setw(8) << "Line" << "Error\n";
+        cout << "----------------------------------------------------------------\n";
+        for (size_t i = 0; i < errors.size() && i < (size_t)IMPORT_MAX_ERRORS_SHOWN; i++) {
+            cout << left << setw(8) << errors[i].line << errors[i].message << "\n";
+        }
+        if (errors.size() > (size_t)IMPORT_MAX_ERRORS_SHOWN) {
+            cout << "... and " << (errors.size() - IMPORT_MAX_ERRORS_SHOWN) << " more\n";
+        }
+        cout << "----------------------------------------------------------------\n";
+    }
+}
+
+// ============================================================
+// NUMA PLACEMENT
+// ============================================================
+// On multi-socket machines memory is attached to one node (socket) and is
+// slower to reach from the others. Three placements are offered:
+//   NUMA_FIRST_TOUCH - the default: each page lives where it was first written
+//   NUMA_INTERLEAVE  - the big arrays are spread page by page over all nodes
+//   NUMA_PARTITIONED - sharded mode puts shard s on node s % nodes: the
+//                      worker is pinned to that node's CPUs and prefers its
+//                      memory. After fork the worker shares the router's
+//                      pages copy-on-write, which mbind cannot move, so the
+//                      worker writes to each page of its partition to get
+//                      private copies on its node (localizeShardPartition)
+// The topology is read from /sys and the kernel is asked directly (no
+// libnuma). On a single node, or outside Linux, every call is a no-op.
+// "--numa first-touch|interleave|partitioned" picks the mode at startup.
+enum NumaMode { NUMA_FIRST_TOUCH, NUMA_INTERLEAVE, NUMA_PARTITIONED };
+
+const int MAX_NUMA_NODES = 64;
+
+NumaMode numaMode = NUMA_FIRST_TOUCH;
+int numaNodeCount = 1;
+int numaNodeIds[MAX_NUMA_NODES];            // kernel node number (may have gaps)
+vector<int> numaNodeCpus[MAX_NUMA_NODES];
+
+#ifdef __linux__
+// Memory policy values from <linux/mempolicy.h>
+const int NUMA_POLICY_DEFAULT = 0;
+const int NUMA_POLICY_PREFERRED = 1;
+const int NUMA_POLICY_INTERLEAVE = 3;
+const unsigned NUMA_MOVE_PAGES = 1 << 1;  // MPOL_MF_MOVE
+
+// Parse a CPU list such as "0-3,8-11"
+void parseCpuList(const char* text, vector<int>* cpus) {
+    const char* p = text;
+    while (*p >= '0' && *p <= '9') {
+        int first = 0, last;
+        while (*p >= '0' && *p <= '9') {
+            first = first * 10 + (*p++ - '0');
+        }
+        last = first;
+        if (*p == '-') {
+            p++;
+            last = 0;
+            while (*p >= '0' && *p <= '9') {
+                last = last * 10 + (*p++ - '0');
+            }
+        }
+        for (int cpu = first; cpu <= last; cpu++) {
+            cpus->push_back(cpu);
+        }
+        if (*p == ',') {
+            p++;
+        }
+    }
+}
+
+// Apply a memory policy to the whole pages inside [start, start + bytes)
+bool bindMemory(void* start, size_t bytes, int policy, const unsigned long* nodeMask) {
+    long pageSize = sysconf(_SC_PAGESIZE);
+    uintptr_t first = ((uintptr_t)start + pageSize - 1) & ~(uintptr_t)(pageSize - 1);
+    uintptr_t last = ((uintptr_t)start + bytes) & ~(uintptr_t)(pageSize - 1);
+    if (last <= first) {
+        return true;
+    }
+    return syscall(SYS_mbind, (void*)first, last - first, policy, nodeMask,
+                   (unsigned long)MAX_NUMA_NODES + 1, NUMA_MOVE_PAGES) == 0;
+}
+
+// Apply a policy to every large per-product and per-transaction array.
+// Returns false (with errno from the failed call) if any of them failed.
+bool bindInventoryArrays(int policy, const unsigned long* nodeMask) {
+    bool ok = bindMemory(products, sizeof(products), policy, nodeMask);
+    ok = bindMemory(transactions, sizeof(transactions), policy, nodeMask) && ok;
+    ok = bindMemory(locationStock, sizeof(locationStock), policy, nodeMask) && ok;
+    ok = bindMemory(reservedStock, sizeof(reservedStock), policy, nodeMask) && ok;
+    return ok;
+}
+
+void reportNumaFailure(const char* what) {
+    fprintf(stderr, "NUMA placement: %s failed: %s\n", what, strerror(errno));
+}
+
+// Write one byte per page in [start, start + bytes) back to itself, so a
+// page still shared with the parent is copied under the current policy
+void touchPages(void* start, size_t bytes) {
+    long pageSize = sysconf(_SC_PAGESIZE);
+    volatile char* first = (volatile char*)start;
+    for (size_t offset = 0; offset < bytes; offset += pageSize) {
+        first[offset] = first[offset];
+    }
+    if (bytes > 0) {
+        first[bytes - 1] = first[bytes - 1];
+    }
+}
+#endif
+
+// Mode named on the command line; false for an unknown name
+bool parseNumaMode(const string& name, NumaMode* mode) {
+    if (name == "first-touch") {
+        *mode = NUMA_FIRST_TOUCH;
+    } else if (name == "interleave") {
+        *mode = NUMA_INTERLEAVE;
+    } else if (name == "partitioned") {
+        *mode = NUMA_PARTITIONED;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+// Read the node layout once; returns the number of nodes with CPUs
+int detectNumaTopology() {
+    numaNodeCount = 1;
+#ifdef __linux__
+    int found = 0;
+    for (int node = 0; node < MAX_NUMA_NODES; node++) {
+        char path[64];
+        snprintf(path, sizeof(path), "/sys/devices/system/node/node%d/cpulist", node);
+        FILE* file = fopen(path, "r");
+        if (file == NULL) {
+            continue;
+        }
+        char text[1024] = "";
+        if (fgets(text, sizeof(text), file) != NULL) {
+            numaNodeCpus[found].clear();
+            parseCpuList(text, &numaNodeCpus[found]);
+            if (!numaNodeCpus[found].empty()) {
+                numaNodeIds[found++] = node;
+            }
+        }
+        fclose(file);
+    }
+    numaNodeCount = max(1, found);
+#endif
+    return numaNodeCount;
+}
+
+// Choose the placement. Interleaving is applied to this process right
+// away; partitioning takes effect when shards are started. Returns false
+// (and says why on stderr) if the kernel refused the memory policy.
+bool setNumaMode(NumaMode mode) {
+    numaMode = mode;
+    if (detectNumaTopology() <= 1) {
+        return true;
+    }
+#ifdef __linux__
+    unsigned long allNodes[MAX_NUMA_NODES / 64 + 1] = {0};
+    for (int n = 0; n < numaNodeCount; n++) {
+        allNodes[numaNodeIds[n] / 64] |= 1UL << (numaNodeIds[n] % 64);
+    }
+    bool ok;
+    if (mode == NUMA_INTERLEAVE) {
+        ok = bindInventoryArrays(NUMA_POLICY_INTERLEAVE, allNodes);
+    } else {
+        ok = bindInventoryArrays(NUMA_POLICY_DEFAULT, NULL); // back to first touch
+    }
+    if (!ok) {
+        reportNumaFailure("mbind");
+    }
+    return ok;
+#else
+    return true;
+#endif
+}
+
+// Called in a shard worker before it touches its partition: run on the
+// shard's node and keep its arrays in that node's memory. A failure is
+// reported on stderr and the shard carries on unplaced.
+bool placeShardOnNode(int shard) {
+    if (numaMode != NUMA_PARTITIONED || numaNodeCount <= 1) {
+        return true;
+    }
+#ifdef __linux__
+    int n = shard % numaNodeCount;
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    for (size_t c = 0; c < numaNodeCpus[n].size(); c++) {
+        CPU_SET(numaNodeCpus[n][c], &cpus);
+    }
+    bool ok = true;
+    if (sched_setaffinity(0, sizeof(cpus), &cpus) != 0) {
+        reportNumaFailure("sched_setaffinity");
+        ok = false;
+    }
+
+    unsigned long nodeMask[MAX_NUMA_NODES / 64 + 1] = {0};
+    nodeMask[numaNodeIds[n] / 64] |= 1UL << (numaNodeIds[n] % 64);
+    if (!bindInventoryArrays(NUMA_POLICY_PREFERRED, nodeMask)) {
+        reportNumaFailure("mbind");
+        ok = false;
+    }
+    return ok;
+#else
+    return true;
+#endif
+}
+
+// Called in a shard worker once its partition is compacted: copy the pages
+// it still shares with the router into the memory placeShardOnNode chose.
+// Transactions are not touched; the worker starts its history afresh.
+void localizeShardPartition() {
+    if (numaMode != NUMA_PARTITIONED || numaNodeCount <= 1) {
+        return;
+    }
+#ifdef __linux__
+    touchPages(products, productCount * sizeof(Product));
+    touchPages(locationStock, productCount * sizeof(locationStock[0]));
+    touchPages(reservedStock, productCount * sizeof(reservedStock[0]));
+#endif
+}
+
+// ============================================================
+// SHARDED MODE (WORKER PROCESSES)
+// ============================================================
+// Products are partitioned by a hash of their ID across worker processes
+// forked from the current inventory. Each worker keeps only its own
+// products and answers fixed-size requests over a pair of pipes; the
+// router sends a whole window of requests to every shard before reading
+// the replies, so the shards work in parallel. Transaction IDs are local
+// to each shard. Not available on Windows (no fork).
+//
+// "--shards N" on the command line runs the program this way: the workers
+// are forked before any thread starts, the router drops its own copy of
+// the products and a small menu offers lookups, purchases and the report.
+// The benchmark calls startShards directly and keeps its copy for the
+// other measurements. Router calls are serialized by shardRouterMutex.
+#ifndef _WIN32
+const int MAX_SHARDS = 16;
+const int SHARD_PIPELINE_DEPTH = 256; // in-flight requests per shard
+const int SHARD_NAME_LENGTH = 32;
+
+enum ShardRequestType {
+    SHARD_LOOKUP = 1,
+    SHARD_PURCHASE = 2,
+    SHARD_STATISTICS = 3
+};
+
+struct ShardRequest {
+    int type;
+    int productId;
+    int quantity;
+};
+
+struct ShardReply {
+    int status;              // 1 = done, 0 = not found or insufficient stock
+    int productId;
+    int quantity;            // stock left after a lookup or purchase
+    double price;
+    char name[SHARD_NAME_LENGTH];
+    int transactionId;       // 0 when the shard's history was full
+    double total;            // amount charged for a purchase
+    int totalProducts;       // statistics partials
+    int lowStock;
+    int outOfStock;
+    double totalValue;
+};
+
+struct ShardWorker {
+    pid_t pid;
+    int requestFd;  // router writes requests here
+    int replyFd;    // router reads replies here
+};
+
+ShardWorker shardWorkers[MAX_SHARDS];
+int shardCount = 0;
+mutex shardRouterMutex;     // one batch on the pipes at a time
+
+bool writeFully(int fd, const void* data, size_t length) {
+    const char* p = (const char*)data;
+    while (length > 0) {
+        ssize_t written = write(fd, p, length);
+        if (written <= 0) {
+            return false;
+        }
+        p += written;
+        length -= written;
+    }
+    return true;
+}
+
+bool readFully(int fd, void* data, size_t length) {
+    char* p = (char*)data;
+    while (length > 0) {
+        ssize_t got = read(fd, p, length);
+        if (got <= 0) {
+            return false;
+        }
+        p += got;
+        length -= got;
+    }
+    return true;
+}
+
+int shardForProduct(int productId) {
+    unsigned int hash = (unsigned int)productId * 2654435761u; // Knuth multiplicative hash
+    return (int)((hash >> 16) % shardCount);
+}
+
+// Keep only this shard's products (and their location rows and holds)
+void keepShardPartition(int shard) {
+    lock_guard<mutex> lock(inventoryWriteMutex);
+    vector<int> newIndex(productCount, -1);
+    int kept = 0;
+    for (int i = 0; i < productCount; i++) {
+        if (shardForProduct(products[i].id) == shard) {
+            if (kept != i) {
+                products[kept] = products[i];
+                memcpy(locationStock[kept], locationStock[i], sizeof(locationStock[i]));
+                reservedStock[kept] = reservedStock[i];
+            }
+            newIndex[i] = kept++;
+        }
+    }
+    for (int i = kept; i < productCount; i++) {
+        reservedStock[i] = 0;
+    }
+    productCount = kept;
+    transactionCount = 0;
+
+    // Holds follow their product; those for other shards' products go
+    for (int r = 0; r < reservationPoolUsed; r++) {
+        if (reservations[r].level == -1) {
+            continue;
+        }
+        int index = newIndex[reservations[r].productIndex];
+        if (index == -1) {
+            wheelUnlink(r);
+            releaseReservationSlot(r);
+        } else {
+            reservations[r].productIndex = index;
+        }
+    }
+
+    rebuildDemandForecasts(time(0));
+    recomputeLocationTotals();
+    resetProductHistory(); // slots were renumbered
+    renumberSourcingProducts(&newIndex);
+    rebuildSnapshot();
+}
+
+void handleShardRequest(const ShardRequest* request, ShardReply* reply) {
+    memset(reply, 0, sizeof(ShardReply));
+    reply->productId = request->productId;
+
+    if (request->type == SHARD_STATISTICS) {
+        getProductStatistics(&reply->totalProducts, &reply->lowStock,
+                             &reply->outOfStock, &reply->totalValue);
+        reply->status = 1;
+        return;
+    }
+
+    int index = findProductById(request->productId);
+    if (index == -1) {
+        return;
+    }
+
+    if (request->type == SHARD_PURCHASE) {
+        double unitPrice, subtotal, discount, total;
+        const Transaction* recorded;
+        if (!commitPurchase(index, request->quantity, &unitPrice, &subtotal, &discount, &total,
+                            NULL, &recorded)) {
+            reply->quantity = products[index].quantity;
+            return;
+        }
+        reply->transactionId = recorded != NULL ? recorded->transactionId : 0;
+        reply->total = total;
+    }
+
+    reply->status = 1;
+    reply->quantity = products[index].quantity;
+    reply->price = products[index].price;
+    strncpy(reply->name, products[index].name.c_str(), SHARD_NAME_LENGTH - 1);
+}
+
+// Worker main loop: serve requests in arrival order until the pipe closes
+void runShardWorker(int shard, int requestFd, int replyFd) {
+    placeShardOnNode(shard);
+    keepShardPartition(shard);
+    localizeShardPartition();
+
+    ShardRequest requests[SHARD_PIPELINE_DEPTH];
+    ShardReply replies[SHARD_PIPELINE_DEPTH];
+
+    while (true) {
+        // Take whatever whole requests are waiting, at least one
+        ssize_t got = read(requestFd, requests, sizeof(requests));
+        if (got <= 0) {
+            break;
+        }
+        size_t partial = got % sizeof(ShardRequest);
+        if (partial != 0 &&
+            !readFully(requestFd, (char*)requests + got, sizeof(ShardRequest) - partial)) {
+            break;
+        }
+        int count = (got + sizeof(ShardRequest) - 1) / sizeof(ShardRequest);
+
+        for (int r = 0; r < count; r++) {
+            handleShardRequest(&requests[r], &replies[r]);
+        }
+        if (!writeFully(replyFd, replies, count * sizeof(ShardReply))) {
+            break;
+        }
+    }
+    _exit(0);
+}
+
+// The caller must hold shardRouterMutex
+void closeShards() {
+    for (int s = 0; s < shardCount; s++) {
+        close(shardWorkers[s].requestFd);
+        close(shardWorkers[s].replyFd);
+        waitpid(shardWorkers[s].pid, NULL, 0);
+    }
+    shardCount = 0;
+}
+
+void stopShards() {
+    lock_guard<mutex> lock(shardRouterMutex);
+    closeShards();
+}
+
+// Fork `count` workers from the current inventory. The router process
+// keeps its own copy but should send all lookups and sales to the shards.
+// A forked child only gets the calling thread, so a lock held by another
+// thread at that moment would stay locked in the worker for good: this
+// refuses to run while the invoice renderer or a replica is running.
+bool startShards(int count) {
+    lock_guard<mutex> lock(shardRouterMutex);
+    if (count < 1 || count > MAX_SHARDS || shardCount != 0 ||
+        invoiceRendererRunning || replicasAttached()) {
+        return false;
+    }
+
+    cout.flush();
+    shardCount = count;
+    for (int s = 0; s < count; s++) {
+        int requestPipe[2], replyPipe[2];
+        if (pipe(requestPipe) != 0 || pipe(replyPipe) != 0) {
+            shardCount = s;
+            closeShards();
+            return false;
+        }
+
+        pid_t pid = fork();
+        if (pid == 0) {
+            close(requestPipe[1]);
+            close(replyPipe[0]);
+            for (int other = 0; other < s; other++) {
+                close(shardWorkers[other].requestFd);
+                close(shardWorkers[other].replyFd);
+            }
+            runShardWorker(s, requestPipe[0], replyPipe[1]);
+        }
+
+        close(requestPipe[0]);
+        close(replyPipe[1]);
+        shardWorkers[s].pid = pid;
+        shardWorkers[s].requestFd = requestPipe[1];
+        shardWorkers[s].replyFd = replyPipe[0];
+        if (pid < 0) {
+            shardCount = s + 1;
+            closeShards();
+            return false;
+        }
+    }
+    return true;
+}
+
+// Route a batch of requests to their shards and fill replies[] in the same
+// order. Each window sends up to SHARD_PIPELINE_DEPTH requests per shard
+// before collecting, so a full reply pipe can never stall a worker.
+bool routeShardRequests(const ShardRequest* requests, int count, ShardReply* replies) {
+    lock_guard<mutex> lock(shardRouterMutex);
+    vector<vector<int> > pending(shardCount);
+    vector<ShardRequest> outgoing;
+    int next = 0;
+
+    while (next < count) {
+        for (int s = 0; s < shardCount; s++) {
+            pending[s].clear();
+        }
+
+        // Fill the window until some shard is full or the batch ends
+        while (next < count) {
+            int shard = shardForProduct(requests[next].productId);
+            if ((int)pending[shard].size() >= SHARD_PIPELINE_DEPTH) {
+                break;
+            }
+            pending[shard].push_back(next++);
+        }
+
+        for (int s = 0; s < shardCount; s++) {
+            if (pending[s].empty()) {
+                continue;
+            }
+            outgoing.clear();
+            for (size_t r = 0; r < pending[s].size(); r++) {
+                outgoing.push_back(requests[pending[s][r]]);
+            }
+            if (!writeFully(shardWorkers[s].requestFd, &outgoing[0],
+                            outgoing.size() * sizeof(ShardRequest))) {
+                return false;
+            }
+        }
+
+        for (int s = 0; s < shardCount; s++) {
+            for (size_t r = 0; r < pending[s].size(); r++) {
+                if (!readFully(shardWorkers[s].replyFd, &replies[pending[s][r]], sizeof(ShardReply))) {
+                    return false;
+                }
+            }
+        }
+    }
+    return true;
+}
+
+bool shardedLookup(int productId, ShardReply* reply) {
+    ShardRequest request = {SHARD_LOOKUP, productId, 0};
+    return routeShardRequests(&request, 1, reply) && reply->status == 1;
+}
+
+bool shardedPurchase(int productId, int quantity, ShardReply* reply) {
+    ShardRequest request = {SHARD_PURCHASE, productId, quantity};
+    return routeShardRequests(&request, 1, reply) && reply->status == 1;
+}
+
+// Scatter a statistics request to every shard and add up the partials
+bool shardedStatistics(int* totalProducts, int* lowStock, int* outOfStock, double* totalValue) {
+    *totalProducts = 0;
+    *lowStock = 0;
+    *outOfStock = 0;
+    *totalValue = 0.0;
+
+    lock_guard<mutex> lock(shardRouterMutex);
+    ShardRequest request = {SHARD_STATISTICS, 0, 0};
+    for (int s = 0; s < shardCount; s++) {
+        if (!writeFully(shardWorkers[s].requestFd, &request, sizeof(request))) {
+            return false;
+        }
+    }
+    for (int s = 0; s < shardCount; s++) {
+        ShardReply reply;
+        if (!readFully(shardWorkers[s].replyFd, &reply, sizeof(reply))) {
+            return false;
+        }
+        *totalProducts += reply.totalProducts;
+        *lowStock += reply.lowStock;
+        *outOfStock += reply.outOfStock;
+        *totalValue += reply.totalValue;
+    }
+    return true;
+}
+
+void shardedLookupMenu() {
+    clearScreen();
+    printTableHeader("SEARCH PRODUCT (SHARDED)");
+
+    int id;
+    cout << "Enter Product ID: ";
+    if (!(cin >> id)) {
+        clearInputBuffer();
+        printError("Invalid input! ID must be a number.");
+        return;
+    }
+
+    ShardReply reply;
+    if (!shardedLookup(id, &reply)) {
+        printError("Product not found!");
+        return;
+    }
+    cout << "\nID:           " << reply.productId << "\n";
+    cout << "Name:         " << reply.name << "\n";
+    cout << "Quantity:     " << reply.quantity << "\n";
+    cout << "Price:        $" << fixed << setprecision(2) << reply.price << "\n";
+    cout << "Shard:        " << shardForProduct(id) + 1 << " of " << shardCount << "\n";
+}
+
+void shardedPurchaseMenu() {
+    clearScreen();
+    printTableHeader("PURCHASE PRODUCT (SHARDED)");
+
+    int id, quantity;
+    cout << "Enter Product ID: ";
+    if (!(cin >> id)) {
+        clearInputBuffer();
+        printError("Invalid input! ID must be a number.");
+        return;
+    }
+    cout << "Enter Quantity: ";
+    if (!(cin >> quantity) || quantity <= 0) {
+        clearInputBuffer();
+        printError("Invalid quantity!");
+        return;
+    }
+
+    ShardReply reply;
+    if (!shardedLookup(id, &reply)) {
+        printError("Product not found!");
+        return;
+    }
+    if (!shardedPurchase(id, quantity, &reply)) {
+        printError("Insufficient stock! Available: " + to_string(reply.quantity));
+        return;
+    }
+    if (reply.transactionId == 0) {
+        printWarning("Transaction history limit reached on this shard!");
+        printSuccess("Purchase completed on shard " + to_string(shardForProduct(id) + 1) +
+                     ", transaction not recorded.");
+    } else {
+        printSuccess("Purchase completed on shard " + to_string(shardForProduct(id) + 1) +
+                     ", transaction " + to_string(reply.transactionId) + ".");
+    }
+    cout << "Total: $" << fixed << setprecision(2) << reply.total << "\n";
+    cout << "Stock left: " << reply.quantity << "\n";
+}
+
+void shardedReportMenu() {
+    clearScreen();
+    printTableHeader("INVENTORY REPORT (SHARDED)");
+
+    int totalProducts, lowStock, outOfStock;
+    double totalValue;
+    if (!shardedStatistics(&totalProducts, &lowStock, &outOfStock, &totalValue)) {
+        printError("A shard did not answer.");
+        return;
+    }
+    cout << "Shards:          " << shardCount << "\n";
+    cout << "Total Products:  " << totalProducts << "\n";
+    cout << "Low Stock:       " << lowStock << "\n";
+    cout << "Out of Stock:    " << outOfStock << "\n";
+    cout << "Total Value:     $" << fixed << setprecision(2) << totalValue << "\n";
+}
+
+// "--shards N": fork the workers from the loaded inventory before any
+// thread exists, then serve a reduced menu through the router
+int runShardedMode(int shards) {
+    if (!startShards(shards)) {
+        printError("Could not start " + to_string(shards) + " shard(s) (1 to " +
+                   to_string(MAX_SHARDS) + ").");
+        return 1;
+    }
+    keepShardPartition(-1);   // no product hashes to -1: the router keeps none
+
+    int choice;
+    do {
+        cout << "\n================================================================\n";
+        cout << "     SMART INVENTORY MANAGEMENT SYSTEM (" << shardCount << " SHARDS)\n";
+        cout << "================================================================\n";
+        cout << "    1. Search Product\n";
+        cout << "    2. Purchase Product\n";
+        cout << "    3. Inventory Report\n";
+        cout << "    0. Exit\n";
+        cout << "================================================================\n";
+        cout << "Enter your choice: ";
+
+        if (!(cin >> choice)) {
+            if (cin.eof()) {
+                break;
+            }
+            clearInputBuffer();
+            printError("Invalid input! Please enter a number.");
+            pauseScreen();
+            clearScreen();
+            continue;
+        }
+
+        switch (choice) {
+            case 1:
+                shardedLookupMenu();
+                pauseScreen();
+                clearScreen();
+                break;
+            case 2:
+                shardedPurchaseMenu();
+                pauseScreen();
+                clearScreen();
+                break;
+            case 3:
+                shardedReportMenu();
+                pauseScreen();
+                clearScreen();
+                break;
+            case 0:
+                break;
+            default:
+                printError("Invalid choice! Please try again.");
+                pauseScreen();
+                clearScreen();
+                break;
+        }
+    } while (choice != 0);
+
+    stopShards();
+    return 0;
+}
+#else
+int runShardedMode(int) {
+    printError("Sharded mode needs fork() and is not available on Windows.");
+    return 1;
+}
+#endif
+
+// ============================================================
+// REPLICATION (HOT STANDBY)
+// ============================================================
+// A replica is a separate process started with "--replica PATH". It
+// creates two FIFOs, PATH.log and PATH.ack, and waits there for a primary.
+// Attaching from the primary sends the replica the whole inventory and
+// then streams the mutation log to it in the compact change feed format,
+// so strings travel length-prefixed and are never cut. A shipper thread per
+// replica sends whatever has been logged since its last batch as one
+// frame, without waiting for the previous batch to be acknowledged; an ack
+// thread reads the replica's acknowledgements, measures lag and trims the
+// log. A replica that dies or stops answering is marked failed and is left
+// out of trimming, waits and reads from then on.
+//
+// Searches, product listings and reports are served by a replica that has
+// caught up with the primary. If the primary goes away without shutting
+// its replicas down, a replica takes over as the primary with everything
+// it has applied. Suppliers are not replicated; on takeover categories are
+// recreated from the products and reservation holds are released.
+
+// Grow the product arrays up to index with empty, inactive placeholders
+void ensureProductSlot(int index) {
+    while (productCount <= index && productCount < MAX_ITEMS) {
+        products[productCount] = Product{0, "", "", 0, 0.0, false};
+        for (int l = 0; l < MAX_LOCATIONS; l++) {
+            locationStock[productCount][l] = 0;
+        }
+        reservedStock[productCount] = 0;
+        resetDemandForecast(productCount);
+        productCount++;
+    }
+}
+
+// Apply one logged change. The caller must hold inventoryWriteMutex.
+void applyMutation(const MutationRecord* record) {
+    if (record->type == MUTATION_PRODUCT) {
+        int index = record->productIndex;
+        ensureProductSlot(index);
+        if (index >= productCount) {
+            return;
+        }
+        adjustLocationTotals(index, -1);
+        products[index].id = record->productId;
+        products[index].name = record->name;
+        products[index].category = record->category;
+        products[index].quantity = record->quantity;
+        products[index].price = record->price;
+        products[index].active = record->active;
+        adjustLocationTotals(index, 1);
+        publishProductChanges(index, index);
+    } else if (record->type == MUTATION_LOCATION_STOCK) {
+        int index = record->productIndex;
+        ensureProductSlot(index);
+        if (index < productCount && record->location < MAX_LOCATIONS) {
+            changeLocationStock(index, record->location,
+                                record->quantity - locationStock[index][record->location]);
+        }
+    } else if (record->type == MUTATION_RESERVED) {
+        int index = record->productIndex;
+        ensureProductSlot(index);
+        if (index < productCount) {
+            reservedStock[index] = record->quantity;
+        }
+    } else if (record->type == MUTATION_TRANSACTION) {
+        if (record->productIndex >= 0 && record->productIndex < productCount) {
+            updateDemandForecast(record->productIndex, record->quantity, record->eventTime);
+        }
+        if (transactionCount < MAX_TRANSACTIONS) {
+            Transaction* trans = &transactions[transactionCount++];
+            trans->transactionId = record->transactionId;
+            trans->productId = record->productId;
+            trans->productName = record->name;
+            trans->quantity = record->quantity;
+            trans->unitPrice = record->price;
+            trans->discount = record->discount;
+            trans->totalPrice = record->total;
+            trans->date = record->date;
+            trans->time = record->time;
+            trans->timestamp = record->eventTime;
+        }
+        nextTransactionId = record->transactionId + 1;
+    } else if (record->type == MUTATION_LOCATION_ADDED) {
+        int location = record->location;
+        if (location < MAX_LOCATIONS) {
+            for (int i = 0; i < productCount; i++) {
+                locationStock[i][location] = 0;
+            }
+            locationUnits[location] = 0;
+            locationValue[location] = 0.0;
+            locations[location] = {record->name, "", record->active};
+            if (locationCount <= location) {
+                locationCount = location + 1;
+            }
+        }
+    }
+}
+
+Product productFromRecord(const MutationRecord* record) {
+    return Product{record->productId, record->name, record->category, record->quantity,
+                   record->price, record->active};
+}
+
+#ifndef _WIN32
+const int MAX_REPLICAS = 4;
+const int REPLICATION_BATCH_SIZE = 512;     // records per shipped frame
+const int REPLICA_REPLY_TIMEOUT_MS = 2000;  // a replica slower than this is dropped
+const int REPLICA_READ_WAIT_MS = 50;        // how long a read waits for a lagging replica
+
+enum ReplicationFrameKind {
+    FRAME_LOG_BATCH = 1,     // primary -> replica: encoded records
+    FRAME_QUERY_STATS = 2,   // primary -> replica
+    FRAME_QUERY_LOOKUP = 3,  // primary -> replica: stamp = product ID
+    FRAME_ACK = 4,           // replica -> primary: lsn applied, stamp echoed
+    FRAME_STATS_REPLY = 5,   // replica -> primary: ReplicaStatistics
+    FRAME_LOOKUP_REPLY = 6,  // replica -> primary: product and reserved records
+    FRAME_QUERY_LIST = 7,    // primary -> replica: stamp = 1 for low stock only
+    FRAME_LIST_REPLY = 8,    // replica -> primary: product records
+    FRAME_SHUTDOWN = 9       // primary -> replica: stop following, no takeover
+};
+
+// Header of every frame; `bytes` bytes of payload follow it
+struct ReplicationFrame {
+    int kind;
+    int bytes;
+    long long lsn;
+    long long stamp;
+};
+
+struct ReplicaStatistics {
+    int totalProducts;
+    int lowStock;
+    int outOfStock;
+    double totalValue;
+    int transactionCount;
+    long long appliedLsn;
+    int locationCount;
+    long long locationUnits[MAX_LOCATIONS];
+    double locationValue[MAX_LOCATIONS];
+};
+
+struct ReplicaLink {
+    string path;
+    int logFd;                     // frames to the replica
+    int ackFd;                     // frames from the replica
+    mutex writeMutex;              // shipper and queries share logFd
+    mutex queryMutex;              // one query at a time per link
+    thread shipper;
+    thread ackReader;
+    long long shippedLsn;
+    atomic<long long> ackedLsn;
+    atomic<bool> failed;           // died or stopped answering
+    mutex replyMutex;
+    condition_variable replyArrived;
+    bool replyReady;
+    ReplicationFrame reply;
+    vector<unsigned char> replyPayload;
+};
+
+ReplicaLink replicaLinks[MAX_REPLICAS];
+int replicaCount = 0;
+int nextReadReplica = 0;
+bool replicationStopping = false;
+
+// Lag samples in ns (append-to-ack time of each batch's last record)
+mutex replicationLagMutex;
+vector<long long> replicationLagSamples;
+const size_t MAX_LAG_SAMPLES = 1000000;
+
+bool sendReplicationFrame(int fd, int kind, long long lsn, long long stamp,
+                          const vector<unsigned char>* payload) {
+    ReplicationFrame frame = {kind, payload != NULL ? (int)payload->size() : 0, lsn, stamp};
+    return writeFully(fd, &frame, sizeof(frame)) &&
+           (frame.bytes == 0 || writeFully(fd, &(*payload)[0], frame.bytes));
+}
+
+// Read one frame and its payload
+bool readReplicationFrame(int fd, ReplicationFrame* frame, vector<unsigned char>* payload) {
+    if (!readFully(fd, frame, sizeof(*frame)) || frame->bytes < 0) {
+        return false;
+    }
+    payload->resize(frame->bytes);
+    return frame->bytes == 0 || readFully(fd, &(*payload)[0], frame->bytes);
+}
+
+bool decodePayload(const vector<unsigned char>* payload, vector<MutationRecord>* records) {
+    records->clear();
+    return decodeChanges(payload->empty() ? NULL : &(*payload)[0], payload->size(), records);
+}
+
+// Replica side: apply batches, ack them, answer queries. Returns true if
+// the primary went away without sending FRAME_SHUTDOWN. *appliedLsn gets
+// the last LSN applied.
+bool runReplica(int logFd, int ackFd, long long* appliedLsn) {
+    vector<unsigned char> payload;
+    vector<unsigned char> reply;
+    vector<MutationRecord> records;
+    ReplicationFrame frame;
+    *appliedLsn = 0;
+
+    while (readReplicationFrame(logFd, &frame, &payload)) {
+        reply.clear();
+        bool ok = true;
+
+        if (frame.kind == FRAME_SHUTDOWN) {
+            return false;
+        } else if (frame.kind == FRAME_LOG_BATCH) {
+            if (!decodePayload(&payload, &records)) {
+                break;
+            }
+            {
+                lock_guard<mutex> lock(inventoryWriteMutex);
+                for (size_t r = 0; r < records.size(); r++) {
+                    applyMutation(&records[r]);
+                }
+                if (frame.stamp == 0) {
+                    // The initial image: index it in one go
+                    rebuildSnapshot();
+                } else {
+                    publishProductChanges(0, -1);
+                }
+            }
+            *appliedLsn = frame.lsn;
+            ok = sendReplicationFrame(ackFd, FRAME_ACK, *appliedLsn, frame.stamp, NULL);
+        } else if (frame.kind == FRAME_QUERY_STATS) {
+            ReplicaStatistics stats;
+            memset(&stats, 0, sizeof(stats));
+            shared_ptr<const InventorySnapshot> snapshot = acquireSnapshot();
+            getSnapshotStatistics(snapshot.get(), &stats.totalProducts, &stats.lowStock,
+                                  &stats.outOfStock, &stats.totalValue);
+            stats.transactionCount = snapshot->transactionCount;
+            stats.appliedLsn = *appliedLsn;
+            stats.locationCount = min(MAX_LOCATIONS, (int)snapshot->locationUnits.size());
+            for (int l = 0; l < stats.locationCount; l++) {
+                stats.locationUnits[l] = snapshot->locationUnits[l];
+                stats.locationValue[l] = snapshot->locationValue[l];
+            }
+            reply.assign((const unsigned char*)&stats, (const unsigned char*)&stats + sizeof(stats));
+            ok = sendReplicationFrame(ackFd, FRAME_STATS_REPLY, *appliedLsn, 0, &reply);
+        } else if (frame.kind == FRAME_QUERY_LOOKUP) {
+            int index = findProductById((int)frame.stamp);
+            if (index != -1) {
+                MutationRecord found[2];
+                fillProductRecord(index, &found[0]);
+                found[1] = MutationRecord();
+                found[1].type = MUTATION_RESERVED;
+                found[1].productIndex = index;
+                found[1].productId = products[index].id;
+                found[1].quantity = reservedStock[index];
+                encodeChanges(found, 2, &reply);
+            }
+            ok = sendReplicationFrame(ackFd, FRAME_LOOKUP_REPLY, *appliedLsn, 0, &reply);
+        } else if (frame.kind == FRAME_QUERY_LIST) {
+            records.clear();
+            for (int i = 0; i < productCount; i++) {
+                if (products[i].active &&
+                    (frame.stamp == 0 || products[i].quantity <= MIN_STOCK_THRESHOLD)) {
+                    records.push_back(MutationRecord());
+                    fillProductRecord(i, &records.back());
+                }
+            }
+            encodeChanges(records.empty() ? NULL : &records[0], (int)records.size(), &reply);
+            ok = sendReplicationFrame(ackFd, FRAME_LIST_REPLY, *appliedLsn, 0, &reply);
+        }
+        if (!ok) {
+            break;
+        }
+    }
+    return true;
+}
+
+// The primary is gone: continue from the last applied LSN as the primary.
+// Holds die with the primary that timed them, and categories are not
+// replicated, so the ones products use are recreated.
+void takeOverAsPrimary(long long appliedLsn) {
+    lock_guard<mutex> lock(inventoryWriteMutex);
+    {
+        lock_guard<mutex> logLock(mutationLogMutex);
+        mutationLog.clear();
+        nextLsn = appliedLsn + 1;
+        mutationLogBaseLsn = nextLsn;
+    }
+    for (int i = 0; i < productCount; i++) {
+        reservedStock[i] = 0;
+        if (products[i].active && !categoryExists(products[i].category) && categoryCount < MAX_ITEMS) {
+            categories[categoryCount++] = {products[i].category, "Recovered by replica takeover", true};
+        }
+    }
+    rebuildDemandForecasts((long long)time(0));
+    rebuildSnapshot();
+}
+
+// Run this process as a replica waiting at path. Returns true if the
+// primary was lost and this process should carry on as the primary.
+bool followPrimary(const char* path) {
+    string logPath = string(path) + ".log";
+    string ackPath = string(path) + ".ack";
+    unlink(logPath.c_str());
+    unlink(ackPath.c_str());
+    if (mkfifo(logPath.c_str(), 0600) != 0 || mkfifo(ackPath.c_str(), 0600) != 0) {
+        printError("Could not create the replica pipes at " + string(path) + ".");
+        return false;
+    }
+    signal(SIGPIPE, SIG_IGN);
+
+    cout << "Replica waiting for a primary at " << path << " ...\n";
+    cout.flush();
+    int logFd = open(logPath.c_str(), O_RDONLY);
+    int ackFd = logFd < 0 ? -1 : open(ackPath.c_str(), O_WRONLY);
+    // Connected: remove the names so no second primary can attach
+    unlink(logPath.c_str());
+    unlink(ackPath.c_str());
+    if (ackFd < 0) {
+        if (logFd >= 0) {
+            close(logFd);
+        }
+        printError("Could not connect to the primary.");
+        return false;
+    }
+    printSuccess("Following the primary.");
+
+    long long appliedLsn;
+    bool lost = runReplica(logFd, ackFd, &appliedLsn);
+    close(logFd);
+    close(ackFd);
+    if (!lost) {
+        printSuccess("The primary shut down; replica stopped.");
+        return false;
+    }
+
+    takeOverAsPrimary(appliedLsn);
+    printWarning("Primary lost. This replica is now the primary (applied up to LSN " +
+                 to_string(appliedLsn) + ").");
+    return true;
+}
+
+// Lowest LSN every live replica has acknowledged. The caller must hold
+// mutationLogMutex.
+long long minimumAckedLsn() {
+    long long lowest = nextLsn - 1;
+    for (int r = 0; r < replicaCount; r++) {
+        if (!replicaLinks[r].failed) {
+            lowest = min(lowest, replicaLinks[r].ackedLsn.load());
+        }
+    }
+    return lowest;
+}
+
+// Drop a replica from trimming, waits and reads, and wake anyone waiting
+// on it
+void markReplicaFailed(ReplicaLink* link) {
+    {
+        lock_guard<mutex> lock(mutationLogMutex);
+        link->failed = true;
+        trimMutationLogForReaders();
+    }
+    mutationLogChanged.notify_all();
+    lock_guard<mutex> lock(link->replyMutex);
+    link->replyArrived.notify_all();
+}
+
+void shipMutationLog(ReplicaLink* link) {
+    vector<MutationRecord> batch;
+    vector<unsigned char> payload;
+
+    while (true) {
+        {
+            unique_lock<mutex> lock(mutationLogMutex);
+            while (!replicationStopping && !link->failed && link->shippedLsn + 1 >= nextLsn) {
+                mutationLogChanged.wait(lock);
+            }
+            if (link->failed || link->shippedLsn + 1 >= nextLsn) {
+                return; // failed, or stopping and fully shipped
+            }
+
+            // Everything logged since the last frame, up to one batch
+            size_t first = link->shippedLsn + 1 - mutationLogBaseLsn;
+            size_t count = min((size_t)REPLICATION_BATCH_SIZE, mutationLog.size() - first);
+            batch.assign(mutationLog.begin() + first, mutationLog.begin() + first + count);
+        }
+
+        payload.clear();
+        encodeChanges(&batch[0], (int)batch.size(), &payload);
+        lock_guard<mutex> lock(link->writeMutex);
+        if (!sendReplicationFrame(link->logFd, FRAME_LOG_BATCH, batch.back().lsn,
+                                  batch.back().loggedAtNs, &payload)) {
+            markReplicaFailed(link);
+            return;
+        }
+        link->shippedLsn = batch.back().lsn;
+    }
+}
+
+void readReplicaAcks(ReplicaLink* link) {
+    ReplicationFrame frame;
+    vector<unsigned char> payload;
+    while (readReplicationFrame(link->ackFd, &frame, &payload)) {
+        if (frame.kind == FRAME_ACK) {
+            if (frame.stamp != 0) { // 0 for the initial image
+                long long lag = steadyNowNs() - frame.stamp;
+                lock_guard<mutex> lock(replicationLagMutex);
+                if (replicationLagSamples.size() < MAX_LAG_SAMPLES) {
+                    replicationLagSamples.push_back(lag);
+                }
+            }
+            {
+                lock_guard<mutex> lock(mutationLogMutex);
+                link->ackedLsn = frame.lsn;
+                trimMutationLogForReaders();
+            }
+            mutationLogChanged.notify_all();
+            continue;
+        }
+
+        lock_guard<mutex> lock(link->replyMutex);
+        link->reply = frame;
+        link->replyPayload.swap(payload);
+        link->replyReady = true;
+        link->replyArrived.notify_all();
+    }
+    markReplicaFailed(link);
+}
+
+// Every location, product, stock cell, hold and transaction as records, for
+// a replica that starts empty. The caller must hold inventoryWriteMutex.
+void buildInventoryImage(long long lsn, vector<MutationRecord>* image) {
+    MutationRecord record;
+    for (int l = 0; l < locationCount; l++) {
+        record = MutationRecord();
+        record.type = MUTATION_LOCATION_ADDED;
+        record.location = l;
+        record.active = locations[l].active;
+        record.name = locations[l].name;
+        image->push_back(record);
+    }
+    for (int i = 0; i < productCount; i++) {
+        fillProductRecord(i, &record);
+        image->push_back(record);
+        for (int l = 0; l < locationCount; l++) {
+            if (locationStock[i][l] != 0) {
+                record = MutationRecord();
+                record.type = MUTATION_LOCATION_STOCK;
+                record.productIndex = i;
+                record.productId = products[i].id;
+                record.location = l;
+                record.quantity = locationStock[i][l];
+                image->push_back(record);
+            }
+        }
+        if (reservedStock[i] != 0) {
+            record = MutationRecord();
+            record.type = MUTATION_RESERVED;
+            record.productIndex = i;
+            record.productId = products[i].id;
+            record.quantity = reservedStock[i];
+            image->push_back(record);
+        }
+    }
+    for (int t = 0; t < transactionCount; t++) {
+        fillTransactionRecord(&transactions[t], -1, &record);
+        image->push_back(record);
+    }
+    for (size_t r = 0; r < image->size(); r++) {
+        (*image)[r].lsn = lsn;
+    }
+}
+
+// Connect to a replica waiting at path, send it the whole inventory and
+// start shipping the log to it. Returns false with a reason in *error.
+bool attachReplica(const string& path, string* error) {
+    if (replicaCount >= MAX_REPLICAS) {
+        *error = "At most " + to_string(MAX_REPLICAS) + " replicas can be attached.";
+        return false;
+    }
+    signal(SIGPIPE, SIG_IGN); // a dead replica must not take the primary down
+
+    // Non-blocking so a missing replica fails at once instead of hanging
+    int logFd = open((path + ".log").c_str(), O_WRONLY | O_NONBLOCK);
+    if (logFd < 0) {
+        *error = "No replica is waiting at " + path + ".";
+        return false;
+    }
+    fcntl(logFd, F_SETFL, fcntl(logFd, F_GETFL) & ~O_NONBLOCK);
+    int ackFd = open((path + ".ack").c_str(), O_RDONLY);
+    if (ackFd < 0) {
+        close(logFd);
+        *error = "Could not open " + path + ".ack.";
+        return false;
+    }
+
+    ReplicaLink* link = &replicaLinks[replicaCount];
+    vector<MutationRecord> image;
+    long long lsn;
+    {
+        // Image and log position taken together, with logging switched on,
+        // so the replica misses nothing in between
+        lock_guard<mutex> writeLock(inventoryWriteMutex);
+        lock_guard<mutex> lock(mutationLogMutex);
+        lsn = nextLsn - 1;
+        buildInventoryImage(lsn, &image);
+
+        link->path = path;
+        link->logFd = logFd;
+        link->ackFd = ackFd;
+        link->shippedLsn = lsn;
+        link->ackedLsn = lsn - 1;   // behind until the image is acknowledged
+        link->failed = false;
+        link->replyReady = false;
+        if (replicaCount == 0) {
+            replicationStopping = false;
+        }
+        replicaCount++;
+        mutationLogEnabled = true;
+    }
+
+    vector<unsigned char> payload;
+    encodeChanges(image.empty() ? NULL : &image[0], (int)image.size(), &payload);
+    if (!sendReplicationFrame(logFd, FRAME_LOG_BATCH, lsn, 0, &payload)) {
+        link->failed = true;
+    }
+    link->shipper = thread(shipMutationLog, link);
+    link->ackReader = thread(readReplicaAcks, link);
+    if (link->failed) {
+        *error = "The replica at " + path + " went away during the initial copy.";
+        return false;
+    }
+    return true;
+}
+
+// Ship everything still queued, then tell the replicas to stop (so they
+// do not take over) and disconnect them
+void stopReplicas() {
+    {
+        lock_guard<mutex> lock(mutationLogMutex);
+        replicationStopping = true;
+        mutationLogEnabled = hasChangeConsumers();
+    }
+    mutationLogChanged.notify_all();
+
+    for (int r = 0; r < replicaCount; r++) {
+        ReplicaLink* link = &replicaLinks[r];
+        link->shipper.join();
+        {
+            lock_guard<mutex> lock(link->writeMutex);
+            if (!link->failed) {
+                sendReplicationFrame(link->logFd, FRAME_SHUTDOWN, 0, 0, NULL);
+            }
+        }
+        close(link->logFd);
+        link->ackReader.join();
+        close(link->ackFd);
+    }
+    replicaCount = 0;
+
+    lock_guard<mutex> lock(mutationLogMutex);
+    trimMutationLogForReaders();
+}
+
+// Wait until every live replica has applied the log up to lsn. Returns
+// false if that did not happen within timeoutMs.
+bool waitForReplicas(long long lsn, int timeoutMs) {
+    unique_lock<mutex> lock(mutationLogMutex);
+    chrono::steady_clock::time_point deadline =
+        chrono::steady_clock::now() + chrono::milliseconds(timeoutMs);
+
+    while (minimumAckedLsn() < lsn) {
+        if (mutationLogChanged.wait_until(lock, deadline) == cv_status::timeout) {
+            return minimumAckedLsn() >= lsn;
+        }
+    }
+    return true;
+}
+
+// Wait until one replica has applied the log up to lsn; false if it failed
+// or is still behind after timeoutMs
+bool waitForReplica(int replica, long long lsn, int timeoutMs) {
+    ReplicaLink* link = &replicaLinks[replica];
+    unique_lock<mutex> lock(mutationLogMutex);
+    chrono::steady_clock::time_point deadline =
+        chrono::steady_clock::now() + chrono::milliseconds(timeoutMs);
+
+    while (!link->failed && link->ackedLsn < lsn) {
+        if (mutationLogChanged.wait_until(lock, deadline) == cv_status::timeout) {
+            break;
+        }
+    }
+    return !link->failed && link->ackedLsn >= lsn;
+}
+
+// Replicas own shipper and ack threads while attached
+bool replicasAttached() {
+    return replicaCount > 0;
+}
+
+// A live replica that has applied everything logged so far (so a read
+// right after a write sees it), taking turns between replicas; -1 if none
+int pickReadReplica() {
+    long long lsn;
+    {
+        lock_guard<mutex> lock(mutationLogMutex);
+        lsn = nextLsn - 1;
+    }
+    for (int tried = 0; tried < replicaCount; tried++) {
+        int replica = nextReadReplica++ % replicaCount;
+        if (waitForReplica(replica, lsn, REPLICA_READ_WAIT_MS)) {
+            return replica;
+        }
+    }
+    return -1;
+}
+
+// Send one query frame and wait for its reply. A replica that does not
+// answer in time is marked failed.
+bool queryReplica(int replica, int kind, long long arg, vector<unsigned char>* payload) {
+    if (replica < 0 || replica >= replicaCount || replicaLinks[replica].failed) {
+        return false;
+    }
+    ReplicaLink* link = &replicaLinks[replica];
+    lock_guard<mutex> queryLock(link->queryMutex);
+    {
+        lock_guard<mutex> lock(link->replyMutex);
+        link->replyReady = false;
+    }
+
+    bool sent;
+    {
+        lock_guard<mutex> lock(link->writeMutex);
+        sent = sendReplicationFrame(link->logFd, kind, 0, arg, NULL);
+    }
+    if (!sent) {
+        markReplicaFailed(link);
+        return false;
+    }
+
+    unique_lock<mutex> lock(link->replyMutex);
+    chrono::steady_clock::time_point deadline =
+        chrono::steady_clock::now() + chrono::milliseconds(REPLICA_REPLY_TIMEOUT_MS);
+    while (!link->replyReady && !link->failed) {
+        if (link->replyArrived.wait_until(lock, deadline) == cv_status::timeout) {
+            break;
+        }
+    }
+    if (!link->replyReady) {
+        lock.unlock();
+        markReplicaFailed(link);
+        return false;
+    }
+    payload->swap(link->replyPayload);
+    return true;
+}
+
+// Report figures as seen by a replica (call by address); false if the
+// replica could not answer
+bool getReplicaReport(int replica, int* totalProducts, int* lowStock, int* outOfStock,
+                      double* totalValue, int* transactionCount,
+                      vector<long long>* locationUnits, vector<double>* locationValue) {
+    vector<unsigned char> payload;
+    ReplicaStatistics stats;
+    if (!queryReplica(replica, FRAME_QUERY_STATS, 0, &payload) || payload.size() != sizeof(stats)) {
+        return false;
+    }
+    memcpy(&stats, &payload[0], sizeof(stats));
+    *totalProducts = stats.totalProducts;
+    *lowStock = stats.lowStock;
+    *outOfStock = stats.outOfStock;
+    *totalValue = stats.totalValue;
+    *transactionCount = stats.transactionCount;
+    locationUnits->assign(stats.locationUnits, stats.locationUnits + stats.locationCount);
+    locationValue->assign(stats.locationValue, stats.locationValue + stats.locationCount);
+    return true;
+}
+
+// Look a product up on a replica. Returns false if the replica could not
+// answer; *found says whether it has the product.
+bool lookupOnReplica(int replica, int productId, bool* found, Product* product, int* reserved) {
+    vector<unsigned char> payload;
+    vector<MutationRecord> records;
+    if (!queryReplica(replica, FRAME_QUERY_LOOKUP, productId, &payload) ||
+        !decodePayload(&payload, &records)) {
+        return false;
+    }
+    *found = records.size() == 2;
+    if (*found) {
+        *product = productFromRecord(&records[0]);
+        *reserved = records[1].quantity;
+    }
+    return true;
+}
+
+// Active products (or only the low stock ones) as seen by a replica
+bool listProductsOnReplica(int replica, bool lowStockOnly, vector<Product>* listed) {
+    vector<unsigned char> payload;
+    vector<MutationRecord> records;
+    if (!queryReplica(replica, FRAME_QUERY_LIST, lowStockOnly ? 1 : 0, &payload) ||
+        !decodePayload(&payload, &records)) {
+        return false;
+    }
+    listed->clear();
+    for (size_t r = 0; r < records.size(); r++) {
+        listed->push_back(productFromRecord(&records[r]));
+    }
+    return true;
+}
+
+void manageReplication() {
+    clearScreen();
+    printTableHeader("REPLICATION");
+
+    cout << "Start a replica with \"<this program> --replica <path>\", then attach it\n";
+    cout << "here. Searches, product listings and reports are served by replicas.\n\n";
+
+    if (replicaCount == 0) {
+        cout << "No replicas attached.\n";
+    } else {
+        long long logged;
+        {
+            lock_guard<mutex> lock(mutationLogMutex);
+            logged = nextLsn - 1;
+        }
+        cout << left << setw(4) << "#" << setw(30) << "Path" << setw(12) << "Applied"
+             << setw(10) << "Behind" << "Status\n";
+        cout << "----------------------------------------------------------------\n";
+        for (int r = 0; r < replicaCount; r++) {
+            long long acked = replicaLinks[r].ackedLsn;
+            cout << left << setw(4) << r + 1 << setw(30) << replicaLinks[r].path
+                 << setw(12) << acked << setw(10) << logged - acked
+                 << (replicaLinks[r].failed ? "FAILED" : "OK") << "\n";
+        }
+    }
+    cout << "----------------------------------------------------------------\n";
+    cout << "  1. Attach Replica\n";
+    cout << "  2. Detach All Replicas\n";
+    cout << "  0. Back\n";
+    cout << "Enter your choice: ";
+
+    int choice;
+    if (!(cin >> choice) || choice < 0 || choice > 2) {
+        clearInputBuffer();
+        printError("Invalid choice!");
+        return;
+    }
+
+    if (choice == 1) {
+        string path, error;
+        clearInputBuffer();
+        cout << "Enter replica path: ";
+        getline(cin, path);
+        if (path.empty() || !attachReplica(path, &error)) {
+            printError(path.empty() ? "Path cannot be empty!" : error);
+            return;
+        }
+        printSuccess("Replica at " + path + " attached.");
+    } else if (choice == 2) {
+        stopReplicas();
+        printSuccess("Replicas shut down.");
+    }
+}
+#else
+int pickReadReplica() {
+    return -1;
+}
+
+bool getReplicaReport(int, int*, int*, int*, double*, int*, vector<long long>*, vector<double>*) {
+    return false;
+}
+
+bool lookupOnReplica(int, int, bool*, Product*, int*) {
+    return false;
+}
+
+bool listProductsOnReplica(int, bool, vector<Product>*) {
+    return false;
+}
+
+bool followPrimary(const char*) {
+    printError("Replicas need pipes and are not available on Windows.");
+    return false;
+}
+
+void stopReplicas() {
+}
+
+void manageReplication() {
+    clearScreen();
+    printTableHeader("REPLICATION");
+    printError("Replicas need pipes and are not available on Windows.");
+}
+#endif
+
+// ============================================================
+// CHANGE DATA CAPTURE FEED
+// ============================================================
+// Downstream readers (stock badges, accounting) tail the mutation log
+// through named consumers. Each consumer has a committed offset (the last
+// LSN it has fully processed); records stay in the log until every
+// consumer and replica is past them. A consumer that unregisters is only
+// parked: its offset still holds records back and logging stays on, so it
+// resumes where it stopped. Reads are batched, can coalesce repeated
+// updates of the same product, and waitForChanges wakes a consumer as soon
+// as a writer appends, so nothing polls the catalog.
+const int MAX_CHANGE_CONSUMERS = 16;
+const int CHANGES_LOST = -1;    // readChanges: offset older than the log
+
+struct ChangeConsumer {
+    string name;
+    long long offset;   // last LSN committed by this consumer
+    bool active;        // reading now; false when parked
+    bool removed;       // forgotten; the slot can be reused
+};
+
+ChangeConsumer changeConsumers[MAX_CHANGE_CONSUMERS];
+int changeConsumerCount = 0;
+
+// True while any consumer, reading or parked, still needs the log
+bool hasChangeConsumers() {
+    for (int c = 0; c < changeConsumerCount; c++) {
+        if (!changeConsumers[c].removed) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Trim everything that all consumers and replicas have moved past.
+// The caller must hold mutationLogMutex.
+void trimMutationLogForReaders() {
+    long long lowest = nextLsn - 1;
+    for (int c = 0; c < changeConsumerCount; c++) {
+        if (!changeConsumers[c].removed) {
+            lowest = min(lowest, changeConsumers[c].offset);
+        }
+    }
+#ifndef _WIN32
+    for (int r = 0; r < replicaCount; r++) {
+        if (!replicaLinks[r].failed) {
+            lowest = min(lowest, replicaLinks[r].ackedLsn.load());
+        }
+    }
+#endif
+    trimMutationLog(lowest);
+}
+
+// Switch logging off once nobody reads the log. The caller must hold
+// mutationLogMutex.
+void updateMutationLogging() {
+#ifndef _WIN32
+    mutationLogEnabled = hasChangeConsumers() || replicaCount > 0;
+#else
+    mutationLogEnabled = hasChangeConsumers();
+#endif
+    trimMutationLogForReaders();
+}
+
+// Register (or reopen) a consumer by name. A new consumer starts at the
+// current end of the log; a known name resumes from its committed offset.
+int registerChangeConsumer(string name) {
+    lock_guard<mutex> writeLock(inventoryWriteMutex);
+    lock_guard<mutex> lock(mutationLogMutex);
+
+    int freeSlot = -1;
+    for (int c = 0; c < changeConsumerCount; c++) {
+        if (changeConsumers[c].removed) {
+            freeSlot = freeSlot == -1 ? c : freeSlot;
+        } else if (changeConsumers[c].name == name) {
+            changeConsumers[c].active = true;
+            return c;
+        }
+    }
+    if (freeSlot == -1) {
+        if (changeConsumerCount >= MAX_CHANGE_CONSUMERS) {
+            return -1;
+        }
+        freeSlot = changeConsumerCount++;
+    }
+
+    changeConsumers[freeSlot] = {name, nextLsn - 1, true, false};
+    mutationLogEnabled = true;
+    return freeSlot;
+}
+
+// Stop reading for now. The offset stays pinned and changes keep being
+// logged, so registering the same name later resumes without a gap.
+void unregisterChangeConsumer(int consumer) {
+    lock_guard<mutex> lock(mutationLogMutex);
+    changeConsumers[consumer].active = false;
+}
+
+// Forget a consumer for good and release the records it was holding back
+void removeChangeConsumer(int consumer) {
+    lock_guard<mutex> writeLock(inventoryWriteMutex);
+    lock_guard<mutex> lock(mutationLogMutex);
+
+    changeConsumers[consumer].active = false;
+    changeConsumers[consumer].removed = true;
+    updateMutationLogging();
+}
+
+// After CHANGES_LOST: the consumer has to reload the catalog, then carry on
+// from the LSN returned here (the current end of the log)
+long long resetChangeOffset(int consumer) {
+    lock_guard<mutex> lock(mutationLogMutex);
+    changeConsumers[consumer].offset = nextLsn - 1;
+    trimMutationLogForReaders();
+    return nextLsn - 1;
+}
+
+// Copy up to maxRecords changes after the consumer's offset into out[].
+// With coalesce, only the newest product image, stock cell and held count
+// per product in the batch are returned (transactions are always kept). *lastLsn gets
+// the LSN to commit once the batch is processed. Returns the record count,
+// or CHANGES_LOST if records after the offset are no longer in the log
+// (see resetChangeOffset).
+int readChanges(int consumer, MutationRecord* out, int maxRecords, bool coalesce,
+                long long* lastLsn) {
+    lock_guard<mutex> lock(mutationLogMutex);
+
+    long long offset = changeConsumers[consumer].offset;
+    *lastLsn = offset;
+    if (offset + 1 < mutationLogBaseLsn) {
+        return CHANGES_LOST;
+    }
+    size_t first = offset + 1 - mutationLogBaseLsn;
+    size_t count = 0;
+    if (first < mutationLog.size()) {
+        count = min((size_t)maxRecords, mutationLog.size() - first);
+    }
+    *lastLsn = count > 0 ? mutationLog[first + count - 1].lsn : offset;
+
+    if (!coalesce) {
+        for (size_t i = 0; i < count; i++) {
+            out[i] = mutationLog[first + i];
+        }
+        return count;
+    }
 
-    // Call by address - discount and total are calculated via pointers
-    calculateDiscount(quantity, subtotal, &discount, &total);
+    // Walk backwards keeping the newest record per key, then restore order
+    unordered_set<long long> seen;
+    int kept = 0;
+    for (size_t i = count; i-- > 0;) {
+        const MutationRecord* record = &mutationLog[first + i];
+        long long key = -1;
+        if (record->type == MUTATION_PRODUCT) {
+            key = record->productIndex;
+        } else if (record->type == MUTATION_LOCATION_STOCK) {
+            key = (long long)MAX_ITEMS * (1 + record->location) + record->productIndex;
+        } else if (record->type == MUTATION_RESERVED) {
+            key = (long long)MAX_ITEMS * (1 + MAX_LOCATIONS) + record->productIndex;
+        }
+        if (key != -1 && !seen.insert(key).second) {
+            continue;
+        }
+        out[kept++] = *record;
+    }
+    reverse(out, out + kept);
+    return kept;
+}
 
-    // Update inventory using pointer
-    updateInventoryStock(&products[index], quantity);
+// Mark everything up to lsn as processed and release it from the log
+void commitChangeOffset(int consumer, long long lsn) {
+    lock_guard<mutex> lock(mutationLogMutex);
+    if (lsn > changeConsumers[consumer].offset) {
+        changeConsumers[consumer].offset = lsn;
+        trimMutationLogForReaders();
+    }
+}
 
-    // Record transaction
-    recordTransaction(products[index].id, products[index].name,
-                     quantity, unitPrice, discount, total);
+// Sleep until the log has records past the consumer's offset or the
+// timeout passes. Returns true if there is something to read (or the
+// offset was lost, which readChanges then reports).
+bool waitForChanges(int consumer, int timeoutMs) {
+    unique_lock<mutex> lock(mutationLogMutex);
+    chrono::steady_clock::time_point deadline =
+        chrono::steady_clock::now() + chrono::milliseconds(timeoutMs);
+
+    while (nextLsn - 1 <= changeConsumers[consumer].offset &&
+           changeConsumers[consumer].offset + 1 >= mutationLogBaseLsn) {
+        if (mutationLogChanged.wait_until(lock, deadline) == cv_status::timeout) {
+            return nextLsn - 1 > changeConsumers[consumer].offset;
+        }
+    }
+    return true;
+}
 
-    // Display invoice
-    clearScreen();
-    cout << "\n================================================================\n";
-    cout << "                         INVOICE                                \n";
-    cout << "================================================================\n";
-    cout << "Transaction ID: " << (nextTransactionId - 1) << "\n";
-    cout << "Date: " << getCurrentDate() << "  Time: " << getCurrentTime() << "\n";
-    cout << "----------------------------------------------------------------\n";
-    cout << left << setw(25) << "Product" << setw(10) << "Qty"
-         << setw(12) << "Unit Price" << "Amount\n";
-    cout << "----------------------------------------------------------------\n";
-    cout << left << setw(25) << products[index].name
-         << setw(10) << quantity
-         << "$" << setw(11) << fixed << setprecision(2) << unitPrice
-         << "$" << fixed << setprecision(2) << subtotal << "\n";
-    cout << "----------------------------------------------------------------\n";
-    cout << right << setw(47) << "Subtotal: $" << fixed << setprecision(2) << subtotal << "\n";
+// ---- Compact wire format -------------------------------------------
+// Each record is a run of varints: the LSN as a delta from the previous
+// record, the type, then the type's fields. Signed values are zigzag
+// encoded, money is sent in cents and strings are length-prefixed.
+void putVarint(vector<unsigned char>* out, unsigned long long value) {
+    while (value >= 0x80) {
+        out->push_back((unsigned char)(value | 0x80));
+        value >>= 7;
+    }
+    out->push_back((unsigned char)value);
+}
 
-    if (discount > 0) {
-        cout << right << setw(47) << "Discount (10%): -$" << fixed << setprecision(2) << discount << "\n";
-        printWarning("Bulk discount applied!");
+void putSigned(vector<unsigned char>* out, long long value) {
+    putVarint(out, ((unsigned long long)value << 1) ^ (unsigned long long)(value >> 63));
+}
+
+void putCents(vector<unsigned char>* out, double amount) {
+    putSigned(out, llround(amount * 100.0));
+}
+
+void putText(vector<unsigned char>* out, const string& text) {
+    putVarint(out, text.size());
+    out->insert(out->end(), text.begin(), text.end());
+}
+
+bool getVarint(const unsigned char** p, const unsigned char* end, unsigned long long* value) {
+    *value = 0;
+    for (int shift = 0; shift < 64 && *p < end; shift += 7) {
+        unsigned char byte = *(*p)++;
+        *value |= (unsigned long long)(byte & 0x7F) << shift;
+        if ((byte & 0x80) == 0) {
+            return true;
+        }
     }
+    return false;
+}
 
-    cout << right << setw(47) << "TOTAL: $" << fixed << setprecision(2) << total << "\n";
-    cout << "================================================================\n";
+bool getSigned(const unsigned char** p, const unsigned char* end, long long* value) {
+    unsigned long long raw;
+    if (!getVarint(p, end, &raw)) {
+        return false;
+    }
+    *value = (long long)(raw >> 1) ^ -(long long)(raw & 1);
+    return true;
+}
 
-    if (products[index].quantity <= MIN_STOCK_THRESHOLD) {
-        printWarning("Low stock alert for this product!");
+bool getInt(const unsigned char** p, const unsigned char* end, int* value) {
+    long long wide;
+    if (!getSigned(p, end, &wide)) {
+        return false;
     }
+    *value = (int)wide;
+    return true;
 }
 
-void viewTransactionHistory() {
-    if (transactionCount == 0) {
-        printError("No transactions recorded!");
-        return;
+bool getCents(const unsigned char** p, const unsigned char* end, double* amount) {
+    long long cents;
+    if (!getSigned(p, end, &cents)) {
+        return false;
     }
+    *amount = cents / 100.0;
+    return true;
+}
 
-    clearScreen();
-    printTableHeader("TRANSACTION HISTORY");
+bool getText(const unsigned char** p, const unsigned char* end, string* text) {
+    unsigned long long length;
+    if (!getVarint(p, end, &length) || length > (unsigned long long)(end - *p)) {
+        return false;
+    }
+    text->assign((const char*)*p, (size_t)length);
+    *p += length;
+    return true;
+}
 
-    cout << left << setw(8) << "Trans#" << setw(20) << "Product"
-         << setw(6) << "Qty" << setw(12) << "Unit Price"
-         << setw(12) << "Discount" << setw(12) << "Total"
-         << setw(12) << "Date" << "Time\n";
-    cout << "--------------------------------------------------------------------------------\n";
+// Append count records to out in the compact format
+void encodeChanges(const MutationRecord* records, int count, vector<unsigned char>* out) {
+    long long previousLsn = 0;
+    for (int i = 0; i < count; i++) {
+        const MutationRecord* r = &records[i];
+        putVarint(out, r->lsn - previousLsn);
+        putVarint(out, r->type);
+        previousLsn = r->lsn;
+
+        if (r->type == MUTATION_PRODUCT) {
+            putSigned(out, r->productIndex);
+            putSigned(out, r->productId);
+            putSigned(out, r->quantity);
+            putCents(out, r->price);
+            putVarint(out, r->active ? 1 : 0);
+            putText(out, r->name);
+            putText(out, r->category);
+        } else if (r->type == MUTATION_LOCATION_STOCK) {
+            putSigned(out, r->productIndex);
+            putSigned(out, r->productId);
+            putSigned(out, r->location);
+            putSigned(out, r->quantity);
+        } else if (r->type == MUTATION_TRANSACTION) {
+            putSigned(out, r->transactionId);
+            putSigned(out, r->productId);
+            putSigned(out, r->quantity);
+            putCents(out, r->price);
+            putCents(out, r->discount);
+            putCents(out, r->total);
+            putSigned(out, r->eventTime);
+            putText(out, r->name);
+            putText(out, r->date);
+            putText(out, r->time);
+        } else if (r->type == MUTATION_LOCATION_ADDED) {
+            putSigned(out, r->location);
+            putVarint(out, r->active ? 1 : 0);
+            putText(out, r->name);
+        } else if (r->type == MUTATION_RESERVED) {
+            putSigned(out, r->productIndex);
+            putSigned(out, r->productId);
+            putSigned(out, r->quantity);
+        }
+    }
+}
 
-    double totalRevenue = 0.0;
+// Decode a buffer written by encodeChanges; returns false if it is cut short
+bool decodeChanges(const unsigned char* data, size_t length, vector<MutationRecord>* records) {
+    const unsigned char* p = data;
+    const unsigned char* end = data + length;
+    long long lsn = 0;
+
+    while (p < end) {
+        MutationRecord r = MutationRecord();
+        unsigned long long delta, type, flag = 0;
+        if (!getVarint(&p, end, &delta) || !getVarint(&p, end, &type)) {
+            return false;
+        }
+        lsn += delta;
+        r.lsn = lsn;
+        r.type = (int)type;
+
+        bool ok = true;
+        if (r.type == MUTATION_PRODUCT) {
+            ok = getInt(&p, end, &r.productIndex) && getInt(&p, end, &r.productId) &&
+                 getInt(&p, end, &r.quantity) && getCents(&p, end, &r.price) &&
+                 getVarint(&p, end, &flag) && getText(&p, end, &r.name) &&
+                 getText(&p, end, &r.category);
+        } else if (r.type == MUTATION_LOCATION_STOCK) {
+            ok = getInt(&p, end, &r.productIndex) && getInt(&p, end, &r.productId) &&
+                 getInt(&p, end, &r.location) && getInt(&p, end, &r.quantity);
+        } else if (r.type == MUTATION_TRANSACTION) {
+            ok = getInt(&p, end, &r.transactionId) && getInt(&p, end, &r.productId) &&
+                 getInt(&p, end, &r.quantity) && getCents(&p, end, &r.price) &&
+                 getCents(&p, end, &r.discount) && getCents(&p, end, &r.total) &&
+                 getSigned(&p, end, &r.eventTime) &&
+                 getText(&p, end, &r.name) && getText(&p, end, &r.date) &&
+                 getText(&p, end, &r.time);
+        } else if (r.type == MUTATION_LOCATION_ADDED) {
+            ok = getInt(&p, end, &r.location) && getVarint(&p, end, &flag) &&
+                 getText(&p, end, &r.name);
+        } else if (r.type == MUTATION_RESERVED) {
+            ok = getInt(&p, end, &r.productIndex) && getInt(&p, end, &r.productId) &&
+                 getInt(&p, end, &r.quantity);
+        } else {
+            ok = false;
+        }
+        if (!ok) {
+            return false;
+        }
+        r.active = flag != 0;
+        records->push_back(r);
+    }
+    return true;
+}
 
-    for (int i = transactionCount - 1; i >= 0; i--) {
-        cout << left << setw(8) << transactions[i].transactionId
-             << setw(20) << transactions[i].productName
-             << setw(6) << transactions[i].quantity
-             << "$" << setw(11) << fixed << setprecision(2) << transactions[i].unitPrice
-             << "$" << setw(11) << fixed << setprecision(2) << transactions[i].discount
-             << "$" << setw(11) << fixed << setprecision(2) << transactions[i].totalPrice
-             << setw(12) << transactions[i].date
-             << transactions[i].time << "\n";
+// ---- File and FIFO sinks -------------------------------------------
+// A sink is a consumer whose batches are written to a file or a FIFO as
+// soon as they are logged, for a downstream process to tail. Each batch
+// is one frame as sent to replicas: a ReplicationFrame header (kind
+// FRAME_LOG_BATCH, lsn = the batch's last LSN) and the compact records.
+// A frame with stamp 0 holds the whole inventory instead and means "start
+// over from here"; it is written when a sink starts without a usable
+// offset, e.g. the first time or after this program restarts.
+//
+// The consumer is named after the sink's path and its committed offset is
+// rewritten to PATH.offset after every frame. Stopping a sink parks the
+// consumer, so starting it again in the same run resumes without a gap.
+// After a restart the in-memory log is gone; the LSN numbering then
+// carries on from the saved offset, so LSNs in a sink only ever increase.
+#ifndef _WIN32
+const int MAX_CHANGE_SINKS = 4;
+const int CHANGE_SINK_BATCH_SIZE = 512;
+const int CHANGE_SINK_WAIT_MS = 50;        // how often an idle sink checks for stop
+
+struct ChangeSink {
+    string path;
+    int consumer;
+    int fd;                 // frames to the file or FIFO
+    int offsetFd;           // PATH.offset
+    thread writer;
+    bool stopping;          // guarded by mutationLogMutex
+    atomic<bool> failed;    // the output went away
+    atomic<long long> committedLsn;
+};
 
-        totalRevenue += transactions[i].totalPrice;
+ChangeSink changeSinks[MAX_CHANGE_SINKS];
+int changeSinkCount = 0;
+
+// Offset saved by an earlier run, or -1 if there is none
+long long readSinkOffset(const string& path) {
+    FILE* in = fopen((path + ".offset").c_str(), "r");
+    if (in == NULL) {
+        return -1;
+    }
+    long long lsn = -1;
+    if (fscanf(in, "%lld", &lsn) != 1) {
+        lsn = -1;
     }
+    fclose(in);
+    return lsn;
+}
 
-    cout << "--------------------------------------------------------------------------------\n";
-    cout << right << setw(70) << "Total Revenue: $" << fixed << setprecision(2) << totalRevenue << "\n";
-    cout << "================================================================================\n";
+// Overwrite the offset file in place; fixed width, so no truncation needed
+bool saveSinkOffset(ChangeSink* sink, long long lsn) {
+    char text[24];
+    snprintf(text, sizeof(text), "%20lld\n", lsn);
+    if (pwrite(sink->offsetFd, text, 21, 0) != 21) {
+        return false;
+    }
+    sink->committedLsn = lsn;
+    return true;
 }
 
-// ============================================================
-// REPORTS & ANALYTICS
-// ============================================================
-void generateInventoryReport() {
+// Write the whole inventory as a stamp-0 frame and move the consumer to
+// it. With a saved offset past the log (a restart), LSNs continue from
+// there when the log is empty.
+bool writeSinkImage(ChangeSink* sink, long long savedLsn) {
+    vector<MutationRecord> image;
+    long long lsn;
+    {
+        lock_guard<mutex> writeLock(inventoryWriteMutex);
+        lock_guard<mutex> lock(mutationLogMutex);
+        if (savedLsn >= nextLsn && mutationLog.empty()) {
+            nextLsn = savedLsn + 1;
+            mutationLogBaseLsn = nextLsn;
+        }
+        lsn = nextLsn - 1;
+        buildInventoryImage(lsn, &image);
+        changeConsumers[sink->consumer].offset = lsn;
+        trimMutationLogForReaders();
+    }
+
+    vector<unsigned char> payload;
+    encodeChanges(image.empty() ? NULL : &image[0], (int)image.size(), &payload);
+    return sendReplicationFrame(sink->fd, FRAME_LOG_BATCH, lsn, 0, &payload) &&
+           saveSinkOffset(sink, lsn);
+}
+
+// Sink thread: wait for changes, write them as one frame, commit
+void runChangeSink(ChangeSink* sink) {
+    vector<MutationRecord> batch(CHANGE_SINK_BATCH_SIZE);
+    vector<unsigned char> payload;
+
+    while (true) {
+        bool more = waitForChanges(sink->consumer, CHANGE_SINK_WAIT_MS);
+        if (!more) {
+            lock_guard<mutex> lock(mutationLogMutex);
+            if (sink->stopping) {
+                return;
+            }
+            continue;
+        }
+
+        long long lastLsn;
+        int count = readChanges(sink->consumer, &batch[0], CHANGE_SINK_BATCH_SIZE, true, &lastLsn);
+        bool ok;
+        if (count == CHANGES_LOST) {
+            ok = writeSinkImage(sink, -1);
+        } else {
+            payload.clear();
+            encodeChanges(&batch[0], count, &payload);
+            ok = count == 0 ||
+                 sendReplicationFrame(sink->fd, FRAME_LOG_BATCH, lastLsn, batch[count - 1].loggedAtNs, &payload);
+            if (ok) {
+                commitChangeOffset(sink->consumer, lastLsn);
+                ok = saveSinkOffset(sink, lastLsn);
+            }
+        }
+        if (!ok) {
+            sink->failed = true;
+            return;
+        }
+    }
+}
+
+// Start streaming changes to path (a file, created if missing, or a FIFO
+// that a reader already has open). Returns false with a reason in *error.
+bool startChangeSink(const string& path, string* error) {
+    for (int s = 0; s < changeSinkCount; s++) {
+        if (changeSinks[s].path == path) {
+            *error = "A sink is already writing to " + path + ".";
+            return false;
+        }
+    }
+    if (changeSinkCount >= MAX_CHANGE_SINKS) {
+        *error = "At most " + to_string(MAX_CHANGE_SINKS) + " sinks can run at once.";
+        return false;
+    }
+    signal(SIGPIPE, SIG_IGN); // a reader that goes away must not take us down
+
+    // Non-blocking so a FIFO nobody reads fails at once instead of hanging
+    int fd = open(path.c_str(), O_WRONLY | O_APPEND | O_CREAT | O_NONBLOCK, 0644);
+    if (fd < 0) {
+        *error = errno == ENXIO ? "No reader has the FIFO " + path + " open."
+                                : "Could not open " + path + ": " + strerror(errno);
+        return false;
+    }
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) & ~O_NONBLOCK);
+    int offsetFd = open((path + ".offset").c_str(), O_RDWR | O_CREAT, 0644);
+    if (offsetFd < 0) {
+        close(fd);
+        *error = "Could not open " + path + ".offset: " + strerror(errno);
+        return false;
+    }
+
+    bool parked = false;
+    {
+        lock_guard<mutex> lock(mutationLogMutex);
+        for (int c = 0; c < changeConsumerCount; c++) {
+            parked = parked || (!changeConsumers[c].removed && changeConsumers[c].name == path);
+        }
+    }
+    int consumer = registerChangeConsumer(path);
+    if (consumer == -1) {
+        close(fd);
+        close(offsetFd);
+        *error = "No change feed consumer slot is free.";
+        return false;
+    }
+
+    ChangeSink* sink = &changeSinks[changeSinkCount];
+    sink->path = path;
+    sink->consumer = consumer;
+    sink->fd = fd;
+    sink->offsetFd = offsetFd;
+    sink->stopping = false;
+    sink->failed = false;
+
+    // A consumer parked earlier in this run resumes where it stopped;
+    // anything else starts from a fresh image
+    long long savedLsn = readSinkOffset(path);
+    bool resumed;
+    {
+        lock_guard<mutex> lock(mutationLogMutex);
+        resumed = parked && savedLsn == changeConsumers[consumer].offset &&
+                  savedLsn + 1 >= mutationLogBaseLsn;
+    }
+    sink->committedLsn = savedLsn;
+    if (!resumed && !writeSinkImage(sink, savedLsn)) {
+        unregisterChangeConsumer(consumer);
+        close(fd);
+        close(offsetFd);
+        *error = "Could not write to " + path + ".";
+        return false;
+    }
+
+    changeSinkCount++;
+    sink->writer = thread(runChangeSink, sink);
+    return true;
+}
+
+// Write out what is already logged and stop every sink. With keepOffsets
+// the consumers are parked and resume when their sinks start again;
+// otherwise they are removed and stop holding the log back.
+void stopChangeSinks(bool keepOffsets) {
+    {
+        lock_guard<mutex> lock(mutationLogMutex);
+        for (int s = 0; s < changeSinkCount; s++) {
+            changeSinks[s].stopping = true;
+        }
+    }
+    mutationLogChanged.notify_all();
+
+    for (int s = 0; s < changeSinkCount; s++) {
+        ChangeSink* sink = &changeSinks[s];
+        sink->writer.join();
+        close(sink->fd);
+        close(sink->offsetFd);
+        if (keepOffsets) {
+            unregisterChangeConsumer(sink->consumer);
+        } else {
+            removeChangeConsumer(sink->consumer);
+        }
+    }
+    changeSinkCount = 0;
+}
+
+// Print the records in a sink file (or, for a FIFO, as they arrive), one
+// change per line; a downstream reader in its simplest form
+bool followChangeSink(const char* path) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        printError(string("Could not open ") + path + ": " + strerror(errno));
+        return false;
+    }
+
+    ReplicationFrame frame;
+    vector<unsigned char> payload;
+    vector<MutationRecord> records;
+    while (readReplicationFrame(fd, &frame, &payload) && decodePayload(&payload, &records)) {
+        if (frame.stamp == 0) {
+            printf("-- inventory image at LSN %lld (%d records)\n", frame.lsn, (int)records.size());
+            continue;
+        }
+        for (size_t r = 0; r < records.size(); r++) {
+            const MutationRecord* record = &records[r];
+            if (record->type == MUTATION_PRODUCT) {
+                printf("%lld product %d \"%s\" qty %d price %.2f%s\n", record->lsn, record->productId,
+                       record->name.c_str(), record->quantity, record->price,
+                       record->active ? "" : " deleted");
+            } else if (record->type == MUTATION_TRANSACTION) {
+                printf("%lld sale #%d product %d qty %d total %.2f\n", record->lsn,
+                       record->transactionId, record->productId, record->quantity, record->total);
+            } else if (record->type == MUTATION_LOCATION_STOCK) {
+                printf("%lld stock product %d location %d qty %d\n", record->lsn,
+                       record->productId, record->location + 1, record->quantity);
+            } else if (record->type == MUTATION_RESERVED) {
+                printf("%lld reserved product %d qty %d\n", record->lsn, record->productId,
+                       record->quantity);
+            } else if (record->type == MUTATION_LOCATION_ADDED) {
+                printf("%lld location %d \"%s\"\n", record->lsn, record->location + 1,
+                       record->name.c_str());
+            }
+        }
+        fflush(stdout);
+    }
+    close(fd);
+    return true;
+}
+
+void manageChangeSinks() {
     clearScreen();
-    printTableHeader("INVENTORY REPORT");
+    printTableHeader("CHANGE FEED");
 
-    int totalProducts = 0;
-    int lowStockProducts = 0;
-    int outOfStockProducts = 0;
-    double totalInventoryValue = 0.0;
+    cout << "Changes to products, stock, holds and sales are written to each sink\n";
+    cout << "as they happen. Read one with \"<this program> --follow-changes <path>\".\n\n";
 
-    // Use pointer-based function to get statistics
-    getProductStatistics(&totalProducts, &lowStockProducts, &outOfStockProducts, &totalInventoryValue);
+    if (changeSinkCount == 0) {
+        cout << "No sinks running.\n";
+    } else {
+        long long logged;
+        {
+            lock_guard<mutex> lock(mutationLogMutex);
+            logged = nextLsn - 1;
+        }
+        cout << left << setw(4) << "#" << setw(30) << "Path" << setw(12) << "Committed"
+             << setw(10) << "Behind" << "Status\n";
+        cout << "----------------------------------------------------------------\n";
+        for (int s = 0; s < changeSinkCount; s++) {
+            long long committed = changeSinks[s].committedLsn;
+            cout << left << setw(4) << s + 1 << setw(30) << changeSinks[s].path
+                 << setw(12) << committed << setw(10) << logged - committed
+                 << (changeSinks[s].failed ? "FAILED" : "OK") << "\n";
+        }
+    }
+    cout << "----------------------------------------------------------------\n";
+    cout << "  1. Start Sink (file or FIFO)\n";
+    cout << "  2. Stop All Sinks (offsets kept)\n";
+    cout << "  3. Stop All Sinks and Forget Offsets\n";
+    cout << "  0. Back\n";
+    cout << "Enter your choice: ";
 
-    cout << "Total Products:        " << totalProducts << "\n";
-    cout << "Low Stock Products:    " << lowStockProducts << "\n";
-    cout << "Out of Stock Products: " << outOfStockProducts << "\n";
-    cout << "Total Inventory Value: $" << fixed << setprecision(2) << totalInventoryValue << "\n";
-    cout << "Total Categories:      " << categoryCount << "\n";
-    cout << "Total Suppliers:       " << supplierCount << "\n";
-    cout << "Total Transactions:    " << transactionCount << "\n";
-    cout << "================================================================\n";
+    int choice;
+    if (!(cin >> choice) || choice < 0 || choice > 3) {
+        clearInputBuffer();
+        printError("Invalid choice!");
+        return;
+    }
+
+    if (choice == 1) {
+        string path, error;
+        clearInputBuffer();
+        cout << "Enter sink path: ";
+        getline(cin, path);
+        if (path.empty() || !startChangeSink(path, &error)) {
+            printError(path.empty() ? "Path cannot be empty!" : error);
+            return;
+        }
+        printSuccess("Changes are being written to " + path + ".");
+    } else if (choice == 2 || choice == 3) {
+        stopChangeSinks(choice == 2);
+        printSuccess(choice == 2 ? "Sinks stopped; they resume from their offsets."
+                                 : "Sinks stopped and their offsets forgotten.");
+    }
+}
+#else
+bool followChangeSink(const char*) {
+    printError("Change feed sinks are not available on Windows.");
+    return false;
+}
+
+void stopChangeSinks(bool) {
+}
+
+void manageChangeSinks() {
+    clearScreen();
+    printTableHeader("CHANGE FEED");
+    printError("Change feed sinks are not available on Windows.");
 }
+#endif
 
 // ============================================================
 // SAMPLE DATA
@@ -901,6 +8508,28 @@ void loadSampleData() {
     // Add sample suppliers
     suppliers[supplierCount++] = {"TechSupply Co", "tech@supply.com", true};
     suppliers[supplierCount++] = {"Fashion World", "contact@fashion.com", true};
+
+    // Sourcing links: supplier, product slot, unit cost, lead time in days
+    setSourcingEdge(0, 0, 720.00, 14);
+    setSourcingEdge(0, 1, 11.50, 5);
+    setSourcingEdge(0, 2, 31.00, 5);
+    setSourcingEdge(1, 3, 6.25, 10);
+    setSourcingEdge(1, 4, 21.75, 10);
+    compactSourcingGraph();
+
+    // Add sample locations; stock starts at the main warehouse
+    locations[locationCount++] = {"Main Warehouse", "Industrial Park, Unit 4", true};
+    locations[locationCount++] = {"Downtown Store", "12 Market Street", true};
+
+    for (int i = 0; i < productCount; i++) {
+        initProductStock(i, products[i].quantity);
+    }
+    locationStock[3][DEFAULT_LOCATION] -= 30; // T-Shirt: 30 units on the shop floor
+    locationStock[3][1] += 30;
+
+    lock_guard<mutex> lock(inventoryWriteMutex);
+    recomputeLocationTotals();
+    rebuildSnapshot();
 }
 
 // ============================================================
@@ -936,13 +8565,80 @@ void displayMainMenu() {
     cout << "   14. Inventory Report\n";
     cout << "   15. Check Low Stock Alerts\n";
     cout << "----------------------------------------------------------------\n";
+    cout << "  DATA EXCHANGE\n";
+    cout << "   16. Export Data (CSV/NDJSON)\n";
+    cout << "   17. Bulk Import Products (CSV)\n";
+    cout << "----------------------------------------------------------------\n";
+    cout << "  LOCATION MANAGEMENT\n";
+    cout << "   18. Add Location\n";
+    cout << "   19. View All Locations\n";
+    cout << "   20. View Product Stock by Location\n";
+    cout << "   21. Transfer Stock Between Locations\n";
+    cout << "----------------------------------------------------------------\n";
+    cout << "  FORECASTING & BROWSING\n";
+    cout << "   22. Demand Forecast\n";
+    cout << "   23. Browse Products by Price/Quantity\n";
+    cout << "----------------------------------------------------------------\n";
+    cout << "  SOURCING\n";
+    cout << "   24. Link Product to Supplier\n";
+    cout << "   25. View Products by Supplier\n";
+    cout << "   26. View Suppliers for Product\n";
+    cout << "----------------------------------------------------------------\n";
+    cout << "  INVOICES & RESERVATIONS\n";
+    cout << "   27. Invoice Output (terminal/spool file)\n";
+    cout << "   28. Reserve Stock\n";
+    cout << "   29. Confirm Reservation\n";
+    cout << "   30. Cancel Reservation\n";
+    cout << "----------------------------------------------------------------\n";
+    cout << "  QUERIES & HISTORY\n";
+    cout << "   31. Run Query\n";
+    cout << "   32. Purchase Request Journal\n";
+    cout << "   33. Product Change History\n";
+    cout << "----------------------------------------------------------------\n";
+    cout << "  REPLICATION\n";
+    cout << "   34. Replicas (attach/status/detach)\n";
+    cout << "   35. Change Feed (stream changes to a file or FIFO)\n";
+    cout << "----------------------------------------------------------------\n";
     cout << "    0. Exit\n";
     cout << "================================================================\n";
     cout << "Enter your choice: ";
 }
 
-int main() {
-    loadSampleData();
+// The benchmark build includes this file with INVENTORY_NO_MAIN defined
+#ifndef INVENTORY_NO_MAIN
+int main(int argc, char** argv) {
+    // "--numa MODE" may come first; it matters on multi-socket machines,
+    // mostly together with --shards
+    if (argc >= 3 && string(argv[1]) == "--numa") {
+        NumaMode mode;
+        if (!parseNumaMode(argv[2], &mode)) {
+            printError("Unknown NUMA mode! Use first-touch, interleave or partitioned.");
+            return 1;
+        }
+        if (!setNumaMode(mode)) {
+            printWarning("NUMA placement was refused; running without it.");
+        }
+        argc -= 2;
+        argv += 2;
+    }
+
+    // "--replica PATH" follows a primary instead of loading sample data,
+    // and becomes the primary if that one is lost
+    if (argc == 3 && string(argv[1]) == "--replica") {
+        if (!followPrimary(argv[2])) {
+            return 0;
+        }
+    } else if (argc == 3 && string(argv[1]) == "--follow-changes") {
+        // A downstream reader: print a change feed sink and exit
+        return followChangeSink(argv[2]) ? 0 : 1;
+    } else if (argc == 3 && string(argv[1]) == "--shards") {
+        // Forked before the invoice renderer starts
+        loadSampleData();
+        return runShardedMode(atoi(argv[2]));
+    } else {
+        loadSampleData();
+    }
+    startInvoiceRenderer(NULL);
 
     int choice;
 
@@ -1036,6 +8732,106 @@ int main() {
                 pauseScreen();
                 clearScreen();
                 break;
+            case 16:
+                exportData();
+                pauseScreen();
+                clearScreen();
+                break;
+            case 17:
+                importProducts();
+                pauseScreen();
+                clearScreen();
+                break;
+            case 18:
+                addLocation();
+                pauseScreen();
+                clearScreen();
+                break;
+            case 19:
+                displayLocationsTable();
+                pauseScreen();
+                clearScreen();
+                break;
+            case 20:
+                viewProductLocations();
+                pauseScreen();
+                clearScreen();
+                break;
+            case 21:
+                transferProductStock();
+                pauseScreen();
+                clearScreen();
+                break;
+            case 22:
+                viewDemandForecast();
+                pauseScreen();
+                clearScreen();
+                break;
+            case 23:
+                browseProducts();
+                pauseScreen();
+                clearScreen();
+                break;
+            case 24:
+                linkProductSupplier();
+                pauseScreen();
+                clearScreen();
+                break;
+            case 25:
+                viewSupplierProducts();
+                pauseScreen();
+                clearScreen();
+                break;
+            case 26:
+                viewProductSuppliers();
+                pauseScreen();
+                clearScreen();
+                break;
+            case 27:
+                configureInvoiceOutput();
+                pauseScreen();
+                clearScreen();
+                break;
+            case 28:
+                reserveProduct();
+                pauseScreen();
+                clearScreen();
+                break;
+            case 29:
+                confirmProductReservation();
+                pauseScreen();
+                clearScreen();
+                break;
+            case 30:
+                cancelProductReservation();
+                pauseScreen();
+                clearScreen();
+                break;
+            case 31:
+                runQueryPrompt();
+                pauseScreen();
+                clearScreen();
+                break;
+            case 32:
+                configurePurchaseJournal();
+                pauseScreen();
+                clearScreen();
+                break;
+            case 33:
+                viewProductHistory();
+                pauseScreen();
+                clearScreen();
+                break;
+            case 34:
+                manageReplication();
+                pauseScreen();
+                clearScreen();
+                break;
+            case 35:
+                manageChangeSinks();
+                pauseScreen();
+                clearScreen();
+                break;
             case 0:
                 clearScreen();
                 cout << "\n================================================================\n";
@@ -1051,5 +8847,10 @@ int main() {
 
     } while (choice != 0);
 
+    stopChangeSinks(true);
+    stopReplicas();
+    stopInvoiceRenderer();
+    closePurchaseJournal();
     return 0;
 }
+#endif
@@ -0,0 +1,1336 @@
+// ============================================================
+// BENCHMARK SUITE
+// ============================================================
+// Builds the inventory system without its menu and times the core paths
+// against a synthetic catalog. Results are printed as one JSON object per
+// line so runs can be diffed between releases.
+//
+//   g++ -std=c++11 -O2 -pthread benchmark.cpp -o benchmark
+//   ./benchmark --products 10000 --iterations 20000 --seed 42
+#define INVENTORY_NO_MAIN
+#define INVENTORY_MAX_ITEMS 100000
+#define INVENTORY_MAX_TRANSACTIONS 100000
+#define INVENTORY_MAX_RESERVATIONS 2000000
+#define INVENTORY_MAX_PURCHASE_REQUESTS 1000000
+#include "Inventory_management_system.cpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <random>
+#include <sstream>
+#include <vector>
+
+// ============================================================
+// BENCHMARK CONFIGURATION
+// ============================================================
+struct BenchConfig {
+    int productTotal;
+    int iterations;
+    unsigned seed;
+    double zipfExponent;
+    int locationTotal;
+    string only;
+};
+
+// Stream buffer that swallows everything (used to silence table output)
+class NullBuffer : public streambuf {
+protected:
+    int overflow(int c) { return c; }
+    streamsize xsputn(const char*, streamsize n) { return n; }
+};
+
+// ============================================================
+// SYNTHETIC WORKLOAD GENERATOR
+// ============================================================
+struct CategoryProfile {
+    const char* name;
+    const char* description;
+    double weight;       // share of the catalog
+    double medianPrice;  // centre of the log-normal price curve
+};
+
+const CategoryProfile CATEGORY_PROFILES[] = {
+    {"Electronics", "Electronic devices and accessories", 0.18, 79.0},
+    {"Clothing", "Apparel and fashion items", 0.20, 24.0},
+    {"Food", "Food and beverages", 0.16, 4.5},
+    {"Home", "Home and kitchen goods", 0.12, 32.0},
+    {"Toys", "Toys and games", 0.08, 18.0},
+    {"Books", "Books and magazines", 0.08, 14.0},
+    {"Sports", "Sports and outdoor equipment", 0.07, 45.0},
+    {"Beauty", "Beauty and personal care", 0.06, 12.0},
+    {"Office", "Office supplies", 0.05, 9.0}
+};
+const int CATEGORY_PROFILE_COUNT = sizeof(CATEGORY_PROFILES) / sizeof(CATEGORY_PROFILES[0]);
+
+const char* NAME_ADJECTIVES[] = {
+    "Classic", "Compact", "Deluxe", "Eco", "Essential", "Premium", "Pro",
+    "Smart", "Ultra", "Vintage", "Wireless", "Heavy-Duty"
+};
+const char* NAME_NOUNS[] = {
+    "Lamp", "Kettle", "Jacket", "Speaker", "Notebook", "Backpack", "Bottle",
+    "Charger", "Blender", "Sneakers", "Puzzle", "Headphones", "Mug", "Chair"
+};
+const int NAME_ADJECTIVE_COUNT = sizeof(NAME_ADJECTIVES) / sizeof(NAME_ADJECTIVES[0]);
+const int NAME_NOUN_COUNT = sizeof(NAME_NOUNS) / sizeof(NAME_NOUNS[0]);
+
+// Reset every global store to empty
+void resetInventory() {
+    productCount = 0;
+    categoryCount = 0;
+    supplierCount = 0;
+    locationCount = 0;
+    transactionCount = 0;
+    nextTransactionId = 1;
+
+    lock_guard<mutex> lock(inventoryWriteMutex);
+    rebuildSnapshot();
+}
+
+// Fill the catalog with productTotal products. Category sizes follow the
+// profile weights, prices are log-normal around each category median and
+// roughly one product in ten starts at or below the low stock threshold.
+void generateSyntheticCatalog(int productTotal, int locationTotal, mt19937* rng) {
+    resetInventory();
+
+    for (int l = 0; l < locationTotal && l < MAX_LOCATIONS; l++) {
+        ostringstream name;
+        name << (l == 0 ? "Warehouse " : "Store ") << (l + 1);
+        locations[locationCount++] = {name.str(), "Synthetic", true};
+    }
+    uniform_int_distribution<int> pickLocation(0, locationCount - 1);
+
+    vector<double> weights;
+    for (int c = 0; c < CATEGORY_PROFILE_COUNT; c++) {
+        categories[categoryCount++] = {CATEGORY_PROFILES[c].name,
+                                       CATEGORY_PROFILES[c].description, true};
+        weights.push_back(CATEGORY_PROFILES[c].weight);
+    }
+
+    suppliers[supplierCount++] = {"TechSupply Co", "tech@supply.com", true};
+    suppliers[supplierCount++] = {"Fashion World", "contact@fashion.com", true};
+
+    discrete_distribution<int> pickCategory(weights.begin(), weights.end());
+    normal_distribution<double> priceNoise(0.0, 0.6);
+    uniform_int_distribution<int> pickAdjective(0, NAME_ADJECTIVE_COUNT - 1);
+    uniform_int_distribution<int> pickNoun(0, NAME_NOUN_COUNT - 1);
+    uniform_int_distribution<int> lowStock(0, MIN_STOCK_THRESHOLD);
+    uniform_int_distribution<int> normalStock(MIN_STOCK_THRESHOLD + 1, 500);
+    uniform_real_distribution<double> unit(0.0, 1.0);
+
+    for (int i = 0; i < productTotal && productCount < MAX_ITEMS; i++) {
+        const CategoryProfile& profile = CATEGORY_PROFILES[pickCategory(*rng)];
+
+        ostringstream name;
+        name << NAME_ADJECTIVES[pickAdjective(*rng)] << " "
+             << NAME_NOUNS[pickNoun(*rng)] << " " << (i + 1);
+
+        // Log-normal price rounded to a .99 ending
+        double price = profile.medianPrice * exp(priceNoise(*rng));
+        price = floor(price) + 0.99;
+
+        int quantity = unit(*rng) < 0.1 ? lowStock(*rng) : normalStock(*rng);
+
+        products[productCount] = {i + 1, name.str(), profile.name, quantity, price, true};
+
+        // Half the units stay in the warehouse, the rest go to one store
+        initProductStock(productCount, quantity);
+        int store = pickLocation(*rng);
+        locationStock[productCount][DEFAULT_LOCATION] -= quantity / 2;
+        locationStock[productCount][store] += quantity / 2;
+        productCount++;
+    }
+
+    lock_guard<mutex> lock(inventoryWriteMutex);
+    recomputeLocationTotals();
+    rebuildSnapshot();
+}
+
+// Zipfian sampler over ranks 0..n-1, mapped to a shuffled product order so
+// the popular items are spread across the catalog instead of sitting first.
+struct ZipfSampler {
+    vector<double> cumulative;
+    vector<int> rankToIndex;
+};
+
+void initZipfSampler(ZipfSampler* sampler, int n, double exponent, mt19937* rng) {
+    sampler->cumulative.resize(n);
+    sampler->rankToIndex.resize(n);
+
+    double sum = 0.0;
+    for (int rank = 0; rank < n; rank++) {
+        sum += 1.0 / pow(rank + 1.0, exponent);
+        sampler->cumulative[rank] = sum;
+        sampler->rankToIndex[rank] = rank;
+    }
+    for (int rank = 0; rank < n; rank++) {
+        sampler->cumulative[rank] /= sum;
+    }
+    shuffle(sampler->rankToIndex.begin(), sampler->rankToIndex.end(), *rng);
+}
+
+int sampleZipf(const ZipfSampler* sampler, mt19937* rng) {
+    double u = uniform_real_distribution<double>(0.0, 1.0)(*rng);
+    int rank = lower_bound(sampler->cumulative.begin(), sampler->cumulative.end(), u)
+               - sampler->cumulative.begin();
+    if (rank >= (int)sampler->cumulative.size()) {
+        rank = sampler->cumulative.size() - 1;
+    }
+    return sampler->rankToIndex[rank];
+}
+
+// Build a purchase history following the same popularity curve
+void generateSyntheticSales(int saleTotal, const ZipfSampler* sampler, mt19937* rng) {
+    uniform_int_distribution<int> pickQuantity(1, 3);
+    double unitPrice, subtotal, discount, total;
+
+    for (int i = 0; i < saleTotal && transactionCount < MAX_TRANSACTIONS; i++) {
+        int index = sampleZipf(sampler, rng);
+        if (products[index].quantity < MIN_STOCK_THRESHOLD + 3) {
+            restockProduct(index, DEFAULT_LOCATION, 100); // restock popular items
+        }
+        commitPurchase(index, pickQuantity(*rng), &unitPrice, &subtotal, &discount, &total, NULL, NULL);
+    }
+}
+
+// ============================================================
+// TIMING AND RESULT OUTPUT
+// ============================================================
+typedef chrono::steady_clock BenchClock;
+
+long long elapsedNs(BenchClock::time_point start, BenchClock::time_point end) {
+    return chrono::duration_cast<chrono::nanoseconds>(end - start).count();
+}
+
+// Print one result line; latencies are per-operation samples in ns
+void reportResult(const BenchConfig* config, string name, vector<long long>* latencies) {
+    if (latencies->empty()) {
+        return;
+    }
+
+    long long total = 0;
+    for (size_t i = 0; i < latencies->size(); i++) {
+        total += (*latencies)[i];
+    }
+    sort(latencies->begin(), latencies->end());
+
+    size_t n = latencies->size();
+    double perOp = (double)total / n;
+
+    cout << "{\"benchmark\":\"" << name << "\""
+         << ",\"products\":" << productCount
+         << ",\"transactions\":" << transactionCount
+         << ",\"iterations\":" << n
+         << ",\"seed\":" << config->seed
+         << ",\"total_ns\":" << total
+         << ",\"ns_per_op\":" << fixed << setprecision(1) << perOp
+         << ",\"ops_per_sec\":" << fixed << setprecision(0) << (perOp > 0 ? 1e9 / perOp : 0.0)
+         << ",\"p50_ns\":" << (*latencies)[n / 2]
+         << ",\"p99_ns\":" << (*latencies)[min(n - 1, n * 99 / 100)]
+         << ",\"max_ns\":" << (*latencies)[n - 1]
+         << "}\n";
+    cout.flush();
+}
+
+// Print one result line for work that is only timed as a whole (a batch
+// or a single sweep), so there are no per-operation samples to take
+// percentiles of: just the mean cost per operation
+void reportMean(const BenchConfig* config, string name, long long totalNs, long long operations) {
+    if (operations <= 0) {
+        return;
+    }
+    double perOp = (double)totalNs / operations;
+
+    cout << "{\"benchmark\":\"" << name << "\""
+         << ",\"products\":" << productCount
+         << ",\"transactions\":" << transactionCount
+         << ",\"iterations\":" << operations
+         << ",\"seed\":" << config->seed
+         << ",\"total_ns\":" << totalNs
+         << ",\"mean_ns\":" << fixed << setprecision(1) << perOp
+         << ",\"ops_per_sec\":" << fixed << setprecision(0) << (perOp > 0 ? 1e9 / perOp : 0.0)
+         << "}\n";
+    cout.flush();
+}
+
+bool shouldRun(const BenchConfig* config, string name) {
+    return config->only.empty() || name.find(config->only) != string::npos;
+}
+
+// ============================================================
+// BENCHMARK CASES
+// ============================================================
+void benchLookupById(const BenchConfig* config, const ZipfSampler* sampler, mt19937* rng) {
+    vector<long long> latencies;
+    volatile int sink = 0;
+
+    for (int i = 0; i < config->iterations; i++) {
+        int id = products[sampleZipf(sampler, rng)].id;
+        BenchClock::time_point start = BenchClock::now();
+        sink = findProductById(id);
+        latencies.push_back(elapsedNs(start, BenchClock::now()));
+    }
+    (void)sink;
+    reportResult(config, "lookup_by_id", &latencies);
+}
+
+void benchLookupByName(const BenchConfig* config, const ZipfSampler* sampler, mt19937* rng) {
+    vector<long long> latencies;
+    volatile int sink = 0;
+
+    for (int i = 0; i < config->iterations; i++) {
+        string name = products[sampleZipf(sampler, rng)].name;
+        BenchClock::time_point start = BenchClock::now();
+        sink = findProductByName(name);
+        latencies.push_back(elapsedNs(start, BenchClock::now()));
+    }
+    (void)sink;
+    reportResult(config, "lookup_by_name", &latencies);
+}
+
+void benchPurchase(const BenchConfig* config, const ZipfSampler* sampler, mt19937* rng,
+                   string name) {
+    vector<long long> latencies;
+    uniform_int_distribution<int> pickQuantity(1, 6);
+    double unitPrice, subtotal, discount, total;
+
+    for (int i = 0; i < config->iterations; i++) {
+        int index = sampleZipf(sampler, rng);
+        int quantity = pickQuantity(*rng);
+        if (products[index].quantity < quantity) {
+            restockProduct(index, DEFAULT_LOCATION, 1000);
+        }
+        if (transactionCount >= MAX_TRANSACTIONS) {
+            transactionCount = 0;
+        }
+
+        BenchClock::time_point start = BenchClock::now();
+        commitPurchase(index, quantity, &unitPrice, &subtotal, &discount, &total, NULL, NULL);
+        latencies.push_back(elapsedNs(start, BenchClock::now()));
+    }
+    reportResult(config, name, &latencies);
+}
+
+// Purchases carrying a request ID: first attempts (lookup miss, sale and
+// cache insert), retries answered from the cache, and first attempts with
+// the journal file open. Compare with purchase_commit for the overhead.
+void benchPurchaseRequests(const BenchConfig* config, const ZipfSampler* sampler, mt19937* rng) {
+    vector<long long> newLatencies, retryLatencies, journalLatencies;
+    vector<int> indexes, quantities;
+    uniform_int_distribution<int> pickQuantity(1, 6);
+    char requestId[32];
+    clearPurchaseRequests();
+
+    for (int i = 0; i < config->iterations; i++) {
+        int index = sampleZipf(sampler, rng);
+        int quantity = pickQuantity(*rng);
+        if (products[index].quantity < quantity) {
+            restockProduct(index, DEFAULT_LOCATION, 1000);
+        }
+        if (transactionCount >= MAX_TRANSACTIONS) {
+            transactionCount = 0;
+        }
+        snprintf(requestId, sizeof(requestId), "pos-%08d", i);
+
+        BenchClock::time_point start = BenchClock::now();
+        commitPurchaseRequest(requestId, index, quantity, NULL);
+        newLatencies.push_back(elapsedNs(start, BenchClock::now()));
+        indexes.push_back(index);
+        quantities.push_back(quantity);
+    }
+
+    uniform_int_distribution<int> pickEarlier(0, config->iterations - 1);
+    for (int i = 0; i < config->iterations; i++) {
+        int earlier = pickEarlier(*rng);
+        snprintf(requestId, sizeof(requestId), "pos-%08d", earlier);
+
+        BenchClock::time_point start = BenchClock::now();
+        commitPurchaseRequest(requestId, indexes[earlier], quantities[earlier], NULL);
+        retryLatencies.push_back(elapsedNs(start, BenchClock::now()));
+    }
+
+    int loaded;
+    const char* journalPath = "benchmark_requests.journal";
+    if (openPurchaseJournal(journalPath, &loaded)) {
+        for (int i = 0; i < config->iterations; i++) {
+            int index = sampleZipf(sampler, rng);
+            if (products[index].quantity < 1) {
+                restockProduct(index, DEFAULT_LOCATION, 1000);
+            }
+            if (transactionCount >= MAX_TRANSACTIONS) {
+                transactionCount = 0;
+            }
+            snprintf(requestId, sizeof(requestId), "pos-j-%08d", i);
+
+            BenchClock::time_point start = BenchClock::now();
+            commitPurchaseRequest(requestId, index, 1, NULL);
+            journalLatencies.push_back(elapsedNs(start, BenchClock::now()));
+        }
+        closePurchaseJournal();
+        remove(journalPath);
+    }
+    clearPurchaseRequests();
+
+    reportResult(config, "purchase_request_new", &newLatencies);
+    reportResult(config, "purchase_request_retry", &retryLatencies);
+    reportResult(config, "purchase_request_journaled", &journalLatencies);
+}
+
+// Reservations with a million holds outstanding: placing a hold, checking
+// availability, cancelling and confirming, then expiring all of them
+void benchReservations(const BenchConfig* config, const ZipfSampler* sampler, mt19937* rng) {
+    const int OUTSTANDING = min(1000000, MAX_RESERVATIONS / 2);
+    uniform_int_distribution<int> pickTtl(60, 1800);
+
+    for (int i = 0; i < productCount; i++) {
+        restockProduct(i, DEFAULT_LOCATION, 1000000); // plenty to hold
+    }
+    for (int i = 0; i < OUTSTANDING; i++) {
+        reserveStock(sampleZipf(sampler, rng), 1, pickTtl(*rng));
+    }
+
+    vector<long long> reserveLatencies, availableLatencies, cancelLatencies, confirmLatencies;
+    double unitPrice, subtotal, discount, total;
+    int index, quantity;
+    volatile int sink = 0;
+    for (int i = 0; i < config->iterations; i++) {
+        int product = sampleZipf(sampler, rng);
+        if (transactionCount >= MAX_TRANSACTIONS) {
+            transactionCount = 0;
+        }
+
+        BenchClock::time_point start = BenchClock::now();
+        long long handle = reserveStock(product, 1, pickTtl(*rng));
+        BenchClock::time_point afterReserve = BenchClock::now();
+        sink += getAvailableStock(product);
+        BenchClock::time_point afterAvailable = BenchClock::now();
+        if (i % 2 == 0) {
+            cancelReservation(handle);
+        } else {
+            confirmReservation(handle, &index, &quantity, &unitPrice, &subtotal, &discount, &total, NULL);
+        }
+        BenchClock::time_point end = BenchClock::now();
+
+        reserveLatencies.push_back(elapsedNs(start, afterReserve));
+        availableLatencies.push_back(elapsedNs(afterReserve, afterAvailable));
+        (i % 2 == 0 ? cancelLatencies : confirmLatencies).push_back(elapsedNs(afterAvailable, end));
+    }
+    reportResult(config, "reservation_reserve", &reserveLatencies);
+    reportResult(config, "reservation_available", &availableLatencies);
+    reportResult(config, "reservation_cancel", &cancelLatencies);
+    reportResult(config, "reservation_confirm", &confirmLatencies);
+
+    // Expire everything by moving the wheel 31 minutes ahead; one sweep,
+    // so only the mean per hold is known
+    int outstanding = activeReservations;
+    long long elapsed;
+    {
+        lock_guard<mutex> lock(inventoryWriteMutex);
+        BenchClock::time_point start = BenchClock::now();
+        advanceReservationWheel(wheelTick + 1860LL * 1000 / RESERVATION_TICK_MS);
+        elapsed = elapsedNs(start, BenchClock::now());
+    }
+    reportMean(config, "reservation_expiry_per_hold", elapsed, outstanding);
+}
+
+void benchTransfer(const BenchConfig* config, const ZipfSampler* sampler, mt19937* rng) {
+    if (locationCount < 2) {
+        return;
+    }
+
+    vector<long long> latencies;
+    uniform_int_distribution<int> pickLocation(0, locationCount - 1);
+
+    for (int i = 0; i < config->iterations; i++) {
+        int index = sampleZipf(sampler, rng);
+        int from = chooseFulfillmentLocation(index, 1);
+        if (from == -1) {
+            restockProduct(index, DEFAULT_LOCATION, 100);
+            from = DEFAULT_LOCATION;
+        }
+        int to = (from + 1 + pickLocation(*rng) % (locationCount - 1)) % locationCount;
+
+        BenchClock::time_point start = BenchClock::now();
+        transferStock(index, from, to, 1);
+        latencies.push_back(elapsedNs(start, BenchClock::now()));
+    }
+    reportResult(config, "transfer_stock", &latencies);
+}
+
+// Change feed tail: wait, read a coalesced batch, encode it, commit
+void runChangeConsumer(int consumer, volatile bool* stop, vector<long long>* latencies,
+                       long long* encodedBytes, long long* records) {
+    vector<MutationRecord> batch(1024);
+    vector<unsigned char> encoded;
+    vector<MutationRecord> decoded;
+
+    while (true) {
+        bool more = waitForChanges(consumer, 10);
+        if (!more && *stop) {
+            break;
+        }
+        long long lastLsn;
+        int count = readChanges(consumer, &batch[0], batch.size(), true, &lastLsn);
+        if (count == CHANGES_LOST) {
+            cerr << "change feed offset lost\n";
+            resetChangeOffset(consumer);
+            continue;
+        }
+        long long now = steadyNowNs();
+        for (int i = 0; i < count; i++) {
+            latencies->push_back(now - batch[i].loggedAtNs);
+        }
+
+        encoded.clear();
+        decoded.clear();
+        encodeChanges(&batch[0], count, &encoded);
+        if (!decodeChanges(encoded.empty() ? NULL : &encoded[0], encoded.size(), &decoded) ||
+            (int)decoded.size() != count) {
+            cerr << "change feed round-trip failed\n";
+        }
+        *encodedBytes += encoded.size();
+        *records += count;
+        commitChangeOffset(consumer, lastLsn);
+    }
+}
+
+// One purchase at a time, each waited for until its last record is
+// committed: the hand-off from writer to tail, without the queueing of
+// cdc_delivery (where, on a single core, the tail only runs when the
+// purchase loop is preempted). cdc_delivery_paced is measured by the tail
+// in-process; cdc_sink_delivery is from the sale to its frame and offset
+// being written by a file sink.
+void benchChangeFeedPaced(const BenchConfig* config, const ZipfSampler* sampler, mt19937* rng) {
+    int iterations = min(config->iterations, 5000);
+    double unitPrice, subtotal, discount, total;
+
+    int consumer = registerChangeConsumer("benchmark_paced");
+    if (consumer == -1) {
+        return;
+    }
+    volatile bool stop = false;
+    vector<long long> latencies;
+    long long encodedBytes = 0;
+    long long records = 0;
+    thread tail(runChangeConsumer, consumer, &stop, &latencies, &encodedBytes, &records);
+    for (int i = 0; i < iterations; i++) {
+        int index = sampleZipf(sampler, rng);
+        if (products[index].quantity < 1) {
+            restockProduct(index, DEFAULT_LOCATION, 1000);
+        }
+        if (transactionCount >= MAX_TRANSACTIONS) {
+            transactionCount = 0;
+        }
+        commitPurchase(index, 1, &unitPrice, &subtotal, &discount, &total, NULL, NULL);
+        long long target;
+        {
+            lock_guard<mutex> lock(mutationLogMutex);
+            target = nextLsn - 1;
+        }
+        while (true) {
+            {
+                lock_guard<mutex> lock(mutationLogMutex);
+                if (changeConsumers[consumer].offset >= target) {
+                    break;
+                }
+            }
+            this_thread::yield();
+        }
+    }
+    stop = true;
+    tail.join();
+    removeChangeConsumer(consumer);
+    reportResult(config, "cdc_delivery_paced", &latencies);
+
+#ifndef _WIN32
+    string path = "bench_changes.tmp";
+    string error;
+    remove(path.c_str());
+    remove((path + ".offset").c_str());
+    if (!startChangeSink(path, &error)) {
+        cerr << "cdc_sink_delivery: " << error << "\n";
+        return;
+    }
+    ChangeSink* sink = &changeSinks[changeSinkCount - 1];
+    latencies.clear();
+    for (int i = 0; i < iterations; i++) {
+        int index = sampleZipf(sampler, rng);
+        if (products[index].quantity < 1) {
+            restockProduct(index, DEFAULT_LOCATION, 1000);
+        }
+        if (transactionCount >= MAX_TRANSACTIONS) {
+            transactionCount = 0;
+        }
+        BenchClock::time_point start = BenchClock::now();
+        commitPurchase(index, 1, &unitPrice, &subtotal, &discount, &total, NULL, NULL);
+        long long target;
+        {
+            lock_guard<mutex> lock(mutationLogMutex);
+            target = nextLsn - 1;
+        }
+        while (sink->committedLsn < target && !sink->failed) {
+            this_thread::yield();
+        }
+        latencies.push_back(elapsedNs(start, BenchClock::now()));
+    }
+    stopChangeSinks(false);
+    remove(path.c_str());
+    remove((path + ".offset").c_str());
+    reportResult(config, "cdc_sink_delivery", &latencies);
+#endif
+}
+
+// Purchases with one change feed consumer tailing the log
+void benchChangeFeed(const BenchConfig* config, const ZipfSampler* sampler, mt19937* rng) {
+    int consumer = registerChangeConsumer("benchmark");
+    if (consumer == -1) {
+        return;
+    }
+
+    volatile bool stop = false;
+    vector<long long> latencies;
+    long long encodedBytes = 0;
+    long long records = 0;
+    thread tail(runChangeConsumer, consumer, &stop, &latencies, &encodedBytes, &records);
+
+    benchPurchase(config, sampler, rng, "purchase_commit_cdc");
+
+    stop = true;
+    tail.join();
+    removeChangeConsumer(consumer);
+
+    reportResult(config, "cdc_delivery", &latencies);
+    cout << "{\"benchmark\":\"cdc_encoding\",\"records\":" << records
+         << ",\"bytes\":" << encodedBytes
+         << ",\"bytes_per_record\":" << fixed << setprecision(1)
+         << (records > 0 ? (double)encodedBytes / records : 0.0)
+         << ",\"raw_bytes_per_record\":" << sizeof(MutationRecord) << "}\n";
+
+    benchChangeFeedPaced(config, sampler, rng);
+}
+
+// Reader thread for the concurrent run: full reports until told to stop
+void runReportLoop(volatile bool* stop, vector<long long>* latencies) {
+    int totalProducts, lowStock, outOfStock;
+    double totalValue;
+    while (!*stop) {
+        BenchClock::time_point start = BenchClock::now();
+        getProductStatistics(&totalProducts, &lowStock, &outOfStock, &totalValue);
+        latencies->push_back(elapsedNs(start, BenchClock::now()));
+    }
+}
+
+// Purchases while another thread keeps generating reports. Reports read
+// snapshots, so purchase latency should match the plain purchase run.
+void benchPurchaseWithReports(const BenchConfig* config, const ZipfSampler* sampler, mt19937* rng) {
+    volatile bool stop = false;
+    vector<long long> reportLatencies;
+    thread reporter(runReportLoop, &stop, &reportLatencies);
+
+    benchPurchase(config, sampler, rng, "purchase_commit_with_reports");
+
+    stop = true;
+    reporter.join();
+    reportResult(config, "report_statistics_concurrent", &reportLatencies);
+}
+
+void benchReport(const BenchConfig* config) {
+    vector<long long> latencies;
+    int iterations = max(1, config->iterations / 100);
+    int totalProducts, lowStock, outOfStock;
+    double totalValue;
+
+    for (int i = 0; i < iterations; i++) {
+        BenchClock::time_point start = BenchClock::now();
+        getProductStatistics(&totalProducts, &lowStock, &outOfStock, &totalValue);
+        latencies.push_back(elapsedNs(start, BenchClock::now()));
+    }
+    reportResult(config, "report_statistics", &latencies);
+}
+
+void benchLowStockScan(const BenchConfig* config) {
+    vector<long long> latencies;
+    int iterations = max(1, config->iterations / 100);
+    NullBuffer nullBuffer;
+    streambuf* saved = cout.rdbuf(&nullBuffer);
+
+    for (int i = 0; i < iterations; i++) {
+        BenchClock::time_point start = BenchClock::now();
+        checkLowStock();
+        latencies.push_back(elapsedNs(start, BenchClock::now()));
+    }
+
+    cout.rdbuf(saved);
+    reportResult(config, "low_stock_scan", &latencies);
+}
+
+// One page of 20 results from a random price or quantity range, and the
+// ten most expensive products (top-k)
+void benchIndexQueries(const BenchConfig* config, mt19937* rng) {
+    uniform_real_distribution<double> pickPrice(1.0, 500.0);
+    uniform_int_distribution<int> pickQuantity(0, 400);
+    int page[20];
+
+    vector<long long> priceLatencies, quantityLatencies, topLatencies;
+    for (int i = 0; i < config->iterations; i++) {
+        double low = pickPrice(*rng);
+        int lowQuantity = pickQuantity(*rng);
+        IndexCursor cursor;
+
+        lock_guard<mutex> lock(inventoryWriteMutex);
+        BenchClock::time_point start = BenchClock::now();
+        cursor.started = false;
+        queryIndexRange(INDEX_PRICE, 0, low, low * 2, false, &cursor, 20, page);
+        BenchClock::time_point middle = BenchClock::now();
+        cursor.started = false;
+        queryIndexRange(INDEX_QUANTITY, 0, lowQuantity, lowQuantity + 50, false, &cursor, 20, page);
+        BenchClock::time_point end = BenchClock::now();
+        cursor.started = false;
+        queryIndexRange(INDEX_PRICE, 0, 0.0, 1e18, true, &cursor, 10, page);
+        BenchClock::time_point last = BenchClock::now();
+
+        priceLatencies.push_back(elapsedNs(start, middle));
+        quantityLatencies.push_back(elapsedNs(middle, end));
+        topLatencies.push_back(elapsedNs(end, last));
+    }
+    reportResult(config, "index_price_range_page", &priceLatencies);
+    reportResult(config, "index_quantity_range_page", &quantityLatencies);
+    reportResult(config, "index_top10_price", &topLatencies);
+}
+
+// Filter-expression queries over the whole catalog: the three-clause
+// filter from the request as a count, a projected page of 20 rows, a sum
+// over transactions, and a count right after one product write (which
+// copies a single page into the column cache)
+void benchQueryEngine(const BenchConfig* config, const ZipfSampler* sampler, mt19937* rng) {
+    QueryResult result;
+    string error;
+    runQuery("COUNT", &result, &error);              // first extraction is not timed
+    runQuery("transactions COUNT", &result, &error);
+
+    vector<long long> countLatencies, pageLatencies, sumLatencies, refreshLatencies;
+    int iterations = max(1, config->iterations / 100);
+    for (int i = 0; i < iterations; i++) {
+        BenchClock::time_point start = BenchClock::now();
+        runQuery("category = \"Electronics\" AND quantity < 10 AND price > 100 COUNT", &result, &error);
+        BenchClock::time_point middle = BenchClock::now();
+        runQuery("price >= 20 AND NOT category = \"Food\" SELECT name, price LIMIT 20", &result, &error);
+        BenchClock::time_point end = BenchClock::now();
+        runQuery("transactions WHERE quantity >= 2 SUM(total)", &result, &error);
+        BenchClock::time_point last = BenchClock::now();
+
+        countLatencies.push_back(elapsedNs(start, middle));
+        pageLatencies.push_back(elapsedNs(middle, end));
+        sumLatencies.push_back(elapsedNs(end, last));
+
+        restockProduct(sampleZipf(sampler, rng), DEFAULT_LOCATION, 1);
+        start = BenchClock::now();
+        runQuery("quantity < 10 COUNT", &result, &error);
+        refreshLatencies.push_back(elapsedNs(start, BenchClock::now()));
+    }
+    reportResult(config, "query_filter_count", &countLatencies);
+    reportResult(config, "query_filter_page", &pageLatencies);
+    reportResult(config, "query_transactions_sum", &sumLatencies);
+    reportResult(config, "query_after_write", &refreshLatencies);
+}
+
+// Version history: appending a quantity change or a price edit for a
+// product, rebuilding a product as of a random earlier moment, and
+// reading 50 changes from a random point in the history
+void benchProductHistory(const BenchConfig* config, const ZipfSampler* sampler, mt19937* rng) {
+    vector<long long> quantityLatencies, priceLatencies, stateLatencies, windowLatencies;
+    lock_guard<mutex> lock(inventoryWriteMutex);
+    long long firstTime = historyLastTime;
+
+    // Each edit is made and then undone, so the catalog ends up unchanged
+    // (quantities must keep matching the location rows)
+    for (int i = 0; i < config->iterations; i++) {
+        int index = sampleZipf(sampler, rng);
+        int quantity = products[index].quantity;
+        double price = products[index].price;
+
+        for (int step = 0; step < 2; step++) {
+            products[index].quantity = step == 0 ? quantity + 1 : quantity;
+            BenchClock::time_point start = BenchClock::now();
+            recordProductVersions(index, index);
+            quantityLatencies.push_back(elapsedNs(start, BenchClock::now()));
+        }
+        for (int step = 0; step < 2; step++) {
+            products[index].price = step == 0 ? price * 1.01 : price;
+            BenchClock::time_point start = BenchClock::now();
+            recordProductVersions(index, index);
+            priceLatencies.push_back(elapsedNs(start, BenchClock::now()));
+        }
+    }
+
+    long long lastTime = historyLastTime;
+    uniform_int_distribution<long long> pickTime(firstTime, max(firstTime, lastTime));
+    Product state;
+    int version;
+    vector<HistoryEntry> page;
+    for (int i = 0; i < config->iterations; i++) {
+        int index = sampleZipf(sampler, rng);
+        long long time = pickTime(*rng);
+
+        BenchClock::time_point start = BenchClock::now();
+        getProductStateAt(index, time, &state, &version);
+        BenchClock::time_point middle = BenchClock::now();
+        page.clear();
+        findHistoryInWindow(time, lastTime, 50, &page);
+        windowLatencies.push_back(elapsedNs(middle, BenchClock::now()));
+        stateLatencies.push_back(elapsedNs(start, middle));
+    }
+
+    reportResult(config, "versions_record_quantity", &quantityLatencies);
+    reportResult(config, "versions_record_price", &priceLatencies);
+    reportResult(config, "versions_state_at", &stateLatencies);
+    reportResult(config, "versions_window_page", &windowLatencies);
+}
+
+// Sourcing graph with one supplier per 100 products and 1-3 suppliers per
+// product: full rebuild, the three lookups, and single link updates
+void benchSourcing(const BenchConfig* config, mt19937* rng) {
+    int savedSuppliers = supplierCount;
+    int supplierTotal = min(MAX_ITEMS, max(10, productCount / 100));
+    for (int s = supplierCount; s < supplierTotal; s++) {
+        suppliers[s] = {"Supplier " + to_string(s + 1), "orders@example.com", true};
+    }
+    supplierCount = max(supplierCount, supplierTotal);
+
+    uniform_int_distribution<int> pickSupplier(0, supplierCount - 1);
+    uniform_int_distribution<int> pickProduct(0, productCount - 1);
+    uniform_int_distribution<int> pickLinks(1, 3);
+    uniform_int_distribution<int> pickLead(2, 30);
+    uniform_real_distribution<double> pickMargin(0.4, 0.8);
+
+    for (int p = 0; p < productCount; p++) {
+        int links = pickLinks(*rng);
+        for (int k = 0; k < links; k++) {
+            setSourcingEdge(pickSupplier(*rng), p, products[p].price * pickMargin(*rng), pickLead(*rng));
+        }
+    }
+    vector<long long> buildLatencies;
+    BenchClock::time_point buildStart = BenchClock::now();
+    compactSourcingGraph();
+    buildLatencies.push_back(elapsedNs(buildStart, BenchClock::now()));
+    reportResult(config, "sourcing_build", &buildLatencies);
+
+    vector<long long> supplierLatencies, cheapestLatencies, impactLatencies, updateLatencies;
+    vector<SourcingEdge> links;
+    SupplierImpact impact;
+    double cost;
+    int lead;
+    for (int i = 0; i < config->iterations; i++) {
+        int supplier = pickSupplier(*rng);
+        int product = pickProduct(*rng);
+
+        BenchClock::time_point start = BenchClock::now();
+        links.clear();
+        getSupplierProducts(supplier, &links);
+        BenchClock::time_point afterSupplier = BenchClock::now();
+        findCheapestSupplier(product, &cost, &lead);
+        BenchClock::time_point afterCheapest = BenchClock::now();
+        setSourcingEdge(supplier, product, products[product].price * 0.6, 7);
+        BenchClock::time_point afterUpdate = BenchClock::now();
+
+        supplierLatencies.push_back(elapsedNs(start, afterSupplier));
+        cheapestLatencies.push_back(elapsedNs(afterSupplier, afterCheapest));
+        updateLatencies.push_back(elapsedNs(afterCheapest, afterUpdate));
+
+        if (i % 10 == 0) {
+            BenchClock::time_point impactStart = BenchClock::now();
+            getSupplierImpact(supplier, &impact);
+            impactLatencies.push_back(elapsedNs(impactStart, BenchClock::now()));
+        }
+    }
+    reportResult(config, "sourcing_supplier_products", &supplierLatencies);
+    reportResult(config, "sourcing_cheapest_supplier", &cheapestLatencies);
+    reportResult(config, "sourcing_supplier_impact", &impactLatencies);
+    reportResult(config, "sourcing_link_update", &updateLatencies);
+
+    // Leave the graph empty for the other cases
+    pendingEdges.clear();
+    pendingBySupplier.clear();
+    pendingByProduct.clear();
+    compactSourcingGraph();
+    supplierCount = savedSuppliers;
+}
+
+void benchHistoryQuery(const BenchConfig* config, const ZipfSampler* sampler, mt19937* rng) {
+    vector<long long> latencies;
+    int iterations = max(1, config->iterations / 100);
+    int count, unitsSold;
+    double revenue;
+
+    for (int i = 0; i < iterations; i++) {
+        int id = products[sampleZipf(sampler, rng)].id;
+        BenchClock::time_point start = BenchClock::now();
+        getTransactionSummary(id, &count, &unitsSold, &revenue);
+        latencies.push_back(elapsedNs(start, BenchClock::now()));
+    }
+    reportResult(config, "history_query", &latencies);
+}
+
+// Cost of folding one sale into a forecast, without the rest of a purchase
+void benchForecastUpdate(const BenchConfig* config, const ZipfSampler* sampler, mt19937* rng) {
+    vector<long long> latencies;
+    long long now = time(0);
+
+    for (int i = 0; i < config->iterations; i++) {
+        int index = sampleZipf(sampler, rng);
+        BenchClock::time_point start = BenchClock::now();
+        updateDemandForecast(index, 1 + i % 3, now + i);
+        latencies.push_back(elapsedNs(start, BenchClock::now()));
+    }
+    reportResult(config, "forecast_update", &latencies);
+}
+
+// Full backfill over the history; timestamps are spread over 90 days so
+// the decay and the rolling window both do real work
+void benchForecastBackfill(const BenchConfig* config) {
+    long long now = time(0);
+    for (int t = 0; t < transactionCount; t++) {
+        transactions[t].timestamp = now - (long long)(transactionCount - t) * 90 * SECONDS_PER_DAY / transactionCount;
+    }
+
+    vector<long long> latencies;
+    int rounds = max(1, config->iterations / 2000);
+    for (int i = 0; i < rounds; i++) {
+        BenchClock::time_point start = BenchClock::now();
+        {
+            lock_guard<mutex> lock(inventoryWriteMutex);
+            rebuildDemandForecasts(now);
+        }
+        latencies.push_back(elapsedNs(start, BenchClock::now()));
+    }
+    reportResult(config, "forecast_backfill", &latencies);
+}
+
+#ifdef _WIN32
+const char* NULL_DEVICE = "NUL";
+#else
+const char* NULL_DEVICE = "/dev/null";
+#endif
+
+// Export throughput is reported in MB/s rather than per-operation latency
+void benchExport(const BenchConfig* config, string name, bool transactionsExport, bool json) {
+    int rounds = max(1, config->iterations / 1000);
+    long long bytes = 0;
+    int rows = 0;
+
+    BenchClock::time_point start = BenchClock::now();
+    for (int i = 0; i < rounds; i++) {
+        if (transactionsExport) {
+            int watermark = 0;
+            exportTransactions(NULL_DEVICE, json, &watermark, &rows);
+        } else {
+            exportProducts(NULL_DEVICE, json, &rows);
+        }
+    }
+    long long total = elapsedNs(start, BenchClock::now());
+
+    // Measure the output size once against a real file
+    string path = "bench_export.tmp";
+    if (transactionsExport) {
+        int watermark = 0;
+        exportTransactions(path.c_str(), json, &watermark, &rows);
+    } else {
+        exportProducts(path.c_str(), json, &rows);
+    }
+    FILE* file = fopen(path.c_str(), "rb");
+    if (file != NULL) {
+        fseek(file, 0, SEEK_END);
+        bytes = ftell(file);
+        fclose(file);
+    }
+    remove(path.c_str());
+
+    double seconds = total / 1e9;
+    cout << "{\"benchmark\":\"" << name << "\""
+         << ",\"products\":" << productCount
+         << ",\"transactions\":" << transactionCount
+         << ",\"rounds\":" << rounds
+         << ",\"rows\":" << rows
+         << ",\"bytes\":" << bytes
+         << ",\"total_ns\":" << total
+         << ",\"mb_per_sec\":" << fixed << setprecision(1)
+         << (seconds > 0 ? bytes * rounds / seconds / 1e6 : 0.0)
+         << "}\n";
+    cout.flush();
+}
+
+// Seller-side latency of a sale with its invoice: formatted and written
+// inline (the old path) versus handed to the renderer thread
+void benchInvoices(const BenchConfig* config, const ZipfSampler* sampler, mt19937* rng) {
+    uniform_int_distribution<int> pickQuantity(1, 6);
+    double unitPrice, subtotal, discount, total;
+    InvoiceJob invoice;
+    string text;
+    FILE* nullFile = fopen(NULL_DEVICE, "wb");
+    if (nullFile == NULL || !startInvoiceRenderer(NULL_DEVICE)) {
+        return;
+    }
+
+    for (int pass = 0; pass < 2; pass++) {
+        bool async = pass == 1;
+        vector<long long> latencies;
+
+        for (int i = 0; i < config->iterations; i++) {
+            int index = sampleZipf(sampler, rng);
+            int quantity = pickQuantity(*rng);
+            if (products[index].quantity < quantity) {
+                restockProduct(index, DEFAULT_LOCATION, 1000);
+            }
+            if (transactionCount >= MAX_TRANSACTIONS) {
+                transactionCount = 0;
+            }
+
+            BenchClock::time_point start = BenchClock::now();
+            commitPurchase(index, quantity, &unitPrice, &subtotal, &discount, &total, &invoice, NULL);
+            if (async) {
+                submitInvoice(&invoice);
+            } else {
+                text.clear();
+                renderInvoice(&invoice, &text);
+                fwrite(text.data(), 1, text.size(), nullFile);
+                fflush(nullFile);
+            }
+            latencies.push_back(elapsedNs(start, BenchClock::now()));
+        }
+        reportResult(config, async ? "purchase_invoice_async" : "purchase_invoice_inline", &latencies);
+    }
+
+    stopInvoiceRenderer();
+    fclose(nullFile);
+}
+
+// Round-trip the catalog: export it, empty it and time the bulk import
+void benchImport(const BenchConfig* config) {
+    string path = "bench_import.tmp";
+    int rows = 0;
+    if (!exportProducts(path.c_str(), false, &rows)) {
+        return;
+    }
+
+    int savedCount = productCount;
+    int imported = 0;
+    vector<ImportError> errors;
+    vector<long long> latencies;
+
+    for (int round = 0; round < 3; round++) {
+        productCount = 0;
+        BenchClock::time_point start = BenchClock::now();
+        importProductsCsv(path.c_str(), &imported, &errors);
+        latencies.push_back(elapsedNs(start, BenchClock::now()));
+    }
+    remove(path.c_str());
+
+    if (imported != savedCount || !errors.empty()) {
+        cerr << "import round-trip mismatch: " << imported << " of " << savedCount << "\n";
+    }
+    reportResult(config, "bulk_import_csv", &latencies);
+}
+
+#ifndef _WIN32
+// Purchases routed through 1, 2, 4 ... worker processes in batches. The
+// per-op figure is the batch time divided by its size.
+// Tally purchase replies that sold nothing, or sold without a transaction
+// ID because the worker's history is full (workers are never reset)
+void countShardPurchaseReplies(const ShardReply* replies, int count, int* refused, int* unrecorded) {
+    for (int r = 0; r < count; r++) {
+        if (replies[r].status != 1) {
+            (*refused)++;
+        } else if (replies[r].transactionId == 0) {
+            (*unrecorded)++;
+        }
+    }
+}
+
+// Workers sell from their own copy of the stock, which cannot be topped up
+// mid-run, so give every product enough before they fork
+void stockForShardPurchases(const BenchConfig* config) {
+    for (int i = 0; i < productCount; i++) {
+        if (products[i].active && products[i].quantity < config->iterations) {
+            restockProduct(i, DEFAULT_LOCATION, config->iterations);
+        }
+    }
+}
+
+void reportShardPurchaseReplies(string name, int total, int refused, int unrecorded) {
+    if (refused > 0 || unrecorded > 0) {
+        cerr << name << ": " << refused << " of " << total << " purchases refused, "
+             << unrecorded << " sold without a transaction ID (history full)\n";
+    }
+}
+
+void benchSharded(const BenchConfig* config, const ZipfSampler* sampler, mt19937* rng) {
+    const int BATCH = 1024;
+    int expectedProducts, lowStock, outOfStock;
+    double totalValue;
+    stockForShardPurchases(config);
+    getProductStatistics(&expectedProducts, &lowStock, &outOfStock, &totalValue);
+
+    for (int shards = 1; shards <= 4; shards *= 2) {
+        if (!startShards(shards)) {
+            cerr << "could not start " << shards << " shards\n";
+            return;
+        }
+
+        int gathered = 0;
+        shardedStatistics(&gathered, &lowStock, &outOfStock, &totalValue);
+        if (gathered != expectedProducts) {
+            cerr << "shard statistics mismatch: " << gathered << " of " << expectedProducts << "\n";
+        }
+
+        // Requests are pipelined a batch at a time, so only whole batches
+        // are timed and the result is a mean per purchase
+        vector<ShardRequest> requests(BATCH);
+        vector<ShardReply> replies(BATCH);
+        long long elapsed = 0;
+        int sent = 0, refused = 0, unrecorded = 0;
+
+        for (int done = 0; done < config->iterations; done += BATCH) {
+            for (int r = 0; r < BATCH; r++) {
+                ShardRequest request = {SHARD_PURCHASE, products[sampleZipf(sampler, rng)].id, 1};
+                requests[r] = request;
+            }
+            BenchClock::time_point start = BenchClock::now();
+            routeShardRequests(&requests[0], BATCH, &replies[0]);
+            elapsed += elapsedNs(start, BenchClock::now());
+            sent += BATCH;
+            countShardPurchaseReplies(&replies[0], BATCH, &refused, &unrecorded);
+        }
+        stopShards();
+
+        ostringstream name;
+        name << "sharded_purchase_" << shards;
+        reportMean(config, name.str(), elapsed, sent);
+        reportShardPurchaseReplies(name.str(), sent, refused, unrecorded);
+    }
+}
+
+// Sharded purchases and lookups under each NUMA placement, each request
+// timed on its own round trip. On a single node the three modes run the
+// same code and should match.
+void benchNuma(const BenchConfig* config, const ZipfSampler* sampler, mt19937* rng) {
+    const char* MODE_NAMES[] = {"first_touch", "interleave", "partitioned"};
+    int nodes = detectNumaTopology();
+    int shards = max(2, nodes);
+
+    cout << "{\"benchmark\":\"numa_topology\",\"nodes\":" << nodes
+         << ",\"shards\":" << shards << "}\n";
+    stockForShardPurchases(config);
+
+    for (int mode = NUMA_FIRST_TOUCH; mode <= NUMA_PARTITIONED; mode++) {
+        if (!setNumaMode((NumaMode)mode)) {
+            cerr << "numa_" << MODE_NAMES[mode] << ": placement was refused, results are unplaced\n";
+        }
+        if (!startShards(shards)) {
+            cerr << "could not start " << shards << " shards\n";
+            break;
+        }
+
+        for (int type = SHARD_LOOKUP; type <= SHARD_PURCHASE; type++) {
+            vector<long long> latencies;
+            latencies.reserve(config->iterations);
+            int refused = 0, unrecorded = 0;
+            for (int done = 0; done < config->iterations; done++) {
+                ShardRequest request = {type, products[sampleZipf(sampler, rng)].id, 1};
+                ShardReply reply;
+                BenchClock::time_point start = BenchClock::now();
+                routeShardRequests(&request, 1, &reply);
+                latencies.push_back(elapsedNs(start, BenchClock::now()));
+                if (type == SHARD_PURCHASE) {
+                    countShardPurchaseReplies(&reply, 1, &refused, &unrecorded);
+                }
+            }
+            string name = string("numa_") + MODE_NAMES[mode] +
+                          (type == SHARD_LOOKUP ? "_lookup" : "_purchase");
+            reportResult(config, name, &latencies);
+            reportShardPurchaseReplies(name, (int)latencies.size(), refused, unrecorded);
+        }
+        stopShards();
+    }
+    setNumaMode(NUMA_FIRST_TOUCH);
+}
+
+// Two-process run: purchases on the primary while one replica, started
+// as a separate process, follows the mutation log. Reports the purchase
+// latency with replication on and the append-to-acknowledge lag, then
+// checks the replica against the primary.
+void benchReplication(const BenchConfig* config, const ZipfSampler* sampler, mt19937* rng) {
+    const char* path = "benchmark_replica";
+    pid_t pid = fork();
+    if (pid == 0) {
+        int devNull = open("/dev/null", O_WRONLY);
+        dup2(devNull, STDOUT_FILENO);
+        execl("/proc/self/exe", "benchmark", "--replica", path, (char*)NULL);
+        _exit(1);
+    }
+    if (pid < 0) {
+        cerr << "could not start replica\n";
+        return;
+    }
+
+    // The replica creates its pipes once it is running
+    string error;
+    bool attached = false;
+    for (int attempt = 0; attempt < 500 && !attached; attempt++) {
+        attached = attachReplica(path, &error);
+        if (!attached) {
+            this_thread::sleep_for(chrono::milliseconds(10));
+        }
+    }
+    if (!attached || !waitForReplicas(nextLsn - 1, 10000)) {
+        cerr << "could not attach replica: " << error << "\n";
+        stopReplicas();
+        waitpid(pid, NULL, 0);
+        return;
+    }
+    {
+        lock_guard<mutex> lock(replicationLagMutex);
+        replicationLagSamples.clear();
+    }
+
+    benchPurchase(config, sampler, rng, "purchase_commit_replicated");
+    if (!waitForReplicas(nextLsn - 1, 10000)) {
+        cerr << "replica did not catch up\n";
+    }
+
+    int totalProducts, lowStock, outOfStock, replicaProducts, replicaLow, replicaOut, replicaTransactions;
+    double totalValue, replicaValue;
+    vector<long long> replicaUnits;
+    vector<double> replicaLocationValue;
+    getProductStatistics(&totalProducts, &lowStock, &outOfStock, &totalValue);
+    if (!getReplicaReport(0, &replicaProducts, &replicaLow, &replicaOut, &replicaValue,
+                          &replicaTransactions, &replicaUnits, &replicaLocationValue) ||
+        replicaProducts != totalProducts || replicaLow != lowStock || replicaOut != outOfStock ||
+        replicaTransactions != transactionCount) {
+        cerr << "replica statistics differ from the primary\n";
+    }
+
+    int probe = sampleZipf(sampler, rng);
+    bool found;
+    Product replicaProduct;
+    int reserved;
+    if (!lookupOnReplica(0, products[probe].id, &found, &replicaProduct, &reserved) || !found ||
+        replicaProduct.quantity != products[probe].quantity || replicaProduct.name != products[probe].name) {
+        cerr << "replica lookup differs from the primary\n";
+    }
+
+    stopReplicas();
+    waitpid(pid, NULL, 0);
+
+    vector<long long> lag;
+    {
+        lock_guard<mutex> lock(replicationLagMutex);
+        lag = replicationLagSamples;
+    }
+    reportResult(config, "replication_lag", &lag);
+}
+#endif
+
+// ============================================================
+// MAIN
+// ============================================================
+void printUsage() {
+    cout << "Usage: benchmark [--products N] [--iterations N] [--seed N]\n"
+         << "                 [--zipf S] [--locations N] [--only NAME]\n";
+}
+
+bool parseArguments(int argc, char** argv, BenchConfig* config) {
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if (i + 1 >= argc) {
+            return false;
+        }
+        string value = argv[++i];
+
+        if (arg == "--products") {
+            config->productTotal = atoi(value.c_str());
+        } else if (arg == "--iterations") {
+            config->iterations = atoi(value.c_str());
+        } else if (arg == "--seed") {
+            config->seed = (unsigned)strtoul(value.c_str(), NULL, 10);
+        } else if (arg == "--zipf") {
+            config->zipfExponent = atof(value.c_str());
+        } else if (arg == "--locations") {
+            config->locationTotal = atoi(value.c_str());
+        } else if (arg == "--only") {
+            config->only = value;
+        } else {
+            return false;
+        }
+    }
+
+    if (config->productTotal <= 0 || config->productTotal > MAX_ITEMS || config->iterations <= 0 ||
+        config->locationTotal <= 0 || config->locationTotal > MAX_LOCATIONS) {
+        cerr << "products must be 1.." << MAX_ITEMS << ", locations 1.." << MAX_LOCATIONS
+             << " and iterations positive\n";
+        return false;
+    }
+    return true;
+}
+
+int main(int argc, char** argv) {
+#ifndef _WIN32
+    // The replication benchmark starts a copy of itself as the replica
+    if (argc == 3 && string(argv[1]) == "--replica") {
+        followPrimary(argv[2]);
+        return 0;
+    }
+#endif
+
+    BenchConfig config;
+    config.productTotal = 10000;
+    config.iterations = 20000;
+    config.seed = 42;
+    config.zipfExponent = 1.0;
+    config.locationTotal = 8;
+
+    if (!parseArguments(argc, argv, &config)) {
+        printUsage();
+        return 1;
+    }
+
+    mt19937 rng(config.seed);
+    generateSyntheticCatalog(config.productTotal, config.locationTotal, &rng);
+
+    ZipfSampler sampler;
+    initZipfSampler(&sampler, productCount, config.zipfExponent, &rng);
+    generateSyntheticSales(MAX_TRANSACTIONS / 2, &sampler, &rng);
+
+    if (shouldRun(&config, "lookup_by_id")) benchLookupById(&config, &sampler, &rng);
+    if (shouldRun(&config, "lookup_by_name")) benchLookupByName(&config, &sampler, &rng);
+    if (shouldRun(&config, "report_statistics")) benchReport(&config);
+    if (shouldRun(&config, "low_stock_scan")) benchLowStockScan(&config);
+    if (shouldRun(&config, "index_")) benchIndexQueries(&config, &rng);
+    if (shouldRun(&config, "sourcing_")) benchSourcing(&config, &rng);
+    if (shouldRun(&config, "query_")) benchQueryEngine(&config, &sampler, &rng);
+    if (shouldRun(&config, "history_query")) benchHistoryQuery(&config, &sampler, &rng);
+    if (shouldRun(&config, "versions_")) benchProductHistory(&config, &sampler, &rng);
+    if (shouldRun(&config, "forecast_update")) benchForecastUpdate(&config, &sampler, &rng);
+    if (shouldRun(&config, "forecast_backfill")) benchForecastBackfill(&config);
+    if (shouldRun(&config, "export_products_csv")) benchExport(&config, "export_products_csv", false, false);
+    if (shouldRun(&config, "export_products_ndjson")) benchExport(&config, "export_products_ndjson", false, true);
+    if (shouldRun(&config, "export_transactions_csv")) benchExport(&config, "export_transactions_csv", true, false);
+    if (shouldRun(&config, "export_transactions_ndjson")) benchExport(&config, "export_transactions_ndjson", true, true);
+    if (shouldRun(&config, "bulk_import_csv")) benchImport(&config);
+#ifndef _WIN32
+    if (shouldRun(&config, "sharded_purchase")) benchSharded(&config, &sampler, &rng);
+    if (shouldRun(&config, "numa_")) benchNuma(&config, &sampler, &rng);
+#endif
+    if (shouldRun(&config, "transfer_stock")) benchTransfer(&config, &sampler, &rng);
+    if (shouldRun(&config, "purchase_commit")) benchPurchase(&config, &sampler, &rng, "purchase_commit");
+    if (shouldRun(&config, "purchase_invoice")) benchInvoices(&config, &sampler, &rng);
+    if (shouldRun(&config, "purchase_request")) benchPurchaseRequests(&config, &sampler, &rng);
+    if (shouldRun(&config, "reservation_")) benchReservations(&config, &sampler, &rng);
+#ifndef _WIN32
+    if (shouldRun(&config, "replication")) benchReplication(&config, &sampler, &rng);
+#endif
+    if (shouldRun(&config, "cdc")) benchChangeFeed(&config, &sampler, &rng);
+    if (shouldRun(&config, "purchase_commit_with_reports")) benchPurchaseWithReports(&config, &sampler, &rng);
+
+    return 0;
+}